@@ -748,3 +748,31 @@ unsigned long GetTickCount()
 }
 
 #endif // _WIN32
+
+#if _WIN32 && !defined(WINAPI)
+// Avoid including <windows.h>
+extern "C" {
+	__declspec(dllimport) int __stdcall QueryPerformanceCounter(int64* lpPerformanceCount);
+	__declspec(dllimport) int __stdcall QueryPerformanceFrequency(int64* lpFrequency);
+}
+#define QPC_ARG(x)	(x)
+#else
+#define QPC_ARG(x)	((LARGE_INTEGER*)(x))
+#endif
+
+uint64 appMicroseconds()
+{
+#if _WIN32
+	static int64 Frequency = 0;
+	if (!Frequency)
+		QueryPerformanceFrequency(QPC_ARG(&Frequency));
+	int64 Counter;
+	QueryPerformanceCounter(QPC_ARG(&Counter));
+	// Split the computation to avoid overflow in multiplication
+	return uint64(Counter / Frequency) * 1000000ull + uint64(Counter % Frequency) * 1000000ull / Frequency;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)(ts.tv_nsec / 1000) + ((uint64)ts.tv_sec * 1000000ull);
+#endif
+}
@@ -339,10 +339,11 @@ unsigned appGetFileType(const char *filename);
 
 // Memory management
 
-void* appMalloc(int size, int alignment = 8, bool noInit = false);
-void* appRealloc(void *ptr, int newSize);
+// Blocks of 64Mb and larger are allocated directly from OS
+void* appMalloc(size_t size, int alignment = 8, bool noInit = false);
+void* appRealloc(void *ptr, size_t newSize);
 
-FORCEINLINE void* appMallocNoInit(int size, int alignment = 8)
+FORCEINLINE void* appMallocNoInit(size_t size, int alignment = 8)
 {
 	return appMalloc(size, alignment, true);
 }
@@ -383,6 +384,11 @@ FORCEINLINE void operator delete(void* ptr, size_t)
 	appFree(ptr);
 }
 
+FORCEINLINE void operator delete[](void* ptr, size_t)
+{
+	appFree(ptr);
+}
+
 // inplace new
 FORCEINLINE void* operator new(size_t /*size*/, void* ptr)
 {
@@ -396,30 +402,64 @@ FORCEINLINE void* operator new(size_t /*size*/, void* ptr)
 class CMemoryChain
 {
 public:
+	// Fields are initialized in operator new. Empty constructor is required, otherwise "new CMemoryChain()"
+	// will perform value-initialization and clear everything.
+	CMemoryChain()
+	{}
+
 	void* Alloc(size_t size, int alignment = DEFAULT_ALIGNMENT);
-	// creating chain
+	// creating chain; 'dataSize' is also used as size for subsequent blocks
 	void* operator new(size_t size, int dataSize = MEM_CHUNK_SIZE);
 	// deleting chain
 	void operator delete(void* ptr);
 	// stats
-	int GetSize() const;
+	size_t GetSize() const;
 
 private:
 	CMemoryChain*	next;
+	CMemoryChain*	current;					// block used for allocations, valid in the 1st block only
 	int				size;
+	int				chunkSize;
 	byte*			data;
 	byte*			end;
 };
 
+// Memory arena: blocks allocated explicitly with Alloc() are served from the arena's memory chain,
+// and appFree() calls for these blocks are not releasing anything. All the memory is released at
+// once with Release(), all arena blocks should be freed at this moment.
+class CMemoryArena
+{
+public:
+	CMemoryArena(const char* InName, int ChunkSize = 1 << 20);
+
+	void* Alloc(int size, int alignment, bool noInit);
+	void Free(void* ptr);
+	void Release();
+
+	void PrintStats() const;
+
+	const char*		Name;
+	// stats
+	int				NumAllocs;
+	volatile int32	NumFrees;
+	size_t			AllocatedBytes;
+
+protected:
+	~CMemoryArena();
+
+	CMemoryChain*	Chain;
+	volatile int32	NumLiveAllocs;			// allocated and not yet freed blocks
+};
+
 
 #if PROFILE
 // number of dynamic allocations
 extern int GNumAllocs;
 #endif
 
-// static allocation stats
-extern size_t GTotalAllocationSize;
-extern int    GTotalAllocationCount;
+// static allocation stats, collected from all threads
+size_t appGetAllocationSize();
+int    appGetAllocationCount();
 
 void appDumpMemoryAllocations();
 
@@ -649,6 +689,9 @@ extern bool GUseDebugger;
 #endif
 #define appMilliseconds()		GetTickCount()
 
+// High resolution timer, used for fine-grained timing statistics
+uint64 appMicroseconds();
+
 // Allow operation of enum class as with regular integer
 #define BITFIELD_ENUM(Enum) \
 	inline Enum& operator|=(Enum& Lhs, Enum Rhs) { return Lhs = (Enum)((__underlying_type(Enum))Lhs | (__underlying_type(Enum))Rhs); } \
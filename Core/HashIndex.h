@@ -0,0 +1,224 @@
+#ifndef __HASH_INDEX_H__
+#define __HASH_INDEX_H__
+
+/*-----------------------------------------------------------------------------
+	CHashIndex: maps 64-bit hash to indices of items stored elsewhere (usually
+	in a TArray). Open-addressing table with linear probing, resized when it
+	becomes 3/4 full. The table doesn't know anything about keys, so multiple
+	items may share the same hash: lookup code should iterate over all indices
+	returned by CHashIndex::CIterator and compare keys itself.
+
+	Entry stores the upper 32 bits of the hash, lower bits are used to select
+	the slot, so false matches are very rare.
+-----------------------------------------------------------------------------*/
+
+class CHashIndex
+{
+public:
+	CHashIndex()
+	:	Entries(NULL)
+	,	Mask(-1)
+	,	NumEntries(0)
+	{}
+
+	~CHashIndex()
+	{
+		Empty();
+	}
+
+	void Empty()
+	{
+		if (Entries) appFree(Entries);
+		Entries = NULL;
+		Mask = -1;
+		NumEntries = 0;
+	}
+
+	// Preallocate space for 'Count' entries
+	void Reserve(int Count)
+	{
+		int NewSize = 16;
+		while (NewSize * 3 < Count * 4) NewSize *= 2;
+		if (NewSize > Mask + 1) Resize(NewSize);
+	}
+
+	void Add(uint64 Hash, int Index)
+	{
+		if ((NumEntries + 1) * 4 > (Mask + 1) * 3)
+			Resize(Entries ? (Mask + 1) * 2 : 256);
+		Insert(Hash, Index);
+		NumEntries++;
+	}
+
+	FORCEINLINE int Num() const
+	{
+		return NumEntries;
+	}
+
+	// Iterate over indices with matching hash
+	class CIterator
+	{
+	public:
+		FORCEINLINE CIterator(const CHashIndex& InTable, uint64 Hash)
+		:	Table(InTable)
+		,	Tag((uint32)(Hash >> 32))
+		,	Pos((uint32)Hash & InTable.Mask)
+		{
+			if (!Table.Entries)
+				Pos = -1;
+			else
+				FindMatch();
+		}
+		FORCEINLINE operator bool() const
+		{
+			return Pos >= 0;
+		}
+		FORCEINLINE int operator*() const
+		{
+			return Table.Entries[Pos].Index - 1;
+		}
+		FORCEINLINE void operator++()
+		{
+			Pos = (Pos + 1) & Table.Mask;
+			FindMatch();
+		}
+
+	protected:
+		const CHashIndex& Table;
+		uint32		Tag;
+		int			Pos;
+
+		FORCEINLINE void FindMatch()
+		{
+			while (true)
+			{
+				const CEntry& E = Table.Entries[Pos];
+				if (!E.Index)
+				{
+					// Empty slot terminates the probe sequence
+					Pos = -1;
+					return;
+				}
+				if (E.Tag == Tag) return;
+				Pos = (Pos + 1) & Table.Mask;
+			}
+		}
+	};
+
+	// Print table load and probe lengths
+	void PrintStats(const char* Name) const
+	{
+		int Capacity = Mask + 1;
+		int ProbeCounts[33];
+		memset(ProbeCounts, 0, sizeof(ProbeCounts));
+		int64 TotalProbe = 0;
+		int MaxProbe = 0;
+		for (int i = 0; i < Capacity; i++)
+		{
+			const CEntry& E = Entries[i];
+			if (!E.Index) continue;
+			// Distance from the slot where the entry should be placed
+			int Probe = (i - (int)(E.Hash32 & Mask)) & Mask;
+			TotalProbe += Probe;
+			if (Probe > MaxProbe) MaxProbe = Probe;
+			ProbeCounts[min(Probe, 32)]++;
+		}
+		appPrintf("%s hash: %d entries, %d slots (%.1f%% load), average probe %.2f, max probe %d\n",
+			Name, NumEntries, Capacity, Capacity ? NumEntries * 100.0f / Capacity : 0.0f,
+			NumEntries ? (float)TotalProbe / NumEntries : 0.0f, MaxProbe);
+		int Total = 0;
+		for (int i = 0; i <= 32; i++)
+		{
+			if (!ProbeCounts[i]) continue;
+			Total += ProbeCounts[i];
+			appPrintf("  %s%d -> %d [%.1f%%]\n", i == 32 ? ">=" : "", i, ProbeCounts[i], Total * 100.0f / NumEntries);
+		}
+	}
+
+protected:
+	struct CEntry
+	{
+		uint32		Tag;				// upper 32 bits of hash
+		uint32		Hash32;				// lower 32 bits of hash, used for resizing
+		int32		Index;				// index + 1, 0 for empty slot
+	};
+
+	CEntry*			Entries;
+	int				Mask;
+	int				NumEntries;
+
+	FORCEINLINE void Insert(uint64 Hash, int Index)
+	{
+		int Pos = (uint32)Hash & Mask;
+		while (Entries[Pos].Index)
+			Pos = (Pos + 1) & Mask;
+		CEntry& E = Entries[Pos];
+		E.Tag = (uint32)(Hash >> 32);
+		E.Hash32 = (uint32)Hash;
+		E.Index = Index + 1;
+	}
+
+	void Resize(int NewSize)
+	{
+		guard(CHashIndex::Resize);
+		CEntry* OldEntries = Entries;
+		int OldSize = Mask + 1;
+		Entries = (CEntry*)appMalloc(NewSize * sizeof(CEntry));
+		Mask = NewSize - 1;
+		for (int i = 0; i < OldSize; i++)
+		{
+			const CEntry& E = OldEntries[i];
+			if (E.Index)
+				Insert(((uint64)E.Tag << 32) | E.Hash32, E.Index - 1);
+		}
+		if (OldEntries) appFree(OldEntries);
+		unguard;
+	}
+};
+
+// Case-insensitive 64-bit string hash (FNV-1a with final avalanche), suitable for CHashIndex
+FORCEINLINE uint64 appStrihash64(const char* s, int len)
+{
+	uint64 hash = 0xCBF29CE484222325ULL;
+	for (int i = 0; i < len; i++)
+	{
+		hash ^= (byte)(s[i] & 0xDF);		// uppercase the character with "& 0xDF"
+		hash *= 0x100000001B3ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// 64-bit hash of a memory block (MurmurHash64A), 'Seed' allows chaining hashes of multiple blocks
+inline uint64 appMemHash64(const void* Data, int Size, uint64 Seed = 0)
+{
+	const uint64 m = 0xC6A4A7935BD1E995ULL;
+	uint64 hash = Seed ^ (Size * m);
+	const byte* s = (const byte*)Data;
+	const byte* end = s + (Size & ~7);
+	for ( ; s < end; s += 8)
+	{
+		uint64 k;
+		memcpy(&k, s, 8);
+		k *= m;
+		k ^= k >> 47;
+		k *= m;
+		hash ^= k;
+		hash *= m;
+	}
+	if (Size & 7)
+	{
+		uint64 k = 0;
+		memcpy(&k, s, Size & 7);
+		hash ^= k;
+		hash *= m;
+	}
+	hash ^= hash >> 47;
+	hash *= m;
+	hash ^= hash >> 47;
+	return hash;
+}
+
+#endif // __HASH_INDEX_H__
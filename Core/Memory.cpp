@@ -1,9 +1,17 @@
 #include "Core.h"
 #include "Parallel.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #if DEBUG_MEMORY
 #define MAX_STACK_TRACE			16
-#define MAX_ALLOCATION_POINTS	8192
+#define MAX_ALLOCATION_POINTS	32768
+#define ALLOCATION_POINTS_HASH	8192			// should be power of 2
 #endif // DEBUG_MEMORY
 
 //#define TRACY_DEBUG_MALLOC		1
@@ -12,14 +20,28 @@
 int GNumAllocs = 0;
 #endif
 
-size_t GTotalAllocationSize = 0;
-int    GTotalAllocationCount = 0;
-
 #define BLOCK_MAGIC				0xAE
+#define POOL_BLOCK_MAGIC		0xAC
+#define ARENA_BLOCK_MAGIC		0xA9			// note: freed blocks has magic decremented, don't use 0xAD and 0xAB
+#define HUGE_BLOCK_MAGIC		0xA7
 #define UNINIT_BLOCK			0xCC
 #define FREE_BLOCK				0xFE
 
+#if defined(_WIN64) || defined(__LP64__)
+#define MAX_ALLOCATION_SIZE		((size_t)64<<30)	// sanity check for allocation size, 64 Gb
+#else
 #define MAX_ALLOCATION_SIZE		(513<<20)		// upper limit for single allocation is 513+1 Mb
+#endif
+#define HUGE_BLOCK_SIZE			(64<<20)		// blocks of this size or larger are allocated directly from OS
+#define HUGE_BLOCK_GRANULARITY	(2<<20)			// huge page size
+
+#define POOL_GRANULARITY		16
+#define POOL_MAX_BLOCK			512				// max block size served by pools, including CBlockHeader and alignment
+#define POOL_NUM_CLASSES		(POOL_MAX_BLOCK / POOL_GRANULARITY)
+#define POOL_CHUNK_SIZE			(64<<10)		// pools are getting memory from the heap with chunks of this size
+#define POOL_BATCH				32				// number of blocks moved between thread and shared lists at once
+
+#define MAX_STATS_SLOTS			64				// number of threads which could have own statistics counters
 
 #if DEBUG_MEMORY
 
@@ -29,7 +51,8 @@ static CMutex GMallocMutex;
 
 struct CStackTrace
 {
-	int				hash;
+	uint32			hash;
+	int				hashNext;					// index+1 of the next trace with the same hash bucket
 	address_t		stack[MAX_STACK_TRACE];
 
 	CStackTrace()
@@ -38,11 +61,12 @@ struct CStackTrace
 	}
 	void UpdateHash()
 	{
-		int h = 0;
+		uint32 h = 0;
 		for (int i = 0; i < MAX_STACK_TRACE; i++)
 		{
-			h += stack[i];
-			h ^= 0x56789ABC;
+			uint64 v = stack[i];
+			h = (h ^ (uint32)v ^ (uint32)(v >> 32)) * 0x9E3779B1;
+			h ^= h >> 15;
 		}
 		hash = h;
 	}
@@ -62,6 +86,28 @@ struct CStackTrace
 
 static CStackTrace GAllocationPoints[MAX_ALLOCATION_POINTS];
 static int GNumAllocationPoints = 0;
+static int GAllocationPointsHash[ALLOCATION_POINTS_HASH];	// index+1 of the first trace in bucket
+
+// Find or register allocation point, should be called inside GMallocMutex lock
+static CStackTrace* FindAllocationPoint(const CStackTrace& stack)
+{
+	int bucket = stack.hash & (ALLOCATION_POINTS_HASH - 1);
+	for (int i = GAllocationPointsHash[bucket]; i; i = GAllocationPoints[i-1].hashNext)
+	{
+		if (stack == GAllocationPoints[i-1])
+			return &GAllocationPoints[i-1];
+	}
+	if (GNumAllocationPoints >= MAX_ALLOCATION_POINTS - 1)
+	{
+		// Table is full, put everything else to the last entry which has no call stack
+		return &GAllocationPoints[MAX_ALLOCATION_POINTS - 1];
+	}
+	CStackTrace* found = &GAllocationPoints[GNumAllocationPoints++];
+	*found = stack;
+	found->hashNext = GAllocationPointsHash[bucket];
+	GAllocationPointsHash[bucket] = GNumAllocationPoints;
+	return found;
+}
 
 #endif // DEBUG_MEMORY
 
@@ -97,8 +143,44 @@ struct CBlockHeader
 };
 
 #if DEBUG_MEMORY
+
 CBlockHeader* CBlockHeader::first = NULL;
-#endif
+
+static void LinkBlock(CBlockHeader* hdr)
+{
+	#if THREADING
+	if (CThread::NumThreads)
+	{
+		GMallocMutex.Lock();
+		hdr->Link();
+		GMallocMutex.Unlock();
+		return;
+	}
+	#endif
+	hdr->Link();
+}
+
+static void UnlinkBlock(CBlockHeader* hdr)
+{
+	#if THREADING
+	if (CThread::NumThreads)
+	{
+		GMallocMutex.Lock();
+		hdr->Unlink();
+		GMallocMutex.Unlock();
+		return;
+	}
+	#endif
+	hdr->Unlink();
+}
+
+#endif // DEBUG_MEMORY
+
+// Arena blocks has a pointer to owning arena placed immediately before CBlockHeader
+FORCEINLINE CMemoryArena*& GetBlockArena(CBlockHeader* hdr)
+{
+	return *((CMemoryArena**)hdr - 1);
+}
 
 
 /*-----------------------------------------------------------------------------
@@ -110,7 +192,7 @@ CBlockHeader* CBlockHeader::first = NULL;
 static void* ReservedMemory = NULL;
 #endif
 
-inline void OutOfMemory(int size)
+inline void OutOfMemory(size_t size)
 {
 #if DEBUG_MEMORY
 	static bool recurse = false;
@@ -124,10 +206,349 @@ inline void OutOfMemory(int size)
 	appDumpMemoryAllocations();
 #endif
 	// Crash ...
-	appErrorNoLog("Out of memory: failed to allocate %d bytes", size);
+	appErrorNoLog("Out of memory: failed to allocate " FORMAT_SIZE("u") " bytes", size);
+}
+
+/*-----------------------------------------------------------------------------
+	Per-thread allocation statistics and small block pools
+-----------------------------------------------------------------------------*/
+
+// Allocation statistics are collected per thread to avoid contention on shared counters. Each thread
+// updates its own slot without atomic operations, values are summed when requested. Slot 0 is shared
+// between threads which didn't get own slot, it is updated with interlocked operations.
+struct CMemoryStatsSlot
+{
+	volatile size_t	Size;
+	volatile int32	Count;
+	bool			bUsed;
+	byte			Padding[64 - sizeof(size_t) - 8];	// put slots in different cache lines
+};
+
+static CMemoryStatsSlot GStatsSlots[MAX_STATS_SLOTS];
+
+struct CPoolFreeBlock
+{
+	CPoolFreeBlock*	next;
+};
+
+// Free lists of small blocks, per size class
+struct CPoolFreeList
+{
+	CPoolFreeBlock*	first;
+	int				count;
+
+	FORCEINLINE void Push(CPoolFreeBlock* block)
+	{
+		block->next = first;
+		first = block;
+		count++;
+	}
+	FORCEINLINE CPoolFreeBlock* Pop()
+	{
+		CPoolFreeBlock* block = first;
+		first = block->next;
+		count--;
+		return block;
+	}
+	// Move up to 'num' blocks to another list
+	void MoveTo(CPoolFreeList& other, int num)
+	{
+		while (first && num-- > 0)
+			other.Push(Pop());
+	}
+};
+
+// Pool chunks are never returned to the heap: blocks of a chunk are mixed in free lists of different
+// threads, so it is not known when the whole chunk is free. Memory reserved by pools is limited by
+// the peak amount of small blocks in use. Blocks cached by exited threads are moved to shared lists
+// and reused by other threads. The reserved size is printed by appDumpMemoryAllocations() with DEBUG_MEMORY.
+static CPoolFreeList GSharedFreeLists[POOL_NUM_CLASSES];
+static size_t GPoolReservedBytes = 0;
+
+// Per-thread memory state. Has no constructor, so it is zero-initialized. Destructor is
+// called when thread exits, or when program exits for the main thread.
+struct CThreadMemory
+{
+	CPoolFreeList		FreeLists[POOL_NUM_CLASSES];
+	CMemoryStatsSlot*	Stats;
+	bool				bDestroyed;			// set by destructor, shared lists are used after that
+
+	~CThreadMemory();
+};
+
+static thread_local CThreadMemory GThreadMemory;
+
+#if THREADING
+// Constructed on the first use, appMalloc could be called before static constructors of this file
+static CMutex& GetPoolMutex()
+{
+	static CMutex Mutex;
+	return Mutex;
+}
+#define POOL_LOCK()		GetPoolMutex().Lock()
+#define POOL_UNLOCK()	GetPoolMutex().Unlock()
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif // THREADING
+
+CThreadMemory::~CThreadMemory()
+{
+	POOL_LOCK();
+	// Give cached blocks to other threads
+	for (int i = 0; i < POOL_NUM_CLASSES; i++)
+		FreeLists[i].MoveTo(GSharedFreeLists[i], FreeLists[i].count);
+	// Release the stats slot, accumulated values are kept and will be continued by the next owner
+	if (Stats) Stats->bUsed = false;
+	Stats = &GStatsSlots[0];
+	bDestroyed = true;
+	POOL_UNLOCK();
+}
+
+static CMemoryStatsSlot* AcquireStatsSlot()
+{
+	POOL_LOCK();
+	CMemoryStatsSlot* slot = &GStatsSlots[0];
+	for (int i = 1; i < MAX_STATS_SLOTS; i++)
+	{
+		if (!GStatsSlots[i].bUsed)
+		{
+			slot = &GStatsSlots[i];
+			slot->bUsed = true;
+			break;
+		}
+	}
+	POOL_UNLOCK();
+	return slot;
+}
+
+FORCEINLINE void UpdateAllocationStats(size_t size, int count)
+{
+	CMemoryStatsSlot* slot = GThreadMemory.Stats;
+	if (!slot)
+		slot = GThreadMemory.Stats = AcquireStatsSlot();
+	if (slot == &GStatsSlots[0])
+	{
+		InterlockedAdd(&slot->Size, size);
+		InterlockedAdd(&slot->Count, count);
+	}
+	else
+	{
+		slot->Size += size;
+		slot->Count += count;
+	}
+}
+
+size_t appGetAllocationSize()
+{
+	size_t size = 0;
+	for (int i = 0; i < MAX_STATS_SLOTS; i++)
+		size += GStatsSlots[i].Size;
+	return size;
+}
+
+int appGetAllocationCount()
+{
+	int count = 0;
+	for (int i = 0; i < MAX_STATS_SLOTS; i++)
+		count += GStatsSlots[i].Count;
+	return count;
+}
+
+// 'size' is a raw block size, including header and alignment
+FORCEINLINE int GetPoolClass(int size)
+{
+	return (size - 1) / POOL_GRANULARITY;
+}
+
+// Allocate a new chunk and split it to blocks
+static void AddPoolChunk(CPoolFreeList& list, int poolClass)
+{
+	guard(AddPoolChunk);
+
+	byte* chunk = (byte*)malloc(POOL_CHUNK_SIZE);
+	if (!chunk)
+		OutOfMemory(POOL_CHUNK_SIZE);
+	InterlockedAdd(&GPoolReservedBytes, POOL_CHUNK_SIZE);
+
+	int blockSize = (poolClass + 1) * POOL_GRANULARITY;
+	for (int offset = POOL_CHUNK_SIZE - blockSize; offset >= 0; offset -= blockSize)
+		list.Push((CPoolFreeBlock*)(chunk + offset));
+
+	unguard;
+}
+
+static void RefillPool(CPoolFreeList& list, int poolClass)
+{
+	// Try to get blocks released by other threads
+	POOL_LOCK();
+	GSharedFreeLists[poolClass].MoveTo(list, POOL_BATCH);
+	POOL_UNLOCK();
+	if (!list.first)
+		AddPoolChunk(list, poolClass);
+}
+
+// Allocations and releases performed by the thread after destruction of its CThreadMemory, e.g. from
+// destructors of other thread_local objects. Blocks put to the thread's lists would be lost, so use
+// shared lists.
+static void* SharedPoolAlloc(int poolClass)
+{
+	POOL_LOCK();
+	CPoolFreeList& list = GSharedFreeLists[poolClass];
+	if (!list.first)
+		AddPoolChunk(list, poolClass);
+	void* block = list.Pop();
+	POOL_UNLOCK();
+	return block;
+}
+
+static void SharedPoolFree(void* block, int poolClass)
+{
+	POOL_LOCK();
+	GSharedFreeLists[poolClass].Push((CPoolFreeBlock*)block);
+	POOL_UNLOCK();
+}
+
+FORCEINLINE void* PoolAlloc(int size)
+{
+	if (GThreadMemory.bDestroyed)
+		return SharedPoolAlloc(GetPoolClass(size));
+	CPoolFreeList& list = GThreadMemory.FreeLists[GetPoolClass(size)];
+	if (!list.first)
+		RefillPool(list, GetPoolClass(size));
+	return list.Pop();
+}
+
+FORCEINLINE void PoolFree(void* block, int size)
+{
+	int poolClass = GetPoolClass(size);
+	if (GThreadMemory.bDestroyed)
+	{
+		SharedPoolFree(block, poolClass);
+		return;
+	}
+	CPoolFreeList& list = GThreadMemory.FreeLists[poolClass];
+	list.Push((CPoolFreeBlock*)block);
+	if (list.count > POOL_BATCH * 2)
+	{
+		// Too many cached blocks, this could happen when the thread releases memory allocated
+		// by other threads. Give some blocks back.
+		POOL_LOCK();
+		list.MoveTo(GSharedFreeLists[poolClass], POOL_BATCH);
+		POOL_UNLOCK();
+	}
+}
+
+/*-----------------------------------------------------------------------------
+	Huge blocks
+-----------------------------------------------------------------------------*/
+
+// Huge blocks are allocated directly from the OS. Such memory is zero-filled, and on Linux it could
+// be resized without copying. CHugeBlockInfo is placed immediately before CBlockHeader.
+struct CHugeBlockInfo
+{
+	void*			base;						// start of the mapped memory
+	size_t			mappedSize;
+	size_t			blockSize;					// CBlockHeader::blockSize is 32-bit
+};
+
+FORCEINLINE CHugeBlockInfo* GetHugeBlockInfo(CBlockHeader* hdr)
+{
+	return (CHugeBlockInfo*)hdr - 1;
+}
+
+FORCEINLINE size_t GetBlockSize(CBlockHeader* hdr)
+{
+	return (hdr->magic == HUGE_BLOCK_MAGIC) ? GetHugeBlockInfo(hdr)->blockSize : hdr->blockSize;
 }
 
-void* appMalloc(int size, int alignment, bool noInit)
+static void* AllocHugeBlock(size_t size, int alignment)
+{
+	size_t headerSize = Align(sizeof(CHugeBlockInfo) + sizeof(CBlockHeader), alignment);
+	size_t mappedSize = Align(size + headerSize, HUGE_BLOCK_GRANULARITY);
+#ifdef _WIN32
+	void* base = VirtualAlloc(NULL, mappedSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (!base)
+		OutOfMemory(size);
+#else
+	void* base = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		OutOfMemory(size);
+	#ifdef MADV_HUGEPAGE
+	// Ask for transparent huge pages, this reduces TLB misses when processing large buffers
+	madvise(base, mappedSize, MADV_HUGEPAGE);
+	#endif
+#endif // _WIN32
+
+	void* ptr = OffsetPointer(base, headerSize);
+	CBlockHeader* hdr = (CBlockHeader*)ptr - 1;
+	hdr->magic     = HUGE_BLOCK_MAGIC;
+	hdr->offset    = 0;						// not used
+	hdr->align     = alignment - 1;
+	hdr->blockSize = 0;						// not used
+	CHugeBlockInfo* info = GetHugeBlockInfo(hdr);
+	info->base       = base;
+	info->mappedSize = mappedSize;
+	info->blockSize  = size;
+	return ptr;
+}
+
+// Resize the block without copying of data. Returns NULL if this is not possible.
+static void* ReallocHugeBlock(CBlockHeader* hdr, size_t newSize)
+{
+#ifdef __linux__
+	CHugeBlockInfo* info = GetHugeBlockInfo(hdr);
+	size_t headerSize = (byte*)(hdr + 1) - (byte*)info->base;
+	size_t mappedSize = Align(newSize + headerSize, HUGE_BLOCK_GRANULARITY);
+	void* base = info->base;
+	if (mappedSize != info->mappedSize)
+	{
+		base = mremap(info->base, info->mappedSize, mappedSize, MREMAP_MAYMOVE);
+		if (base == MAP_FAILED)
+			return NULL;
+	#ifdef MADV_HUGEPAGE
+		madvise(base, mappedSize, MADV_HUGEPAGE);
+	#endif
+	}
+	void* ptr = OffsetPointer(base, headerSize);
+	info = GetHugeBlockInfo((CBlockHeader*)ptr - 1);
+	info->base       = base;
+	info->mappedSize = mappedSize;
+	info->blockSize  = newSize;
+	return ptr;
+#else
+	return NULL;
+#endif // __linux__
+}
+
+static void FreeHugeBlock(CBlockHeader* hdr)
+{
+	CHugeBlockInfo* info = GetHugeBlockInfo(hdr);
+#ifdef _WIN32
+	VirtualFree(info->base, 0, MEM_RELEASE);
+#else
+	munmap(info->base, info->mappedSize);
+#endif
+}
+
+// Release memory block allocated in appMalloc, 'hdr' should be still valid; 'magic' is
+// the block's magic before it was modified
+FORCEINLINE void ReleaseBlock(CBlockHeader* hdr, byte magic)
+{
+	if (magic == HUGE_BLOCK_MAGIC)
+	{
+		FreeHugeBlock(hdr);
+		return;
+	}
+	void* block = OffsetPointer(hdr + 1, -(hdr->offset + 1));
+	if (magic == POOL_BLOCK_MAGIC)
+		PoolFree(block, hdr->blockSize + sizeof(CBlockHeader) + hdr->align);
+	else
+		free(block);
+}
+
+
+void* appMalloc(size_t size, int alignment, bool noInit)
 {
 	guard(appMalloc);
 	PROFILE_LABEL(noInit ? "NoInit" : "Zero");
@@ -137,31 +558,44 @@ void* appMalloc(int size, int alignment, bool noInit)
 	if (!ReservedMemory) ReservedMemory = malloc(RESERVE_MEMORY_SIZE);
 #endif
 
-	if (size < 0 || size >= MAX_ALLOCATION_SIZE)
-		appError("Memory: bad allocation size %d bytes", size);
+	if (size >= MAX_ALLOCATION_SIZE)
+		appError("Memory: bad allocation size " FORMAT_SIZE("d") " bytes", size);
 	assert(alignment > 1 && alignment <= 256 && ((alignment & (alignment - 1)) == 0));
 
-	// Allocate memory
-	void* block = malloc(size + sizeof(CBlockHeader) + (alignment - 1));
-	if (!block)
-		OutOfMemory(size);
-
-	// Initialize the allocated block
-	void* ptr = Align(OffsetPointer(block, sizeof(CBlockHeader)), alignment);
-	if (size > 0 && !noInit)
-		memset(ptr, 0, size);
+	void* ptr;
+	CBlockHeader* hdr;
+	if (size >= HUGE_BLOCK_SIZE)
+	{
+		// Memory is already zero-filled
+		ptr = AllocHugeBlock(size, alignment);
+		hdr = (CBlockHeader*)ptr - 1;
+	}
+	else
+	{
+		// Allocate memory, small blocks are taken from thread's pools
+		int rawSize = (int)size + sizeof(CBlockHeader) + (alignment - 1);
+		bool bPooled = rawSize <= POOL_MAX_BLOCK;
+		void* block = bPooled ? PoolAlloc(rawSize) : malloc(rawSize);
+		if (!block)
+			OutOfMemory(size);
+
+		// Initialize the allocated block
+		ptr = Align(OffsetPointer(block, sizeof(CBlockHeader)), alignment);
+		if (size > 0 && !noInit)
+			memset(ptr, 0, size);
 #if DEBUG_MEMORY
-	else if (size > 0)
-		memset(ptr, UNINIT_BLOCK, size);
+		else if (size > 0)
+			memset(ptr, UNINIT_BLOCK, size);
 #endif
 
-	// Prepare block header
-	CBlockHeader *hdr = (CBlockHeader*)ptr - 1;
-	byte offset = (byte*)ptr - (byte*)block;
-	hdr->magic     = BLOCK_MAGIC;
-	hdr->offset    = offset - 1;
-	hdr->align     = alignment - 1;
-	hdr->blockSize = size;
+		// Prepare block header
+		hdr = (CBlockHeader*)ptr - 1;
+		byte offset = (byte*)ptr - (byte*)block;
+		hdr->magic     = bPooled ? POOL_BLOCK_MAGIC : BLOCK_MAGIC;
+		hdr->offset    = offset - 1;
+		hdr->align     = alignment - 1;
+		hdr->blockSize = (int)size;
+	}
 
 #if DEBUG_MEMORY
 	// Setup debug stuff
@@ -181,22 +615,7 @@ void* appMalloc(int size, int alignment, bool noInit)
 	appCaptureStackTrace(stack.stack, MAX_STACK_TRACE, 2);
 	stack.UpdateHash();
 	// Find similar call stack
-	CStackTrace* found = NULL;
-	for (int i = 0; i < GNumAllocationPoints; i++)
-	{
-		if (stack == GAllocationPoints[i])
-		{
-			found = &GAllocationPoints[i];
-			break;
-		}
-	}
-	if (!found)
-	{
-		assert(GNumAllocationPoints < MAX_ALLOCATION_POINTS);
-		found = &GAllocationPoints[GNumAllocationPoints++];
-		*found = stack;
-	}
-	hdr->stack = found;
+	hdr->stack = FindAllocationPoint(stack);
 	#if THREADING
 	if (bLocked)
 	{
@@ -210,17 +629,16 @@ void* appMalloc(int size, int alignment, bool noInit)
 #endif
 
 	// statistics
-	InterlockedAdd(&GTotalAllocationSize, size);
-	InterlockedIncrement(&GTotalAllocationCount);
+	UpdateAllocationStats(size, 1);
 #if PROFILE
 	InterlockedIncrement(&GNumAllocs);
 #endif
 
 	return ptr;
-	unguardf("size=%d (total=%d Mbytes)", size, (int)(GTotalAllocationSize >> 20));
+	unguardf("size=" FORMAT_SIZE("d") " (total=%d Mbytes)", size, (int)(appGetAllocationSize() >> 20));
 }
 
-void* appRealloc(void* ptr, int newSize)
+void* appRealloc(void* ptr, size_t newSize)
 {
 	guard(appRealloc);
 
@@ -228,11 +646,48 @@ void* appRealloc(void* ptr, int newSize)
 	if (!ptr) return appMallocNoInit(newSize);
 
 	CBlockHeader* hdr = (CBlockHeader*)ptr - 1;
-	assert(hdr->magic == BLOCK_MAGIC);
 
-	int oldSize = hdr->blockSize;
+	if (hdr->magic == ARENA_BLOCK_MAGIC)
+	{
+		// Arena memory can't be resized, move the block to the heap
+		size_t oldSize = hdr->blockSize;
+		if (oldSize == newSize) return ptr;
+		void* newData = appMallocNoInit(newSize, hdr->align + 1);
+		memcpy(newData, ptr, min(newSize, oldSize));
+		GetBlockArena(hdr)->Free(ptr);
+		return newData;
+	}
+
+	byte magic = hdr->magic;
+	assert(magic == BLOCK_MAGIC || magic == POOL_BLOCK_MAGIC || magic == HUGE_BLOCK_MAGIC);
+
+	size_t oldSize = GetBlockSize(hdr);
 	if (oldSize == newSize) return ptr;	// size not changed
 
+	if (magic == HUGE_BLOCK_MAGIC && newSize >= HUGE_BLOCK_SIZE)
+	{
+		// Try to resize the block in place, without copying
+#if DEBUG_MEMORY
+		UnlinkBlock(hdr);
+#endif
+		void* newData = ReallocHugeBlock(hdr, newSize);
+		if (newData)
+		{
+#if DEBUG_MEMORY
+			LinkBlock((CBlockHeader*)newData - 1);
+#endif
+#if TRACY_DEBUG_MALLOC
+			PROFILE_FREE(ptr);
+			PROFILE_ALLOC(newData, newSize);
+#endif
+			UpdateAllocationStats(newSize - oldSize, 0);
+			return newData;
+		}
+#if DEBUG_MEMORY
+		LinkBlock(hdr);
+#endif
+	}
+
 	// Allocate new memory block and copy contents
 	int alignment = hdr->align + 1;
 	void* newData = appMallocNoInit(newSize, alignment);
@@ -240,28 +695,14 @@ void* appRealloc(void* ptr, int newSize)
 
 	// Release old memory block
 	hdr->magic--;		// modify to any value
-	int offset = hdr->offset + 1;
-	void* block = OffsetPointer(ptr, -offset);
 
 #if DEBUG_MEMORY
-	#if THREADING
-	if (CThread::NumThreads)
-	{
-		GMallocMutex.Lock();
-		hdr->Unlink();
-		GMallocMutex.Unlock();
-	}
-	else
-	{
-		hdr->Unlink();
-	}
-	#else
-	hdr->Unlink();
-	#endif
-	memset(ptr, FREE_BLOCK, oldSize);
+	UnlinkBlock(hdr);
+	if (magic != HUGE_BLOCK_MAGIC)
+		memset(ptr, FREE_BLOCK, oldSize);
 #endif
 
-	free(block);
+	ReleaseBlock(hdr, magic);
 
 #if TRACY_DEBUG_MALLOC
 	PROFILE_FREE(ptr);
@@ -270,8 +711,7 @@ void* appRealloc(void* ptr, int newSize)
 
 	// statistics: we're allocating a new block with appMalloc, which counts statistics
 	// for this allocation, so only eliminate statistics from old memory block here
-	InterlockedAdd(&GTotalAllocationSize, -oldSize);
-	InterlockedDecrement(&GTotalAllocationCount);
+	UpdateAllocationStats(-oldSize, -1);
 
 #if PROFILE
 	InterlockedIncrement(&GNumAllocs);
@@ -288,28 +728,23 @@ void appFree(void* ptr)
 	assert(ptr);
 
 	CBlockHeader* hdr = (CBlockHeader*)ptr - 1;
-	assert(hdr->magic == BLOCK_MAGIC);
+
+	if (hdr->magic == ARENA_BLOCK_MAGIC)
+	{
+		GetBlockArena(hdr)->Free(ptr);
+		return;
+	}
+
+	byte magic = hdr->magic;
+	assert(magic == BLOCK_MAGIC || magic == POOL_BLOCK_MAGIC || magic == HUGE_BLOCK_MAGIC);
+	size_t size = GetBlockSize(hdr);
 
 	hdr->magic--;		// modify to any value
-	int offset = hdr->offset + 1;
-	void* block = OffsetPointer(ptr, -offset);
 
 #if DEBUG_MEMORY
-	#if THREADING
-	if (CThread::NumThreads)
-	{
-		GMallocMutex.Lock();
-		hdr->Unlink();
-		GMallocMutex.Unlock();
-	}
-	else
-	{
-		hdr->Unlink();
-	}
-	#else
-	hdr->Unlink();
-	#endif
-	memset(ptr, FREE_BLOCK, hdr->blockSize);
+	UnlinkBlock(hdr);
+	if (magic != HUGE_BLOCK_MAGIC)
+		memset(ptr, FREE_BLOCK, size);
 #endif
 
 #if TRACY_DEBUG_MALLOC
@@ -317,10 +752,9 @@ void appFree(void* ptr)
 #endif
 
 	// statistics
-	InterlockedAdd(&GTotalAllocationSize, -hdr->blockSize);
-	InterlockedDecrement(&GTotalAllocationCount);
+	UpdateAllocationStats(-size, -1);
 
-	free(block);
+	ReleaseBlock(hdr, magic);
 
 	unguard;
 }
@@ -338,7 +772,9 @@ void* CMemoryChain::operator new(size_t size, int dataSize)
 	if (!chain)
 		appError("Failed to allocate %d bytes", alloc);
 	chain->size = alloc;
+	chain->chunkSize = dataSize;
 	chain->next = NULL;
+	chain->current = chain;
 	chain->data = (byte*) OffsetPointer(chain, size);
 	chain->end  = (byte*) OffsetPointer(chain, alloc);
 
@@ -357,7 +793,7 @@ void CMemoryChain::operator delete(void *ptr)
 	{
 		// free memory block
 		next = curr->next;
-		free(curr);				//!! deallocate
+		appFree(curr);			// allocated with appMalloc() in operator new
 	}
 	unguard;
 }
@@ -369,8 +805,9 @@ void *CMemoryChain::Alloc(size_t size, int alignment)
 	guard(CMemoryChain::Alloc);
 	if (!size) return NULL;
 
-	// sequence of blocks (with using "next" field): 1(==this)->5(last)->4->3->2->NULL
-	CMemoryChain *b = (next) ? next : this;			// block for allocation
+	// sequence of blocks (with using "next" field): 1(==this)->N(last)->...->2->NULL, 'current' points
+	// to the block used for allocations
+	CMemoryChain *b = current;						// block for allocation
 	byte* start = Align(b->data, alignment);		// start of new allocation
 	// check block free space
 	if (start + size > b->end)
@@ -379,7 +816,10 @@ void *CMemoryChain::Alloc(size_t size, int alignment)
 		guard(NewMemoryChain);
 		//?? may be, search in other blocks ...
 		// allocate in the new block
-		b = new (size + alignment - 1) CMemoryChain;
+		int blockSize = chunkSize - sizeof(CMemoryChain);
+		if (int(size + alignment - 1) > blockSize) blockSize = int(size + alignment - 1);
+		b = new (blockSize) CMemoryChain;
+		b->chunkSize = chunkSize;
 		// insert new block immediately after 1st block (==this)
 		b->next = next;
 		next = b;
@@ -388,21 +828,101 @@ void *CMemoryChain::Alloc(size_t size, int alignment)
 	}
 	// update pointer to a free space
 	b->data = start + size;
+	// continue allocations from the block with more free space, so a large allocation
+	// won't waste the rest of the current block
+	if (b != current && b->end - b->data > current->end - current->data)
+		current = b;
 
 	return start;
 	unguard;
 }
 
 
-int CMemoryChain::GetSize() const
+size_t CMemoryChain::GetSize() const
 {
-	int n = 0;
+	size_t n = 0;
 	for (const CMemoryChain *c = this; c; c = c->next)
 		n += c->size;
 	return n;
 }
 
 
+/*-----------------------------------------------------------------------------
+	CMemoryArena
+-----------------------------------------------------------------------------*/
+
+CMemoryArena::CMemoryArena(const char* InName, int ChunkSize)
+:	Name(InName)
+,	NumAllocs(0)
+,	NumFrees(0)
+,	AllocatedBytes(0)
+,	NumLiveAllocs(0)
+{
+	Chain = new (ChunkSize) CMemoryChain();
+}
+
+CMemoryArena::~CMemoryArena()
+{
+	delete Chain;
+}
+
+void* CMemoryArena::Alloc(int size, int alignment, bool noInit)
+{
+	guard(CMemoryArena::Alloc);
+
+	// Align to pointer size, the owner pointer is placed before the block header
+	if (alignment < sizeof(CMemoryArena*)) alignment = sizeof(CMemoryArena*);
+	int extraSize = sizeof(CMemoryArena*) + sizeof(CBlockHeader);
+	byte* block = (byte*)Chain->Alloc(size + extraSize + alignment - 1, 1);
+
+	void* ptr = Align(block + extraSize, alignment);
+	// Chain blocks are zero-filled on allocation, and arena memory is never reused, so
+	// there's no need to clear the memory
+#if DEBUG_MEMORY
+	if (noInit && size > 0)
+		memset(ptr, UNINIT_BLOCK, size);
+#endif
+
+	CBlockHeader *hdr = (CBlockHeader*)ptr - 1;
+	hdr->magic     = ARENA_BLOCK_MAGIC;
+	hdr->offset    = 0;				// not used
+	hdr->align     = alignment - 1;
+	hdr->blockSize = size;
+	GetBlockArena(hdr) = this;
+
+	// statistics
+	NumAllocs++;
+	AllocatedBytes += size;
+	InterlockedIncrement(&NumLiveAllocs);
+
+	return ptr;
+
+	unguardf("size=%d", size);
+}
+
+void CMemoryArena::Free(void* ptr)
+{
+	InterlockedIncrement(&NumFrees);
+	InterlockedDecrement(&NumLiveAllocs);
+}
+
+void CMemoryArena::Release()
+{
+	guard(CMemoryArena::Release);
+	// All memory is released here, so nothing should point to the arena anymore
+	if (NumLiveAllocs != 0)
+		appError("Memory arena %s: %d blocks are still in use", Name, NumLiveAllocs);
+	delete this;
+	unguard;
+}
+
+void CMemoryArena::PrintStats() const
+{
+	appPrintf("Memory arena %s: %d allocations, " FORMAT_SIZE("u") " bytes, %d frees skipped, peak " FORMAT_SIZE("u") " bytes reserved\n",
+		Name, NumAllocs, AllocatedBytes, NumFrees, Chain->GetSize());
+}
+
+
 /*-----------------------------------------------------------------------------
 	Debugging information
 -----------------------------------------------------------------------------*/
@@ -412,7 +932,7 @@ int CMemoryChain::GetSize() const
 struct CAllocInfo
 {
 	int				totalBlocks;
-	unsigned		totalBytes;
+	size_t			totalBytes;
 	const CStackTrace* stack;
 };
 
@@ -430,34 +950,31 @@ void appDumpMemoryAllocations()
 {
 	appPrintf(
 		"Memory information:\n"
-		FORMAT_SIZE("u")" bytes allocated in %d blocks from %d points\n\n", GTotalAllocationSize, GTotalAllocationCount, GNumAllocationPoints
+		FORMAT_SIZE("u")" bytes allocated in %d blocks from %d points, " FORMAT_SIZE("u") " bytes reserved for small block pools\n\n",
+		appGetAllocationSize(), appGetAllocationCount(), GNumAllocationPoints, GPoolReservedBytes
 	);
 
-	// collect statistics
-	CAllocInfo allocations[MAX_ALLOCATION_POINTS];
+	// collect statistics; static array to not overflow the stack, and to not allocate anything when out of memory
+	static CAllocInfo allocations[MAX_ALLOCATION_POINTS];
 	memset(allocations, 0, sizeof(allocations));
-	int numAllocations = 0;
 
 	for (const CBlockHeader* hdr = CBlockHeader::first; hdr; hdr = hdr->next)
 	{
-		const CStackTrace* stack = hdr->stack;
-		CAllocInfo* info = NULL;
-		for (int i = 0; i < numAllocations; i++)
-			if (allocations[i].stack == stack)
-			{
-				info = &allocations[i];
-				break;
-			}
-		if (!info)
-		{
-			assert(numAllocations < MAX_ALLOCATION_POINTS);
-			info = &allocations[numAllocations++];
-			info->stack = stack;
-		}
-		info->totalBytes += hdr->blockSize;
+		// allocations are indexed in the same way as GAllocationPoints
+		CAllocInfo* info = &allocations[hdr->stack - GAllocationPoints];
+		info->stack = hdr->stack;
+		info->totalBytes += GetBlockSize(const_cast<CBlockHeader*>(hdr));
 		info->totalBlocks++;
 	}
 
+	// remove unused entries
+	int numAllocations = 0;
+	for (int i = 0; i < MAX_ALLOCATION_POINTS; i++)
+	{
+		if (allocations[i].totalBlocks)
+			allocations[numAllocations++] = allocations[i];
+	}
+
 	// sort by allocation size
 	QSort(allocations, numAllocations, CompareAllocInfo);
 
@@ -465,7 +982,7 @@ void appDumpMemoryAllocations()
 	for (int i = 0; i < numAllocations; i++)
 	{
 		const CAllocInfo* info = &allocations[i];
-		appPrintf("%d blocks %u bytes\n", info->totalBlocks, info->totalBytes);
+		appPrintf("%d blocks " FORMAT_SIZE("u") " bytes\n", info->totalBlocks, info->totalBytes);
 		info->stack->Dump();
 		appPrintf("\n");
 	}
@@ -7,11 +7,16 @@
 #include <Windows.h>
 #include <process.h> // _beginthread
 
+#else
+
+#include <unistd.h> // usleep
+
 #endif // _WIN32
 
 #include "Parallel.h"
 
 bool GEnableThreads = true;
+int GMaxThreads = 0;
 
 volatile int CThread::NumThreads = 0;
 
@@ -236,7 +241,7 @@ void CThread::Start()
 
 /*static*/ void CThread::Sleep(int milliseconds)
 {
-	SDL_Delay(milliseconds); //todo: implement in other way
+	usleep(milliseconds * 1000);
 }
 
 /*static*/ int CThread::GetLogicalCPUCount()
@@ -305,262 +310,459 @@ namespace ThreadPool
 
 #define MAX_POOL_THREADS 64
 
-// Task queue
-namespace Queue
-{
+// Index of task deque owned by the current thread: 0 for threads outside of the pool (they're
+// sharing the same deque), 1..NumPoolThreads for pool threads.
+static thread_local int GCurrentDequeIndex = 0;
+
+// Number of tasks which were queued but not yet completed
+static volatile int32 NumPendingTasks = 0;
+
+/*-----------------------------------------------------------------------------
+	Task deques
+-----------------------------------------------------------------------------*/
+
+static void NotifyWaiters(const void* Group);
 
 struct CTask
 {
 	ThreadTask	task;
 	void*		data;
 	CSemaphore* fence;
+	// Tasks of the same group are the only ones which could be executed by a thread waiting for this
+	// group, see HelpWithTask()
+	const void*	group;
 
 	void Exec()
 	{
 		guard(QueueTask::Exec);
 		task(data);
 		if (fence) fence->Signal();
+		InterlockedDecrement(&NumPendingTasks);
+		// The task could change a counter somebody is waiting for
+		NotifyWaiters(NULL);
 		unguard;
 	}
 };
 
-
-CMutex Mutex;
-static CTask Queue[MAX_POOL_THREADS / 2];
-static int QueueSize = 0;
-
-// This function returns false if queue size wasn't enough for returning immediately
-bool PutToQueue(ThreadTask task, void* data, CSemaphore* fence)
+// Double-ended task queue. Owner thread puts and takes tasks from the back, other threads are
+// stealing tasks from the front, so the oldest (usually the largest) work is stolen first.
+// Note: the deque is protected with a mutex, it is not a lock-free one. Tasks are expected to be
+// much longer than a lock, and the mutex is contended only when threads are stealing work.
+struct CTaskDeque
 {
-	guard(Queue::PutToQueue);
+	CMutex		Mutex;
+	CTask*		Items = NULL;
+	int			Capacity = 0;				// power of 2
+	int			First = 0;
+	volatile int Count = 0;
 
-	// Get size of queue
-	static int MaxQueueSize = -1;
-	if (MaxQueueSize < 0)
+	void PushBack(const CTask& Task)
 	{
-		MaxQueueSize = CThread::GetLogicalCPUCount() * 2;
-		if (MaxQueueSize > ARRAY_COUNT(Queue))
-			MaxQueueSize = ARRAY_COUNT(Queue);
+		CMutex::ScopedLock Lock(Mutex);
+		if (Count == Capacity) Grow();
+		Items[(First + Count) & (Capacity - 1)] = Task;
+		Count++;
 	}
 
-	CTask ToExec;
+	bool PopBack(CTask& Task)
+	{
+		if (!Count) return false;			// quick check without locking
+		CMutex::ScopedLock Lock(Mutex);
+		if (!Count) return false;
+		Count--;
+		Task = Items[(First + Count) & (Capacity - 1)];
+		return true;
+	}
 
-	{ // Lock scope
+	bool PopFront(CTask& Task)
+	{
+		if (!Count) return false;
 		CMutex::ScopedLock Lock(Mutex);
+		if (!Count) return false;
+		Task = Items[First];
+		First = (First + 1) & (Capacity - 1);
+		Count--;
+		return true;
+	}
 
-		if (QueueSize < MaxQueueSize)
+	// Take the most recently queued task of the group
+	bool PopGroup(CTask& Task, const void* Group)
+	{
+		if (!Count) return false;
+		CMutex::ScopedLock Lock(Mutex);
+		for (int i = Count - 1; i >= 0; i--)
 		{
-			// Just put task to queue and return
-			CTask& Item = Queue[QueueSize++];
-			Item.task = task;
-			Item.data = data;
-			Item.fence = fence;
+			if (Items[(First + i) & (Capacity - 1)].group != Group) continue;
+			Task = Items[(First + i) & (Capacity - 1)];
+			// Remove the task, shift the following ones
+			for (int j = i + 1; j < Count; j++)
+				Items[(First + j - 1) & (Capacity - 1)] = Items[(First + j) & (Capacity - 1)];
+			Count--;
 			return true;
 		}
+		return false;
+	}
 
-		// There's not enough space in queue, execute the first item and put new one to the queue's back
-
-		// Grab the first item from queue
-		ToExec = Queue[0];
-		memmove(&Queue[0], &Queue[1], sizeof(CTask) * (QueueSize - 1));
+	bool HasGroup(const void* Group)
+	{
+		if (!Count) return false;
+		CMutex::ScopedLock Lock(Mutex);
+		for (int i = 0; i < Count; i++)
+		{
+			if (Items[(First + i) & (Capacity - 1)].group == Group)
+				return true;
+		}
+		return false;
+	}
 
-		// Put new item
-		CTask& Item = Queue[QueueSize - 1];
-		Item.task = task;
-		Item.data = data;
-		Item.fence = fence;
+protected:
+	void Grow()
+	{
+		int NewCapacity = Capacity ? Capacity * 2 : 64;
+		CTask* NewItems = new CTask[NewCapacity];
+		for (int i = 0; i < Count; i++)
+			NewItems[i] = Items[(First + i) & (Capacity - 1)];
+		delete[] Items;
+		Items = NewItems;
+		Capacity = NewCapacity;
+		First = 0;
 	}
+};
 
-	// Execute the first item in current thread
-	ToExec.Exec();
+static CTaskDeque Deques[MAX_POOL_THREADS + 1];
 
-	// Indicate that we didn't put task to pool, but executed something
-	return false;
+/*-----------------------------------------------------------------------------
+	Waiting for counters
+-----------------------------------------------------------------------------*/
 
-	unguard;
+// A thread blocked in WaitForCounter(). It is woken up when its counter drops to zero, or when a
+// task of its group is queued, so the waiting thread could help with its execution.
+struct CWaiter
+{
+	volatile int32*		Counter;
+	const void*			Group;				// NULL when the thread could execute any task
+	CSemaphore			Signal;
+	CWaiter*			Next;
+};
+
+static CMutex WaitMutex;
+static CWaiter* Waiters = NULL;
+static volatile int NumWaiters = 0;			// number of registered waiters, used for quick check
+
+// Wake waiters whose counters dropped to zero. When NewTaskGroup is not NULL, a task of this group
+// was queued, also wake one waiter which could execute it.
+static void NotifyWaiters(const void* NewTaskGroup)
+{
+	if (!NumWaiters) return;				// quick check without locking
+	CMutex::ScopedLock Lock(WaitMutex);
+	CWaiter** Prev = &Waiters;
+	while (CWaiter* W = *Prev)
+	{
+		bool bCanExecute = NewTaskGroup && (!W->Group || W->Group == NewTaskGroup);
+		if (bCanExecute || *W->Counter <= 0)
+		{
+			*Prev = W->Next;
+			NumWaiters--;
+			W->Signal.Signal();
+			if (bCanExecute) NewTaskGroup = NULL;
+		}
+		else
+		{
+			Prev = &W->Next;
+		}
+	}
 }
 
-bool GetFromQueue(CTask& item)
+/*-----------------------------------------------------------------------------
+	Pool threads
+-----------------------------------------------------------------------------*/
+
+namespace Pool
 {
-	CMutex::ScopedLock Lock(Mutex);
 
-	if (!QueueSize)
-		return false;
+static int NumPoolThreads = -1;				// -1 = not initialized yet
+static CMutex Mutex;
+static volatile bool bShutdown = false;
+
+// Sleeping threads support
+static CMutex SleepMutex;
+static CSemaphore WakeSignal;
+static volatile int NumSleeping = 0;		// number of threads waiting for WakeSignal which weren't signaled yet
 
-	item = Queue[0];
-	if (--QueueSize)
+static void Init();
+
+FORCEINLINE int GetNumThreads()
+{
+	if (NumPoolThreads < 0) Init();
+	return NumPoolThreads;
+}
+
+static bool HasQueuedTasks()
+{
+	for (int i = 0; i <= NumPoolThreads; i++)
 	{
-		memmove(&Queue[0], &Queue[1], sizeof(CTask) * QueueSize);
+		if (Deques[i].Count) return true;
 	}
+	return false;
+}
 
-	return true;
+// Check for tasks which could be executed by the waiter
+static bool HasQueuedTasks(const CWaiter& Waiter)
+{
+	if (!Waiter.Group) return HasQueuedTasks();
+	for (int i = 0; i <= NumPoolThreads; i++)
+	{
+		if (Deques[i].HasGroup(Waiter.Group)) return true;
+	}
+	return false;
 }
 
-} // namespace Queue
+// Get a task from own deque, or steal it from other threads
+static bool GetTask(int DequeIndex, CTask& Task)
+{
+	if (Deques[DequeIndex].PopBack(Task))
+		return true;
+	int NumDeques = NumPoolThreads + 1;
+	for (int i = 1; i < NumDeques; i++)
+	{
+		int Victim = DequeIndex + i;
+		if (Victim >= NumDeques) Victim -= NumDeques;
+		if (Deques[Victim].PopFront(Task))
+			return true;
+	}
+	return false;
+}
 
+// Get a task of the group, looking into own deque first
+static bool GetGroupTask(int DequeIndex, CTask& Task, const void* Group)
+{
+	int NumDeques = NumPoolThreads + 1;
+	for (int i = 0; i < NumDeques; i++)
+	{
+		int Victim = DequeIndex + i;
+		if (Victim >= NumDeques) Victim -= NumDeques;
+		if (Deques[Victim].PopGroup(Task, Group))
+			return true;
+	}
+	return false;
+}
 
-// Thread for the pool
-class CPoolThread : public CThread
+static void WakeThread()
 {
-public:
-	// Flag showing if this thead is doing something or not
-	bool bBusy = false;
-	bool bShutdown = false;
+	if (!NumSleeping) return;
+	CMutex::ScopedLock Lock(SleepMutex);
+	if (NumSleeping > 0)
+	{
+		NumSleeping--;
+		WakeSignal.Signal();
+	}
+}
 
-	void AssignTaskAndWake(ThreadTask inTask, void* inData, CSemaphore* inFence)
+static void WaitForWork()
+{
 	{
-		task = inTask;
-		taskData = inData;
-		fence = inFence;
-		sem.Signal();
+		CMutex::ScopedLock Lock(SleepMutex);
+		NumSleeping++;
 	}
+	// Check for work which was queued while we were registering self as sleeping
+	if (HasQueuedTasks() || bShutdown)
+	{
+		SleepMutex.Lock();
+		if (NumSleeping > 0)
+		{
+			// Cancel sleeping
+			NumSleeping--;
+			SleepMutex.Unlock();
+			return;
+		}
+		SleepMutex.Unlock();
+		// Somebody has already sent a signal for us, consume it
+	}
+	WakeSignal.Wait();
+}
 
-	void Shutdown()
+// Wait until the counter of the waiter will drop to zero or a task for the waiter will be queued
+static void WaitForProgress(CWaiter& Waiter)
+{
 	{
-		bShutdown = true;
-		sem.Signal();
+		CMutex::ScopedLock Lock(WaitMutex);
+		Waiter.Next = Waiters;
+		Waiters = &Waiter;
+		NumWaiters++;
 	}
+	// Check for changes which were made while we were registering self as waiting
+	if (*Waiter.Counter <= 0 || HasQueuedTasks(Waiter))
+	{
+		CMutex::ScopedLock Lock(WaitMutex);
+		for (CWaiter** Prev = &Waiters; *Prev; Prev = &(*Prev)->Next)
+		{
+			if (*Prev == &Waiter)
+			{
+				// Cancel waiting
+				*Prev = Waiter.Next;
+				NumWaiters--;
+				return;
+			}
+		}
+		// Somebody has already sent a signal for us, consume it
+	}
+	Waiter.Signal.Wait();
+	// Signal() is called under WaitMutex, wait for its completion before destroying the semaphore
+	CMutex::ScopedLock Lock(WaitMutex);
+}
+
+class CPoolThread : public CThread
+{
+public:
+	CPoolThread(int InDequeIndex)
+	: DequeIndex(InDequeIndex)
+	{}
 
 protected:
 	virtual void Run()
 	{
-		bBusy = false;
+		GCurrentDequeIndex = DequeIndex;
 
 		while (true)
 		{
-			// Wait for signal to start
-			sem.Wait();
-			if (bShutdown) break;
-
-			// Execute task
-			bBusy = true;
-			task(taskData);
-			if (fence) fence->Signal();
-
-			// See if there's something in the queue to execute
-			Queue::CTask task;
-			while (Queue::GetFromQueue(task))
+			CTask Task;
+			if (GetTask(DequeIndex, Task))
 			{
-				task.Exec();
+				Task.Exec();
+				continue;
 			}
-
-			// Return thread to pool
-			bBusy = false;
-			InterlockedDecrement(&NumWorkingThreads);
+			if (bShutdown) break;
+			WaitForWork();
 		}
 		//todo: May be CThread should destroy itself when worker function completed? Just not using CThread anywhere else.
 		delete this;
 	}
 
-	// Executed code
-	ThreadTask task;
-	// Pointer to task context
-	void* taskData;
-	// Object used to signal execution end
-	CSemaphore* fence;
-	// Semaphore used to wake up the thread
-	CSemaphore sem;
-
-public:
-	// Statics
-	// Number of awake threads
-	static volatile int NumWorkingThreads;
+	int DequeIndex;
 };
 
-volatile int CPoolThread::NumWorkingThreads = 0;
-
-// Thread pool itself
-namespace Pool
+static void Init()
 {
+	CMutex::ScopedLock Lock(Mutex);
+	if (NumPoolThreads >= 0) return;
 
-static CPoolThread* Pool[MAX_POOL_THREADS];
-static int NumPoolThreads = 0;
-static CMutex Mutex;
+	int MaxThreads = CThread::GetLogicalCPUCount();
+	MaxThreads = min(MaxThreads, MAX_POOL_THREADS);
+	if (GMaxThreads > 0) MaxThreads = min(MaxThreads, GMaxThreads);
+	--MaxThreads; // exclude main thread
+	if (!GEnableThreads) MaxThreads = 0;
 
-CPoolThread* AllocateFreeThread()
-{
-	CMutex::ScopedLock lock(Mutex);
-
-	// Find idle thread
-	for (int i = 0; i < NumPoolThreads; i++)
+	for (int i = 0; i < MaxThreads; i++)
 	{
-		CPoolThread* Thread = Pool[i];
-		if (!Thread->bBusy)
-		{
-			Thread->bBusy = true;
-			InterlockedIncrement(&CPoolThread::NumWorkingThreads);
-			return Thread;
-		}
+		CPoolThread* NewThread = new CPoolThread(i + 1);
+		NewThread->Start();
 	}
+	NumPoolThreads = MaxThreads;
 
-	static int MaxThreads = -1;
-	if (MaxThreads < 0)
-	{
-		MaxThreads = CThread::GetLogicalCPUCount();
-		MaxThreads = min(MaxThreads, MAX_POOL_THREADS);
-		--MaxThreads; // exclude main thread
-		if (!GEnableThreads) MaxThreads = 0;
+	// Put Shutdown function to 'atexit' sequence
+	atexit(ThreadPool::Shutdown);
+}
 
-		// Put Shutdown function to 'atexit' sequence
-		atexit(ThreadPool::Shutdown);
-	}
+} // namespace Pool
 
-	// Create new thread, if can
-	if (NumPoolThreads < MaxThreads)
-	{
-		CPoolThread* NewThread = new CPoolThread();
+/*-----------------------------------------------------------------------------
+	Public functions
+-----------------------------------------------------------------------------*/
 
-		NewThread->bBusy = true;
-		Pool[NumPoolThreads++] = NewThread;
-		InterlockedIncrement(&CPoolThread::NumWorkingThreads);
+static void EnqueueTask(ThreadTask task, void* data, CSemaphore* fence, const void* group)
+{
+	CTask Task;
+	Task.task = task;
+	Task.data = data;
+	Task.fence = fence;
+	Task.group = group;
 
-		NewThread->Start();
-		return NewThread;
+	if (Pool::GetNumThreads() == 0)
+	{
+		// Threading is disabled
+		InterlockedIncrement(&NumPendingTasks);
+		Task.Exec();
+		return;
 	}
 
-	// No free threads, and can't allocate a new one
-	return NULL;
+	InterlockedIncrement(&NumPendingTasks);
+	Deques[GCurrentDequeIndex].PushBack(Task);
+	Pool::WakeThread();
+	NotifyWaiters(group);
 }
 
-} // namespace Pool
+// Execute one queued task of the group in the current thread, any task when Group is NULL. A thread
+// which is waiting for something may hold locks, so it should execute only tasks related to the
+// thing it is waiting for: an arbitrary task could re-enter the code protected with these locks.
+static bool HelpWithTask(const void* Group)
+{
+	CTask Task;
+	if (Group ? !Pool::GetGroupTask(GCurrentDequeIndex, Task, Group) : !Pool::GetTask(GCurrentDequeIndex, Task))
+		return false;
+	Task.Exec();
+	return true;
+}
 
 bool ExecuteInThread(ThreadTask task, void* taskData, CSemaphore* fence, bool allowQueue)
 {
-	CPoolThread* thread = Pool::AllocateFreeThread();
-	if (thread)
+	int NumThreads = Pool::GetNumThreads();
+	if (!NumThreads)
+		return false;
+
+	if (!allowQueue)
 	{
-		thread->AssignTaskAndWake(task, taskData, fence);
-		return true;
+		// Succeed only if there's a thread which could start this task immediately
+		if (NumPendingTasks >= NumThreads)
+			return false;
 	}
-	else if (allowQueue)
+	else if (NumPendingTasks >= NumThreads * 3)
 	{
-		Queue::PutToQueue(task, taskData, fence);
-		//todo: it is possible that after AllocateFreeThread() call buf before PutToQueue completion, one
-		//todo: of the worker threads will be returned to pool
-		return true;
+		// Too many queued tasks: help with execution of one of them before adding a new one,
+		// so the caller won't produce tasks faster than they are consumed. Only tasks of the same
+		// kind are executed here.
+		HelpWithTask((const void*)task);
 	}
-	else
-	{
+
+	// Tasks are grouped by their function
+	EnqueueTask(task, taskData, fence, (const void*)task);
+	return true;
+}
+
+bool QueueTask(ThreadTask task, void* taskData, volatile int32* counter)
+{
+	if (!Pool::GetNumThreads())
 		return false;
+	EnqueueTask(task, taskData, NULL, (const void*)counter);
+	return true;
+}
+
+static void WaitForCounterImpl(volatile int32* Counter, const void* Group)
+{
+	CWaiter Waiter;
+	Waiter.Counter = Counter;
+	Waiter.Group = Group;
+	while (*Counter > 0)
+	{
+		if (!HelpWithTask(Group))
+		{
+			// Nothing to execute, the remaining work is in progress in other threads
+			Pool::WaitForProgress(Waiter);
+		}
 	}
 }
 
+void WaitForCounter(volatile int32* Counter)
+{
+	WaitForCounterImpl(Counter, (const void*)Counter);
+}
+
 void WaitForCompletion()
 {
 	guard(ThreadPool::WaitForCompletion);
 
-	// Execute tasks from the queue if any
-	Queue::CTask task;
-	while (Queue::GetFromQueue(task))
-	{
-		task.Exec();
-	}
+	// Execute queued tasks in this thread, and wait for tasks executed by pool threads
+	WaitForCounterImpl(&NumPendingTasks, NULL);
 
-	// Wait for all threads to go to the idle state
-	while (CPoolThread::NumWorkingThreads > 0)
-	{
-		CThread::Sleep(20);
-	}
 	unguard;
 }
 
@@ -574,14 +776,17 @@ void Shutdown()
 		return;
 	}
 
+	if (Pool::NumPoolThreads <= 0)
+		return;
+
 	WaitForCompletion();
 	int NumThreadsAfterShutdown = CThread::NumThreads - Pool::NumPoolThreads;
 
 	// Signal to all threads to shutdown
+	Pool::bShutdown = true;
 	for (int i = 0; i < Pool::NumPoolThreads; i++)
 	{
-		CPoolThread* Thread = Pool::Pool[i];
-		Thread->Shutdown();
+		Pool::WakeSignal.Signal();
 	}
 
 	// Wait them to terminate
@@ -610,19 +815,19 @@ namespace ParallelForImpl
 
 ParallelForBase::ParallelForBase(int inCount)
 : numActiveThreads(0)
-, bAllSentToThreads(false)
 , currentIndex(0)
+, bAllSentToThreads(false)
 , lastIndex(inCount)
 {}
 
 ParallelForBase::~ParallelForBase()
 {
-	// Wait for completion: the last thread which will complete the job will
-	// signal 'endSignal' about completion.
+	// Wait for completion of helper tasks. Helpers which weren't picked up by pool threads are
+	// executed in this thread while waiting.
 	if (numActiveThreads)
 	{
 		guard(ParallelForWait);
-		endSignal.Wait();
+		ThreadPool::WaitForCounter(&numActiveThreads);
 		unguard;
 	}
 }
@@ -653,50 +858,41 @@ void ParallelForBase::Start(ThreadPool::ThreadTask worker)
 	printf("ParallelFor: %d, %d, step %d (thread %d)\n", currentIndex, lastIndex, step, CThread::CurrentId()&255);
 #endif
 
-	// Allocate threads, exclude 1 thread for the thread executing ParallelFor
-
-	// Reserve 1 "active thread", so if the 1st spawned thread will finish the job before
-	// we'll be able to spawn anything else - it won't send "completed" signal.
-	InterlockedIncrement(&numActiveThreads);
-
-	// Spawn as many threads as planned. Stop allocating new threads if job will be completed
-	// faster than planned (verify bAllSentToThreads as a loop condition).
+	// Queue helper tasks, exclude 1 thread for the thread executing ParallelFor. Helpers are put to
+	// the current thread's queue, so idle pool threads will steal them. When ParallelFor is called
+	// from a pool thread, this lets other threads to join the nested loop.
 	for (int i = 0; i < numThreads - 1 && !bAllSentToThreads; i++)
 	{
-		// Just in case, increment thread count before starting a thread, so we'll avoid
-		// the situation when worker thread will execute everything before we'll return
-		// to the invoker (main) thread and increment count.
+		// Increment thread count before queueing a task, so we'll avoid the situation when
+		// worker thread will execute everything before we'll return to the invoker thread.
 		InterlockedIncrement(&numActiveThreads);
-		if (!ThreadPool::ExecuteInThread(worker, this))
+		if (!ThreadPool::QueueTask(worker, this, &numActiveThreads))
 		{
-			// All threads has been allocated, can't spawn more.
-			// Decrement the thread count as we've failed to use new thread.
+			// Threading is disabled
 			InterlockedDecrement(&numActiveThreads);
 			break;
 		}
 	}
-
-	// Remove thread "reservation". If at this moment everything has been completed, the
-	// value goes to zero, and we'll not perform waiting for completion in destructor. If
-	// something is still works, then we'll wait, and the worker thread will send a signal
-	// when count finally decremented to 0.
-	InterlockedDecrement(&numActiveThreads);
 }
 
 bool ParallelForBase::GrabInterval(int& idx1, int& idx2)
 {
-	CMutex::ScopedLock lock(mutex);
-	idx1 = currentIndex;
-	if (idx1 >= lastIndex)
+	// Check before atomic operation to avoid overflow of 'currentIndex' with many threads
+	if (currentIndex >= lastIndex)
 	{
 		// All items were sent to threads
 		bAllSentToThreads = true;
 		return false;
 	}
+	idx1 = InterlockedAdd(&currentIndex, step);
+	if (idx1 >= lastIndex)
+	{
+		bAllSentToThreads = true;
+		return false;
+	}
 	idx2 = idx1 + step;
 	if (idx2 > lastIndex)
 		idx2 = lastIndex;
-	currentIndex = idx2;
 #if DEBUG_PARALLEL_FOR
 	printf("thread %d: GET %d .. %d [%d]\n", CThread::CurrentId()&255, idx1, idx2, idx2 - idx1);
 #endif
@@ -195,6 +195,23 @@ FORCEINLINE uint64 InterlockedAdd(volatile uint64* Value, int64 Amount)
 
 #endif // _WIN64
 
+// Pointer publication: AtomicStorePtr() makes all memory writes done before it visible to a thread
+// which has got the pointer with AtomicLoadPtr()
+
+template<typename T>
+FORCEINLINE T* AtomicLoadPtr(T* const volatile* Ptr)
+{
+	T* Value = *Ptr;
+	_ReadWriteBarrier();				// x86 loads have acquire semantics, just prevent compiler reordering
+	return Value;
+}
+
+template<typename T>
+FORCEINLINE void AtomicStorePtr(T* volatile* Ptr, T* Value)
+{
+	_InterlockedExchangePointer((void* volatile*)Ptr, Value);
+}
+
 #else // _WIN32
 
 FORCEINLINE int8 InterlockedIncrement(volatile int8* Value)
@@ -263,6 +280,18 @@ FORCEINLINE uint64 InterlockedAdd(volatile uint64* Value, int64 Amount)
 	return __sync_fetch_and_add(Value, Amount);
 }
 
+template<typename T>
+FORCEINLINE T* AtomicLoadPtr(T* const volatile* Ptr)
+{
+	return __atomic_load_n(Ptr, __ATOMIC_ACQUIRE);
+}
+
+template<typename T>
+FORCEINLINE void AtomicStorePtr(T* volatile* Ptr, T* Value)
+{
+	__atomic_store_n(Ptr, Value, __ATOMIC_RELEASE);
+}
+
 #endif // _WIN32
 
 /*-----------------------------------------------------------------------------
@@ -274,9 +303,23 @@ namespace ThreadPool
 
 typedef void (*ThreadTask)(void*);
 
+// Thread pool uses work stealing: each pool thread has own task queue, tasks queued from pool thread
+// are put to its queue, and idle threads are stealing tasks from queues of other threads. Threads
+// outside of the pool are sharing a single queue. Queues are protected with mutexes.
+// Every task belongs to a group. A thread waiting in WaitForCounter() executes only queued tasks of
+// the group it is waiting for, so it won't re-enter unrelated code while holding its locks.
+
 // Execute ThreadTask in thread. Return false if there's no free threads
 bool ExecuteInThread(ThreadTask task, void* taskData, CSemaphore* fence = NULL, bool allowQueue = false);
 
+// Put the task to the queue of current thread, regardless of number of free threads. The task
+// belongs to the group identified by the counter, and is expected to decrement it on completion.
+// Returns false when threading is disabled.
+bool QueueTask(ThreadTask task, void* taskData, volatile int32* counter);
+
+// Wait until the counter will drop to zero, executing queued tasks of its group meanwhile
+void WaitForCounter(volatile int32* Counter);
+
 #define TryExecuteInThread(...) TryExecuteInThreadImpl(__FUNCTION__, __VA_ARGS__)
 
 template<typename F>
@@ -342,11 +385,9 @@ namespace ParallelForImpl
 class ParallelForBase
 {
 public:
-	CMutex mutex;
-	CSemaphore endSignal;
-	int8 numActiveThreads;
+	volatile int32 numActiveThreads;
+	volatile int32 currentIndex;
 	bool bAllSentToThreads;
-	int currentIndex;
 	int lastIndex;
 	int step;
 
@@ -377,7 +418,6 @@ public:
 		while (GrabInterval(idx1, idx2))
 		{
 			ExecuteRange(idx1, idx2);
-			//todo: may be periodically check if one of threads were released from another work and can be picked up?
 		}
 		unguard;
 	}
@@ -409,9 +449,9 @@ public:
 			w.ExecuteRange(idx1, idx2);
 		}
 
-		// End the thread, send signal if this was the last allocated thread
-		if (InterlockedDecrement(&w.numActiveThreads) == 0)
-			w.endSignal.Signal();
+		// End the helper, the thread executing ParallelFor is waiting for numActiveThreads to become zero.
+		// Don't access 'w' after that.
+		InterlockedDecrement(&w.numActiveThreads);
 
 	#if DEBUG_PARALLEL_FOR
 		printf("...... %d: finished\n", CThread::CurrentId()&255);
@@ -13,6 +13,7 @@
 #include "Exporters.h"
 
 #include "UnrealMesh/UnMathTools.h"
+#include "Parallel.h"
 
 
 // PSK uses right-hand coordinates, but unreal uses left-hand.
@@ -20,6 +21,20 @@
 // Here we performing reverse transformation.
 #define MIRROR_MESH				1
 
+// Chunk data is assembled in memory and written with a single Serialize() call, so structures
+// should have the same layout in memory and in file
+static_assert(sizeof(VVertex) == 16, "VVertex should be packed");
+static_assert(sizeof(VTriangle16) == 12, "VTriangle16 should be packed");
+static_assert(sizeof(VMaterial) == 88, "VMaterial should be packed");
+static_assert(sizeof(VBone) == 120, "VBone should be packed");
+static_assert(sizeof(VRawBoneInfluence) == 12, "VRawBoneInfluence should be packed");
+static_assert(sizeof(FNamedBoneBinary) == 120, "FNamedBoneBinary should be packed");
+static_assert(sizeof(AnimInfoBinary) == 168, "AnimInfoBinary should be packed");
+static_assert(sizeof(VQuatAnimKey) == 32, "VQuatAnimKey should be packed");
+
+// VTriangle32 is not packed in memory, this is its size in file
+#define VTRIANGLE32_FILE_SIZE	18
+
 static void ExportScript(const CSkeletalMesh *Mesh, FArchive &Ar)
 {
 	assert(Mesh->OriginalMesh);
@@ -127,7 +142,6 @@ static void ExportCommonMeshData
 	for (i = 0; i < NumSections; i++)
 	{
 		const CMeshSection &Sec = *SECT(i);
-		numFaces += Sec.NumFaces;
 		for (int j = 0; j < Sec.NumFaces * 3; j++)
 		{
 			int idx = Index(j + Sec.FirstIndex);
@@ -138,89 +152,94 @@ static void ExportCommonMeshData
 	WedgHdr.DataCount = NumVerts;
 	WedgHdr.DataSize  = sizeof(VVertex);
 	SAVE_CHUNK(WedgHdr, "VTXW0000");
-	for (i = 0; i < NumVerts; i++)
-	{
-		VVertex W;
-		const CMeshVertex &S = *VERT(i);
-		W.PointIndex = Share.WedgeToVert[i];
-		W.U          = S.UV.U;
-		W.V          = S.UV.V;
-		W.MatIndex   = WedgeMat[i];
-		W.Reserved   = 0;
-		W.Pad        = 0;
-		if (sizeof(VVertex) == sizeof(int32) * 4)
-		{
-			Ar.Serialize(&W, sizeof(W));
-		}
-		else
+	TArray<VVertex> Wedges;
+	Wedges.AddUninitialized(NumVerts);
+	ParallelFor(NumVerts, [&](int i)
 		{
-			Ar << W;
-		}
-	}
+			VVertex &W = Wedges[i];
+			const CMeshVertex &S = *VERT(i);
+			W.PointIndex = Share.WedgeToVert[i];
+			W.U          = S.UV.U;
+			W.V          = S.UV.V;
+			W.MatIndex   = WedgeMat[i];
+			W.Reserved   = 0;
+			W.Pad        = 0;
+		});
+	Ar.Serialize(Wedges.GetData(), NumVerts * sizeof(VVertex));
 	unguard;
 
 	guard(Faces);
+	// faces of each section are placed after faces of previous sections
+	TArray<int> SectionFirstFace;
+	SectionFirstFace.AddUninitialized(NumSections);
+	for (i = 0, numFaces = 0; i < NumSections; i++)
+	{
+		SectionFirstFace[i] = numFaces;
+		numFaces += SECT(i)->NumFaces;
+	}
 	if (NumVerts <= 65536)
 	{
 		FacesHdr.DataCount = numFaces;
 		FacesHdr.DataSize  = sizeof(VTriangle16);
 		SAVE_CHUNK(FacesHdr, "FACE0000");
+		TArray<VTriangle16> Faces;
+		Faces.AddUninitialized(numFaces);
 		for (i = 0; i < NumSections; i++)
 		{
 			const CMeshSection &Sec = *SECT(i);
-			for (int j = 0; j < Sec.NumFaces; j++)
-			{
-				VTriangle16 T;
-				for (int k = 0; k < 3; k++)
+			// Don't use Faces[] here: the index is out of range for empty trailing sections
+			VTriangle16 *SecFaces = Faces.GetData() + SectionFirstFace[i];
+			ParallelFor(Sec.NumFaces, [&, i](int j)
 				{
-					int idx = Index(Sec.FirstIndex + j * 3 + k);
-					assert((idx & ~0xFFFF) == 0); // (idx >= 0 && idx < 65536);
-					T.WedgeIndex[k] = idx;
-				}
-				T.MatIndex        = i;
-				T.AuxMatIndex     = 0;
-				T.SmoothingGroups = 1;
+					VTriangle16 &T = SecFaces[j];
+					for (int k = 0; k < 3; k++)
+					{
+						int idx = Index(Sec.FirstIndex + j * 3 + k);
+						assert((idx & ~0xFFFF) == 0); // (idx >= 0 && idx < 65536);
+						T.WedgeIndex[k] = idx;
+					}
+					T.MatIndex        = i;
+					T.AuxMatIndex     = 0;
+					T.SmoothingGroups = 1;
 #if MIRROR_MESH
-				Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
+					Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
 #endif
-				if (sizeof(VTriangle16) == 12)
-				{
-					Ar.Serialize(&T, sizeof(T));
-				}
-				else
-				{
-					Ar << T;
-				}
-			}
+				});
 		}
+		Ar.Serialize(Faces.GetData(), numFaces * sizeof(VTriangle16));
 	}
 	else
 	{
 		// pskx extension
 		FacesHdr.DataCount = numFaces;
-		FacesHdr.DataSize  = 18; // sizeof(VTriangle32) without alignment
+		FacesHdr.DataSize  = VTRIANGLE32_FILE_SIZE;
 		SAVE_CHUNK(FacesHdr, "FACE3200");
+		// VTriangle32 is not packed, so store its fields in a byte buffer
+		TArray<byte> Faces;
+		Faces.AddUninitialized(numFaces * VTRIANGLE32_FILE_SIZE);
 		for (i = 0; i < NumSections; i++)
 		{
 			const CMeshSection &Sec = *SECT(i);
-			for (int j = 0; j < Sec.NumFaces; j++)
-			{
-				VTriangle32 T;
-				for (int k = 0; k < 3; k++)
+			byte *SecFaces = Faces.GetData() + SectionFirstFace[i] * VTRIANGLE32_FILE_SIZE;
+			ParallelFor(Sec.NumFaces, [&, i](int j)
 				{
-					int idx = Index(Sec.FirstIndex + j * 3 + k);
-					T.WedgeIndex[k] = idx;
-				}
-				T.MatIndex        = i;
-				T.AuxMatIndex     = 0;
-				T.SmoothingGroups = 1;
+					int32 WedgeIndex[3];
+					for (int k = 0; k < 3; k++)
+					{
+						WedgeIndex[k] = Index(Sec.FirstIndex + j * 3 + k);
+					}
 #if MIRROR_MESH
-				Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
+					Exchange(WedgeIndex[0], WedgeIndex[1]);
 #endif
-				// This structure is not packed, can't use single serialize call for it
-				Ar << T;
-			}
+					uint32 SmoothingGroups = 1;
+					byte *T = SecFaces + j * VTRIANGLE32_FILE_SIZE;
+					memcpy(T, WedgeIndex, sizeof(WedgeIndex));	// WedgeIndex[3]
+					T[12] = i;									// MatIndex
+					T[13] = 0;									// AuxMatIndex
+					memcpy(T + 14, &SmoothingGroups, 4);		// SmoothingGroups
+				});
 		}
+		Ar.Serialize(Faces.GetData(), Faces.Num());
 	}
 	unguard;
 
@@ -228,10 +247,11 @@ static void ExportCommonMeshData
 	MatrHdr.DataCount = NumSections;
 	MatrHdr.DataSize  = sizeof(VMaterial);
 	SAVE_CHUNK(MatrHdr, "MATT0000");
+	TArray<VMaterial> Materials;
+	Materials.AddZeroed(NumSections);
 	for (i = 0; i < NumSections; i++)
 	{
-		VMaterial M;
-		memset(&M, 0, sizeof(M));
+		VMaterial &M = Materials[i];
 		const UUnrealMaterial *Tex = SECT(i)->Material;
 		M.TextureIndex = i; // could be required for UT99
 		//!! this will not handle (UMaterialWithPolyFlags->Material==NULL) correctly - will make MaterialName=="None"
@@ -243,8 +263,8 @@ static void ExportCommonMeshData
 		}
 		else
 			appSprintf(ARRAY_ARG(M.MaterialName), "material_%d", i);
-		Ar << M;
 	}
+	Ar.Serialize(Materials.GetData(), NumSections * sizeof(VMaterial));
 	unguard;
 
 	unguard;
@@ -372,18 +392,20 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 	BoneHdr.DataCount = numBones;
 	BoneHdr.DataSize  = sizeof(VBone);
 	SAVE_CHUNK(BoneHdr, "REFSKELT");
+	TArray<VBone> Bones;
+	Bones.AddZeroed(numBones);
+	// count NumChildren
+	for (i = 0; i < numBones; i++)
+	{
+		int ParentIndex = Mesh.RefSkeleton[i].ParentIndex;
+		if (ParentIndex != i && ParentIndex >= 0 && ParentIndex < numBones)
+			Bones[ParentIndex].NumChildren++;
+	}
 	for (i = 0; i < numBones; i++)
 	{
-		VBone B;
-		memset(&B, 0, sizeof(B));
+		VBone &B = Bones[i];
 		const CSkelMeshBone &S = Mesh.RefSkeleton[i];
 		CopyBoneName(B.Name, sizeof(B.Name), *S.Name);
-		// count NumChildren
-		int NumChildren = 0;
-		for (j = 0; j < numBones; j++)
-			if ((j != i) && (Mesh.RefSkeleton[j].ParentIndex == i))
-				NumChildren++;
-		B.NumChildren = NumChildren;
 		B.ParentIndex = S.ParentIndex;
 		B.BonePos.Position    = (FVector&) S.Position;
 		B.BonePos.Orientation = (FQuat&)   S.Orientation;
@@ -393,54 +415,48 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 		B.BonePos.Orientation.W *= -1;
 		B.BonePos.Position.Y    *= -1;
 #endif
-
-		Ar << B;
 	}
+	Ar.Serialize(Bones.GetData(), numBones * sizeof(VBone));
 	unguard;
 
 	// count influences
 	guard(Influences);
-	int NumInfluences = 0;
-	for (i = 0; i < Share.Points.Num(); i++)
-	{
-		int WedgeIndex = Share.VertToWedge[i];
-		const CSkelMeshVertex &V = Lod.Verts[WedgeIndex];
-		for (j = 0; j < NUM_INFLUENCES; j++)
+	int NumPoints = Share.Points.Num();
+	TArray<int> FirstInfluence;				// index of the first influence of each point
+	FirstInfluence.AddUninitialized(NumPoints + 1);
+	FirstInfluence[0] = 0;
+	ParallelFor(NumPoints, [&](int i)
 		{
-			if (V.Bone[j] < 0) break;
-			NumInfluences++;
-		}
-	}
+			const CSkelMeshVertex &V = Lod.Verts[Share.VertToWedge[i]];
+			int Count = 0;
+			while (Count < NUM_INFLUENCES && V.Bone[Count] >= 0)
+				Count++;
+			FirstInfluence[i + 1] = Count;
+		});
+	for (i = 0; i < NumPoints; i++)
+		FirstInfluence[i + 1] += FirstInfluence[i];
+	int NumInfluences = FirstInfluence[NumPoints];
 	// write influences
 	InfHdr.DataCount = NumInfluences;
 	InfHdr.DataSize  = sizeof(VRawBoneInfluence);
 	SAVE_CHUNK(InfHdr, "RAWWEIGHTS");
-	for (i = 0; i < Share.Points.Num(); i++)
-	{
-		int WedgeIndex = Share.VertToWedge[i];
-		const CSkelMeshVertex &V = Lod.Verts[WedgeIndex];
-		CVec4 UnpackedWeights;
-		V.UnpackWeights(UnpackedWeights);
-		for (j = 0; j < NUM_INFLUENCES; j++)
+	TArray<VRawBoneInfluence> Influences;
+	Influences.AddUninitialized(NumInfluences);
+	ParallelFor(NumPoints, [&](int i)
 		{
-			if (V.Bone[j] < 0) break;
-			NumInfluences--;				// just for verification
-
-			VRawBoneInfluence I;
-			I.Weight     = UnpackedWeights.v[j];
-			I.BoneIndex  = V.Bone[j];
-			I.PointIndex = i;
-			if (sizeof(VRawBoneInfluence) == sizeof(int) * 3)
+			const CSkelMeshVertex &V = Lod.Verts[Share.VertToWedge[i]];
+			CVec4 UnpackedWeights;
+			V.UnpackWeights(UnpackedWeights);
+			VRawBoneInfluence *I = Influences.GetData() + FirstInfluence[i];
+			for (int j = FirstInfluence[i]; j < FirstInfluence[i + 1]; j++, I++)
 			{
-				Ar.Serialize(&I, sizeof(I));
+				int k = j - FirstInfluence[i];
+				I->Weight     = UnpackedWeights.v[k];
+				I->BoneIndex  = V.Bone[k];
+				I->PointIndex = i;
 			}
-			else
-			{
-				Ar << I;
-			}
-		}
-	}
-	assert(NumInfluences == 0);
+		});
+	Ar.Serialize(Influences.GetData(), NumInfluences * sizeof(VRawBoneInfluence));
 	unguard;
 
 	ExportVertexColors(Ar, Lod.VertexColors, Lod.NumVerts);
@@ -573,10 +589,11 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 	BoneHdr.DataCount = numBones;
 	BoneHdr.DataSize  = sizeof(FNamedBoneBinary);
 	SAVE_CHUNK(BoneHdr, "BONENAMES");
+	TArray<FNamedBoneBinary> Bones;
+	Bones.AddZeroed(numBones);
 	for (i = 0; i < numBones; i++)
 	{
-		FNamedBoneBinary B;
-		memset(&B, 0, sizeof(B));
+		FNamedBoneBinary &B = Bones[i];
 		CopyBoneName(B.Name, sizeof(B.Name), *Anim->TrackBoneNames[i]);
 		B.Flags       = 0;						// reserved
 		B.NumChildren = 0;						// unknown here
@@ -591,8 +608,8 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 			B.BonePos.Position = CVT(Anim->BonePositions[i].Position);
 			B.BonePos.Orientation = CVT(Anim->BonePositions[i].Orientation);
 		}
-		Ar << B;
 	}
+	Ar.Serialize(Bones.GetData(), numBones * sizeof(FNamedBoneBinary));
 
 	int framesCount = 0;
 
@@ -600,10 +617,11 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 	AnimHdr.DataCount = numAnims;
 	AnimHdr.DataSize  = sizeof(AnimInfoBinary);
 	SAVE_CHUNK(AnimHdr, "ANIMINFO");
+	TArray<AnimInfoBinary> AnimInfos;
+	AnimInfos.AddZeroed(numAnims);
 	for (i = 0; i < numAnims; i++)
 	{
-		AnimInfoBinary A;
-		memset(&A, 0, sizeof(A));
+		AnimInfoBinary &A = AnimInfos[i];
 		const CAnimSequence &S = *Anim->Sequences[i];
 		strcpy(A.Name,  *S.Name);
 		strcpy(A.Group, /*??S.Groups.Num() ? *S.Groups[0] :*/ "None");
@@ -617,10 +635,10 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 		A.StartBone           = 0;				// reserved
 		A.FirstRawFrame       = framesCount;	// useless, but used in UnrealEd when importing
 		A.NumRawFrames        = S.NumFrames;
-		Ar << A;
 
 		framesCount += S.NumFrames;
 	}
+	Ar.Serialize(AnimInfos.GetData(), numAnims * sizeof(AnimInfoBinary));
 	unguard;
 
 	bool requireConfig = false;
@@ -630,43 +648,46 @@ static void DoExportPsa(const CAnimSet* Anim, const UObject* OriginalAnim)
 	KeyHdr.DataCount = keysCount;
 	KeyHdr.DataSize  = sizeof(VQuatAnimKey);
 	SAVE_CHUNK(KeyHdr, "ANIMKEYS");
+	// keys are computed and written per sequence, allocate buffer for the longest one
+	int MaxFrames = 0;
+	for (i = 0; i < numAnims; i++)
+		MaxFrames = max(MaxFrames, Anim->Sequences[i]->NumFrames);
+	TArray<VQuatAnimKey> Keys;
+	Keys.AddUninitialized(MaxFrames * numBones);
 	for (i = 0; i < numAnims; i++)
 	{
 		guard(Sequence);
 		const CAnimSequence &S = *Anim->Sequences[i];
-		for (int t = 0; t < S.NumFrames; t++)
-		{
-			for (int b = 0; b < numBones; b++)
+		ParallelFor(S.NumFrames, [&](int t)
 			{
-				VQuatAnimKey K;
-				CVec3 BP;
-				CQuat BO;
+				for (int b = 0; b < numBones; b++)
+				{
+					VQuatAnimKey &K = Keys[t * numBones + b];
+					CVec3 BP;
+					CQuat BO;
 
-				BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
-				BO.Set(0, 0, 0, 1);
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+					BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
+					BO.Set(0, 0, 0, 1);
+					S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
 
-				K.Position    = (FVector&) BP;
-				K.Orientation = (FQuat&)   BO;
-				K.Time        = 1;
+					K.Position    = (FVector&) BP;
+					K.Orientation = (FQuat&)   BO;
+					K.Time        = 1;
 #if MIRROR_MESH
-				K.Orientation.Y *= -1;
-				K.Orientation.W *= -1;
-				K.Position.Y    *= -1;
+					K.Orientation.Y *= -1;
+					K.Orientation.W *= -1;
+					K.Position.Y    *= -1;
 #endif
-
-				if (sizeof(VQuatAnimKey) == sizeof(float) * 8)
-				{
-					// Packed structure, serialize with a single call
-					Ar.Serialize(&K, sizeof(K));
 				}
-				else
-				{
-					Ar << K;
-				}
-				keysCount--;
+			});
+		Ar.Serialize(Keys.GetData(), S.NumFrames * numBones * sizeof(VQuatAnimKey));
+		keysCount -= S.NumFrames * numBones;
 
-				// check for user error
+		// check for user error
+		if (S.NumFrames)
+		{
+			for (int b = 0; b < numBones; b++)
+			{
 				if ((S.Tracks[b]->KeyPos.Num() == 0) || (S.Tracks[b]->KeyQuat.Num() == 0))
 					requireConfig = true;
 			}
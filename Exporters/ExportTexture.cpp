@@ -252,7 +252,7 @@ static void WriteDDS(FArchive& Ar, const CTextureData& TexData, int Slice)
 	if (!fourCC)
 		appError("unknown texture format %d \n", TexData.Format);	// should not happen - IsDXT() should not pass execution here
 
-	int DataSize = Mip.DataSize;
+	int64 DataSize = Mip.DataSize;
 	const byte* DataPtr = Mip.CompressedData;
 	if (Slice >= 0)
 	{
@@ -268,13 +268,13 @@ static void WriteDDS(FArchive& Ar, const CTextureData& TexData, int Slice)
 	header.setWidth(Mip.USize);
 	header.setHeight(Mip.VSize);
 //	header.setNormalFlag(TexData.Format == TPF_DXT5N || TexData.Format == TPF_3DC); -- required for decompression only
-	header.setLinearSize(DataSize);
+	header.setLinearSize((uint32)DataSize);
 
 	byte headerBuffer[128];							// DDS header is 128 bytes long
 	memset(headerBuffer, 0, 128);
 	WriteDDSHeader(headerBuffer, header);
 	Ar.Serialize(headerBuffer, 128);
-	Ar.Serialize(const_cast<byte*>(DataPtr), DataSize);
+	Ar.Serialize64(const_cast<byte*>(DataPtr), DataSize);
 
 	unguard;
 }
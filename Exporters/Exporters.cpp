@@ -7,6 +7,11 @@
 #include "Exporters.h"
 
 #include "Parallel.h"
+#include "HashIndex.h"
+
+#if !_WIN32
+#include <unistd.h>						// for link()
+#endif
 
 // configuration variables
 bool GExportScripts      = false;
@@ -16,6 +21,7 @@ bool GDontOverwriteFiles = false;
 bool GExportInProgress   = false;
 
 bool GDummyExport        = false;
+bool GExportDedup        = false;
 
 
 /*-----------------------------------------------------------------------------
@@ -71,9 +77,14 @@ struct ExportedObjectEntry
 	}
 };
 
+struct CExportedContent;
+
 struct ExportContext
 {
 	const UObject* LastExported;
+	CExportedContent* CurrentContent;			// content record of the object being exported, used with GExportDedup
+	const UObject* CurrentContentObject;
+	TArray<FString>* ExportedFiles;				// list of created files, see CollectExportedFiles()
 	TArray<ExportedObjectEntry> Objects;
 	int ObjectHash[EXPORTED_LIST_HASH_SIZE];
 	unsigned long startTime;
@@ -92,6 +103,9 @@ struct ExportContext
 	void Reset()
 	{
 		LastExported = NULL;
+		CurrentContent = NULL;
+		CurrentContentObject = NULL;
+		ExportedFiles = NULL;
 		NumSkippedObjects = 0;
 		Objects.Empty();
 		memset(ObjectHash, -1, sizeof(ObjectHash));
@@ -184,6 +198,8 @@ void EndExport(bool profile)
 	// Wait for all workers to complete
 	ThreadPool::WaitForCompletion();
 #endif
+	// Finish writing files which were queued for the I/O thread
+	appFlushFileWrites();
 
 	GExportInProgress = false;
 	GBeforeLoadObjectCallback = NULL;
@@ -199,6 +215,11 @@ void EndExport(bool profile)
 	ctx.Reset();
 }
 
+void CollectExportedFiles(TArray<FString>* Files)
+{
+	ctx.ExportedFiles = Files;
+}
+
 // return 'false' if object already registered
 //todo: make a method of 'ctx' as this function is 1) almost empty, 2) not public
 static bool RegisterProcessedObject(const UObject* Obj)
@@ -311,6 +332,191 @@ struct CUniqueNameList
 	}
 };
 
+/*-----------------------------------------------------------------------------
+	Content-based export deduplication
+-----------------------------------------------------------------------------*/
+
+// Archive which computes hash of UObject::GetContentKey() data
+class FContentHasher : public FArchive
+{
+	DECLARE_ARCHIVE(FContentHasher, FArchive);
+public:
+	uint64		Hash;
+	int64		Size;
+
+	FContentHasher()
+	:	Hash(0)
+	,	Size(0)
+	{
+		IsLoading = false;
+	}
+
+	virtual void Seek(int Pos)
+	{}
+	virtual void Serialize(void *data, int size)
+	{
+		Hash = appMemHash64(data, size, Hash);
+		Size += size;
+	}
+	virtual FArchive& operator<<(FName& N)
+	{
+		const char* s = *N;
+		Serialize(const_cast<char*>(s), strlen(s) + 1);
+		return *this;
+	}
+};
+
+// Files exported for the first object with particular content
+struct CExportedContent
+{
+	const char*		ClassName;
+	uint64			Hash;
+	int64			Size;
+	FString			ExportPath;				// export path of the object
+	FString			ObjectName;
+	TArray<FString>	Files;					// file names relative to ExportPath
+
+	void AddFile(const char* Filename)
+	{
+		// Properties are not a part of the content key, they're saved for every object, see ExportObject()
+		int NameLen = strlen(Filename);
+		if (NameLen > 10 && !stricmp(Filename + NameLen - 10, ".props.txt"))
+			return;
+		int Len = ExportPath.Len();
+		if (!strncmp(Filename, *ExportPath, Len) && Filename[Len] == '/')
+			Files.Add(Filename + Len + 1);
+	}
+};
+
+struct CExportedContentList
+{
+	TArray<CExportedContent*> Items;
+	CHashIndex		HashIndex;
+
+	CExportedContent* Find(const char* ClassName, const FContentHasher& Key)
+	{
+		for (CHashIndex::CIterator It(HashIndex, Key.Hash); It; ++It)
+		{
+			CExportedContent* Item = Items[*It];
+			if (Item->Hash == Key.Hash && Item->Size == Key.Size && !strcmp(Item->ClassName, ClassName))
+				return Item;
+		}
+		return NULL;
+	}
+
+	CExportedContent* Add(const char* ClassName, const FContentHasher& Key, const char* ExportPath, const char* ObjectName)
+	{
+		CExportedContent* Item = new CExportedContent;
+		Item->ClassName = ClassName;
+		Item->Hash = Key.Hash;
+		Item->Size = Key.Size;
+		Item->ExportPath = ExportPath;
+		Item->ObjectName = ObjectName;
+		HashIndex.Add(Key.Hash, Items.Add(Item));
+		return Item;
+	}
+};
+
+#if _WIN32
+// Avoid including <windows.h>
+extern "C" __declspec(dllimport) int __stdcall CreateHardLinkA(const char* lpFileName, const char* lpExistingFileName, void* lpSecurityAttributes);
+#endif
+
+// Create a hard link to the file, or copy the file when it is not possible
+static bool LinkFile(const char* SrcName, const char* DstName)
+{
+	guard(LinkFile);
+
+#if _WIN32
+	if (CreateHardLinkA(DstName, SrcName, NULL)) return true;
+#else
+	if (link(SrcName, DstName) == 0) return true;
+#endif
+
+	// File system doesn't support hard links, or files are on different volumes. The source file
+	// could be still written by the texture export thread or by write-behind I/O thread.
+#if THREADING
+	ThreadPool::WaitForCompletion();
+#endif
+	appFlushFileWrites();
+
+	FILE* Src = fopen(SrcName, "rb");
+	if (!Src) return false;
+	FILE* Dst = fopen(DstName, "wb");
+	if (!Dst)
+	{
+		fclose(Src);
+		return false;
+	}
+	byte Buffer[65536];
+	bool bResult = true;
+	while (int Size = fread(Buffer, 1, sizeof(Buffer), Src))
+	{
+		if (fwrite(Buffer, Size, 1, Dst) != 1)
+		{
+			bResult = false;
+			break;
+		}
+	}
+	fclose(Src);
+	if (fclose(Dst) != 0) bResult = false;
+	if (!bResult) remove(DstName);
+	return bResult;
+
+	unguard;
+}
+
+// Make files of the object by linking files of the already exported object with the same content
+static bool LinkExportedContent(const UObject* Obj, const char* ExportPath, const CExportedContent& Content)
+{
+	guard(LinkExportedContent);
+
+	// Nothing was written for the first object, e.g. export has failed
+	if (!Content.Files.Num()) return false;
+
+	TArray<FString> CreatedFiles;
+	int NameLen = Content.ObjectName.Len();
+	for (const FString& File : Content.Files)
+	{
+		const char* RelName = *File;
+		char SrcName[MAX_PACKAGE_PATH], DstName[MAX_PACKAGE_PATH];
+		appSprintf(ARRAY_ARG(SrcName), "%s/%s", *Content.ExportPath, RelName);
+		// Files are usually named after the object, rename them
+		char c = RelName[NameLen];
+		if (!strncmp(RelName, *Content.ObjectName, NameLen) && (c == '.' || c == '_' || c == '/'))
+			appSprintf(ARRAY_ARG(DstName), "%s/%s%s", ExportPath, Obj->Name, RelName + NameLen);
+		else
+			appSprintf(ARRAY_ARG(DstName), "%s/%s", ExportPath, RelName);
+
+		if (!stricmp(SrcName, DstName)) continue;		// the same file, e.g. uncooked object from different map
+		if (appFileExists(DstName))
+		{
+			if (GDontOverwriteFiles) continue;
+			remove(DstName);
+		}
+		appMakeDirectoryForFile(DstName);
+		if (!LinkFile(SrcName, DstName))
+		{
+			appPrintf("WARNING: unable to link %s to %s\n", DstName, SrcName);
+			// Remove created links, so the object could be exported normally
+			for (const FString& Created : CreatedFiles)
+				remove(*Created);
+			return false;
+		}
+		CreatedFiles.Add(DstName);
+	}
+	if (ctx.ExportedFiles)
+	{
+		for (const FString& Created : CreatedFiles)
+			ctx.ExportedFiles->Add(Created);
+	}
+
+	appPrintf("Exporting %s %s to %s: same as %s/%s\n", Obj->GetClassName(), Obj->Name, ExportPath, *Content.ExportPath, *Content.ObjectName);
+	return true;
+
+	unguard;
+}
+
 bool ExportObject(const UObject *Obj)
 {
 	guard(ExportObject);
@@ -326,6 +532,7 @@ bool ExportObject(const UObject *Obj)
 		return true;
 
 	static CUniqueNameList ExportedNames;
+	static CExportedContentList ExportedContents;
 
 	// For "uncook", different packages may have copies of the same object, which are stored with different quality.
 	// For example, Gears3 has anim sets which cooked with different tracks into different maps. To be able to export
@@ -379,12 +586,59 @@ bool ExportObject(const UObject *Obj)
 				}
 			}
 
+			// Find an object with the same content which was already exported, and link its files instead of
+			// doing the export. Otherwise, register the object's content and collect its files in CreateExportArchive().
+			CExportedContent* Content = NULL;
+			if (GExportDedup && !GDummyExport)
+			{
+				FContentHasher Key;
+				if (Obj->GetContentKey(Key))
+				{
+					Content = ExportedContents.Find(ClassName, Key);
+					if (Content)
+					{
+						if (LinkExportedContent(Obj, ExportPath, *Content))
+						{
+							// Save properties of this object, they're different for objects with the same content
+							if (Obj->GetTypeinfo()->NumProps)
+							{
+								const UObject* saveLastExported = ctx.LastExported;
+								FArchive* PropAr = CreateExportArchive(Obj, EFileArchiveOptions::TextFile, "%s.props.txt", Obj->Name);
+								if (PropAr)
+								{
+									Obj->GetTypeinfo()->SaveProps(Obj, *PropAr);
+									delete PropAr;
+								}
+								ctx.LastExported = saveLastExported;
+							}
+							RegisterProcessedObject(Obj);
+							if (OriginalName) const_cast<UObject*>(Obj)->Name = OriginalName;
+							return true;
+						}
+						Content = NULL;
+					}
+					else
+					{
+						Content = ExportedContents.Add(ClassName, Key, ExportPath, Obj->Name);
+					}
+				}
+			}
+
 			// Do the export with saving current "LastExported" value. This will fix an issue when object exporter
 			// will call another ExportObject function then continue exporting - without the fix, calling CreateExportArchive()
 			// will always fail because code will recognize object as exported for 2nd time.
 			const UObject* saveLastExported = ctx.LastExported;
-			Info.Func(Obj);
+			CExportedContent* saveContent = ctx.CurrentContent;
+			const UObject* saveContentObject = ctx.CurrentContentObject;
+			ctx.CurrentContent = Content;
+			ctx.CurrentContentObject = Obj;
+			{
+				CStatsScope Stats(STATS_Export, Obj);
+				Info.Func(Obj);
+			}
 			ctx.LastExported = saveLastExported;
+			ctx.CurrentContent = saveContent;
+			ctx.CurrentContentObject = saveContentObject;
 
 			//?? restore object name
 			if (OriginalName) const_cast<UObject*>(Obj)->Name = OriginalName;
@@ -411,6 +665,13 @@ void appSetBaseExportDirectory(const char* Dir)
 	strcpy(BaseExportDir, Dir);
 }
 
+const char* GetBaseExportDirectory()
+{
+	if (!BaseExportDir[0])
+		appSetBaseExportDirectory(".");
+	return BaseExportDir;
+}
+
 
 const char* GetExportPath(const UObject* Obj)
 {
@@ -570,6 +831,8 @@ FArchive* CreateExportArchive(const UObject* Obj, EFileArchiveOptions FileOption
 		{
 			appPrintf("Export: file already exists %s\n", filename);
 			ctx.NumSkippedObjects++;
+			if (ctx.ExportedFiles)
+				ctx.ExportedFiles->Add(filename);
 			return NULL;
 		}
 	}
@@ -580,7 +843,7 @@ FArchive* CreateExportArchive(const UObject* Obj, EFileArchiveOptions FileOption
 	}
 
 	appMakeDirectoryForFile(filename);
-	FFileWriter *Ar = new FFileWriter(filename, EFileArchiveOptions::NoOpenError | FileOptions);
+	FFileWriter *Ar = new FFileWriter(filename, EFileArchiveOptions::NoOpenError | EFileArchiveOptions::WriteBehind | FileOptions);
 	if (!Ar->IsOpen())
 	{
 		appPrintf("Error creating file \"%s\" ...\n", filename);
@@ -590,6 +853,11 @@ FArchive* CreateExportArchive(const UObject* Obj, EFileArchiveOptions FileOption
 
 	Ar->ArVer = 128;			// less than UE3 version (required at least for VJointPos structure)
 
+	if (ctx.CurrentContent && ctx.CurrentContentObject == Obj)
+		ctx.CurrentContent->AddFile(filename);
+	if (ctx.ExportedFiles)
+		ctx.ExportedFiles->Add(filename);
+
 	return Ar;
 
 	unguard;
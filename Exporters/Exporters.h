@@ -24,8 +24,13 @@ bool IsObjectExported(const UObject* Obj);
 
 bool ExportObject(const UObject* Obj);
 
+// Add names of all files created by the export to the list, used for the export manifest.
+// Pass NULL to stop collecting. EndExport() resets the list.
+void CollectExportedFiles(TArray<FString>* Files);
+
 // path
 void appSetBaseExportDirectory(const char* Dir);
+const char* GetBaseExportDirectory();
 const char* GetExportPath(const UObject* Obj);
 
 const char* GetExportFileName(const UObject* Obj, const char* fmt, ...);
@@ -46,6 +51,7 @@ extern bool GUncook;
 extern bool GUseGroups;
 extern bool GDontOverwriteFiles;
 extern bool GDummyExport;
+extern bool GExportDedup;
 
 // forwards
 class UObject;
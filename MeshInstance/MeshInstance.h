@@ -232,6 +232,10 @@ public:
 
 	CVec3 GetMeshOrigin() const;
 
+	// Skin the current LOD with the current pose and return the result as a new static mesh.
+	// Call UpdateAnimation() before this to compute the pose.
+	CStaticMesh* BuildPosedMesh();
+
 protected:
 	const CAnimSet*		Animation;
 	// mesh data
@@ -7,10 +7,12 @@
 #include "UnrealMaterial/UnMaterial.h"
 
 #include "Mesh/SkeletalMesh.h"
+#include "Mesh/StaticMesh.h"
 #include "MeshInstance.h"
 
 #include "GlWindow.h"
 #include "UnrealMesh/UnMathTools.h"
+#include "Parallel.h"
 
 
 // Debug stuff
@@ -93,7 +95,8 @@ const char *CSkelMeshInstance::GetAnimName(int Index) const
 -----------------------------------------------------------------------------*/
 
 CSkelMeshInstance::CSkelMeshInstance()
-:	LodIndex(0)
+:	pMesh(NULL)
+,	LodIndex(0)
 ,	MorphIndex(-1)
 ,	UVIndex(0)
 ,	RetargetingModeOverride(EAnimRetargetingMode::AnimSet)
@@ -1248,21 +1251,15 @@ void CSkelMeshInstance::SkinMeshVerts()
 
 #else // USE_SSE
 
+// Number of vertices processed by a single ParallelFor iteration in SkinMeshVerts()
+#define SKIN_VERTS_PER_JOB		2048
+
 // Software skinning - SSE version
-void CSkelMeshInstance::SkinMeshVerts()
+static void SkinVertsSSE(const CSkelMeshVertex* Verts, CSkinVert* Skinned, int NumVerts, const CMeshBoneData* BoneData, int NumBones)
 {
-	guard(CSkelMeshInstance::SkinMeshVerts);
-
-	const CSkelMeshLod& Mesh = pMesh->Lods[LodIndex];
-	int NumVerts = Mesh.NumVerts;
-
-	memset(Skinned, 0, sizeof(CSkinVert) * NumVerts);
-
-	const CSkelMeshVertex* MeshVerts = BuildMorphVerts() ? MorphedVerts : Mesh.Verts;
-
 	for (int i = 0; i < NumVerts; i++)
 	{
-		const CSkelMeshVertex &V = MeshVerts[i];
+		const CSkelMeshVertex &V = Verts[i];
 		CSkinVert             &D = Skinned[i];
 
 		CVec4 UnpackedWeights;
@@ -1288,7 +1285,7 @@ void CSkelMeshInstance::SkinMeshVerts()
 		{
 			int iBone = V.Bone[j];
 			if (iBone < 0) break;
-			assert(iBone < pMesh->RefSkeleton.Num());	// validate bone index
+			assert(iBone < NumBones);			// validate bone index
 
 			const CMeshBoneData &data = BoneData[iBone];
 			x5 = _mm_load1_ps(&UnpackedWeights.v[j]);	// Weight
@@ -1340,6 +1337,26 @@ void CSkelMeshInstance::SkinMeshVerts()
 		// Preserve Normal.W to be able to compute binormal correctly
 		D.Normal.v[3] = V.Normal.GetW();
 	}
+}
+
+void CSkelMeshInstance::SkinMeshVerts()
+{
+	guard(CSkelMeshInstance::SkinMeshVerts);
+
+	const CSkelMeshLod& Mesh = pMesh->Lods[LodIndex];
+	int NumVerts = Mesh.NumVerts;
+	int NumBones = pMesh->RefSkeleton.Num();
+
+	const CSkelMeshVertex* MeshVerts = BuildMorphVerts() ? MorphedVerts : Mesh.Verts;
+
+	// Skin vertices in parallel chunks. All components of every Skinned[] vertex are written,
+	// so the buffer is not cleared before skinning.
+	int NumJobs = (NumVerts + SKIN_VERTS_PER_JOB - 1) / SKIN_VERTS_PER_JOB;
+	ParallelFor(NumJobs, [this, MeshVerts, NumVerts, NumBones](int Job)
+		{
+			int First = Job * SKIN_VERTS_PER_JOB;
+			SkinVertsSSE(MeshVerts + First, Skinned + First, min(SKIN_VERTS_PER_JOB, NumVerts - First), BoneData, NumBones);
+		});
 
 	unguard;
 }
@@ -1347,6 +1364,63 @@ void CSkelMeshInstance::SkinMeshVerts()
 #endif // USE_SSE
 
 
+CStaticMesh* CSkelMeshInstance::BuildPosedMesh()
+{
+	guard(CSkelMeshInstance::BuildPosedMesh);
+
+	if (!pMesh->Lods.Num()) return NULL;
+
+	SkinMeshVerts();
+
+	const CSkelMeshLod& Src = pMesh->Lods[LodIndex];
+	int NumVerts = Src.NumVerts;
+
+	CStaticMesh* Mesh = new CStaticMesh(const_cast<UObject*>(pMesh->OriginalMesh));
+	CStaticMeshLod* Lod = new (Mesh->Lods) CStaticMeshLod;
+	Lod->NumTexCoords = Src.NumTexCoords;
+	Lod->HasNormals   = true;
+	Lod->HasTangents  = true;
+	CopyArray(Lod->Sections, Src.Sections);
+	CopyArray(Lod->Indices.Indices16, Src.Indices.Indices16);
+	CopyArray(Lod->Indices.Indices32, Src.Indices.Indices32);
+
+	Lod->AllocateVerts(NumVerts);
+	for (int i = 0; i < Src.NumTexCoords-1; i++)
+		memcpy(Lod->ExtraUV[i], Src.ExtraUV[i], NumVerts * sizeof(CMeshUVFloat));
+	if (Src.VertexColors)
+	{
+		Lod->AllocateVertexColorBuffer();
+		memcpy(Lod->VertexColors, Src.VertexColors, NumVerts * sizeof(FColor));
+	}
+
+	ParallelFor(NumVerts, [Lod, &Src, this](int i)
+		{
+			const CSkinVert& S = Skinned[i];
+			CStaticMeshVertex& D = Lod->Verts[i];
+			D.Position = S.Position;
+			// bone scales could make skinned normals non-unit
+			CVec3 Normal = S.Normal.ToVec3(), Tangent = S.Tangent.ToVec3();
+			Normal.Normalize();
+			Tangent.Normalize();
+			Pack(D.Normal, Normal);
+			Pack(D.Tangent, Tangent);
+			D.Normal.SetW(Src.Verts[i].Normal.GetW());
+			D.UV = Src.Verts[i].UV;
+		});
+
+	// compute bounds of the posed mesh
+	CVec3 Mins, Maxs;
+	ComputeBounds(&Lod->Verts[0].Position, NumVerts, sizeof(CStaticMeshVertex), Mins, Maxs);
+	(CVec3&)Mesh->BoundingBox.Min = Mins;
+	(CVec3&)Mesh->BoundingBox.Max = Maxs;
+	Mesh->BoundingSphere = pMesh->BoundingSphere;
+
+	return Mesh;
+
+	unguard;
+}
+
+
 void CSkelMeshInstance::DrawMesh(unsigned flags)
 {
 	guard(CSkelMeshInstance::DrawMesh);
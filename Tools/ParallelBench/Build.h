@@ -0,0 +1,2 @@
+#define DO_GUARD		1
+#define THREADING		1
@@ -0,0 +1,113 @@
+// Micro-benchmark for the thread pool: measures overhead of scheduling and waiting for small tasks.
+
+#include "Core.h"
+#include "Parallel.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static volatile int64 Sink;
+
+static void SpinWork(int Count)
+{
+	int64 s = 0;
+	for (int i = 0; i < Count; i++)
+		s += (i * 7) ^ (s >> 3);
+	Sink += s;
+}
+
+struct CBenchTimer
+{
+	CBenchTimer(const char* InName)
+	: Name(InName)
+	{
+		StartTime = appMicroseconds();
+#ifndef _WIN32
+		getrusage(RUSAGE_SELF, &StartUsage);
+#endif
+	}
+
+	~CBenchTimer()
+	{
+		double Wall = (appMicroseconds() - StartTime) / 1000000.0;
+#ifndef _WIN32
+		rusage Usage;
+		getrusage(RUSAGE_SELF, &Usage);
+		double Cpu = (Usage.ru_utime.tv_sec - StartUsage.ru_utime.tv_sec) + (Usage.ru_stime.tv_sec - StartUsage.ru_stime.tv_sec)
+			+ ((Usage.ru_utime.tv_usec - StartUsage.ru_utime.tv_usec) + (Usage.ru_stime.tv_usec - StartUsage.ru_stime.tv_usec)) / 1000000.0;
+		long Switches = (Usage.ru_nvcsw - StartUsage.ru_nvcsw) + (Usage.ru_nivcsw - StartUsage.ru_nivcsw);
+		appPrintf("%-14s wall %.3f s, cpu %.3f s, context switches %ld\n", Name, Wall, Cpu, Switches);
+#else
+		appPrintf("%-14s wall %.3f s\n", Name, Wall);
+#endif
+	}
+
+	const char* Name;
+	uint64 StartTime;
+#ifndef _WIN32
+	rusage StartUsage;
+#endif
+};
+
+int main(int argc, const char** argv)
+{
+#if DO_GUARD
+	TRY {
+#endif
+
+	guard(Main);
+
+	appInitPlatform();
+
+	int Scale = (argc > 1) ? atoi(argv[1]) : 1;
+	if (Scale < 1) Scale = 1;
+
+	appPrintf("%d logical CPUs\n", CThread::GetLogicalCPUCount());
+	// Start pool threads before measurements
+	ThreadPool::WaitForCompletion();
+
+	{
+		// Many short ParallelFor calls: dominated by queueing and waiting overhead
+		CBenchTimer Timer("parallelfor");
+		for (int i = 0; i < 2000 * Scale; i++)
+			ParallelFor(200, [](int) { SpinWork(200); });
+	}
+
+	{
+		// ParallelFor called from ParallelFor body, waits are nested
+		CBenchTimer Timer("nested");
+		for (int i = 0; i < 20 * Scale; i++)
+		{
+			ParallelFor(40, [](int)
+				{
+					ParallelFor(100, [](int) { SpinWork(500); });
+				});
+		}
+	}
+
+	{
+		// Independent tasks with a throttled queue, the way exporters are using it
+		CBenchTimer Timer("queue");
+		for (int i = 0; i < 2000 * Scale; i++)
+			ThreadPool::TryExecuteInThread([]() { SpinWork(20000); }, NULL, true);
+		ThreadPool::WaitForCompletion();
+	}
+
+	{
+		// The same amount of work as in "queue", executed in the main thread
+		CBenchTimer Timer("serial");
+		for (int i = 0; i < 2000 * Scale; i++)
+			SpinWork(20000);
+	}
+
+	unguard;
+
+#if DO_GUARD
+	} CATCH {
+		GError.StandardHandler();
+		exit(1);
+	}
+#endif
+	return 0;
+}
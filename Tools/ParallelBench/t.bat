@@ -0,0 +1,6 @@
+@echo off
+
+rm parallelbench.exe
+bash build.sh
+
+parallelbench %*
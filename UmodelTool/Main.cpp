@@ -34,9 +34,16 @@
 
 #include "UmodelApp.h"
 #include "UmodelCommands.h"
+#if RENDERING
+#include "MeshInstance/MeshInstance.h"
+#endif
 #include "Version.h"
 #include "MiscStrings.h"
 
+#if THREADING
+#include "Parallel.h"
+#endif
+
 #define APP_CAPTION					"UE Viewer"
 
 //#define SHOW_HIDDEN_SWITCHES		1
@@ -49,6 +56,7 @@ CUmodelSettings GSettings;
 
 #if THREADING
 extern bool GEnableThreads;
+extern int GMaxThreads;
 #endif
 
 /*-----------------------------------------------------------------------------
@@ -291,6 +299,101 @@ static void CallExportAnimation(const CAnimSet* Anim)
 	}
 }
 
+#if RENDERING
+
+// Animation used for posing skeletal mesh: the one provided with -anim option, or the mesh's own animation
+static const CAnimSet* GetPoseAnimSet(const CSkeletalMesh* Mesh)
+{
+	if (GForceAnimSet)
+		return GetAnimSet(GForceAnimSet);
+	const UObject* OriginalMesh = Mesh->OriginalMesh;
+	if (OriginalMesh->IsA("SkeletalMesh"))			// UE2 class
+	{
+		const UMeshAnimation* Anim = static_cast<const USkeletalMesh*>(OriginalMesh)->Animation;
+		return Anim ? Anim->ConvertedAnim : NULL;
+	}
+#if UNREAL4
+	if (OriginalMesh->IsA("SkeletalMesh4"))
+	{
+		const USkeleton* Skeleton = static_cast<const USkeletalMesh4*>(OriginalMesh)->Skeleton;
+		return Skeleton ? Skeleton->ConvertedAnim : NULL;
+	}
+#endif // UNREAL4
+	return NULL;
+}
+
+static CSkeletalMesh* GetConvertedSkeletalMesh(UObject* Obj)
+{
+	if (Obj->IsA("SkeletalMesh"))
+		return static_cast<USkeletalMesh*>(Obj)->ConvertedMesh;
+#if UNREAL3
+	if (Obj->IsA("SkeletalMesh3"))
+		return static_cast<USkeletalMesh3*>(Obj)->ConvertedMesh;
+#endif
+#if UNREAL4
+	if (Obj->IsA("SkeletalMesh4"))
+		return static_cast<USkeletalMesh4*>(Obj)->ConvertedMesh;
+#endif
+	return NULL;
+}
+
+static bool HasSkeletalMeshes(const TArray<UObject*>& Objects)
+{
+	for (UObject* Obj : Objects)
+	{
+		if (GetConvertedSkeletalMesh(Obj)) return true;
+	}
+	return false;
+}
+
+// Export skeletal meshes as static meshes posed at the specified animation frame. Empty AnimName
+// means the reference pose. Returns number of exported meshes.
+static int ExportPosedMeshes(const TArray<UObject*>& Objects, const char* AnimName, float Frame)
+{
+	guard(ExportPosedMeshes);
+
+	appPrintf("Exporting posed meshes ...\n");
+
+	int NumPosed = 0;
+
+	for (UObject* Obj : Objects)
+	{
+		CSkeletalMesh* Mesh = GetConvertedSkeletalMesh(Obj);
+		if (!Mesh) continue;
+
+		appSetNotifyHeader(*Obj->Package->GetFilename());
+
+		CSkelMeshInstance Inst;
+		Inst.SetMesh(Mesh);
+		Inst.SetAnim(GetPoseAnimSet(Mesh));
+		if (AnimName[0])
+		{
+			if (!Inst.HasAnim(AnimName))
+			{
+				appPrintf("WARNING: %s: animation \"%s\" was not found\n", Obj->Name, AnimName);
+				continue;
+			}
+			Inst.PlayAnim(AnimName);
+			Inst.FreezeAnimAt(Frame);
+		}
+		Inst.UpdateAnimation(0);
+
+		CStaticMesh* Posed = Inst.BuildPosedMesh();
+		if (Posed)
+		{
+			CallExportStaticMesh(Posed);
+			delete Posed;
+			NumPosed++;
+		}
+	}
+
+	return NumPosed;
+
+	unguard;
+}
+
+#endif // RENDERING
+
 static void RegisterExporters()
 {
 	RegisterExporter<USkeletalMesh>([](const USkeletalMesh* Mesh) { CallExportSkeletalMesh(Mesh->ConvertedMesh); });
@@ -379,6 +482,12 @@ static void PrintUsage()
 			"    -dump           dump object information to console\n"
 			"    -pkginfo        load package and display its information\n"
 			"    -testexport     perform fake export\n"
+			"    -stats=json     collect load and export statistics per class and package,\n"
+			"                    save them to umodel_stats.json at exit\n"
+			"    -stats=json:file  the same, but save statistics to the specified file\n"
+			"    -arena          allocate memory for loaded objects in arena, release it at once\n"
+			"    -hashstats      print file system hash table statistics after scanning\n"
+			"    -maxfiles=N     limit number of simultaneously open files (default is 256)\n"
 #if SHOW_HIDDEN_SWITCHES
 			"    -check          check some assumptions, no other actions performed\n"
 #	if VSTUDIO_INTEGRATION
@@ -386,6 +495,7 @@ static void PrintUsage()
 #	endif
 #	if THREADING
 			"    -nomt           disable multithreading optimizations\n"
+			"    -threads=N      use at most N threads, including the main one\n"
 #	endif
 #endif // SHOW_HIDDEN_SWITCHES
 			"\n"
@@ -441,11 +551,36 @@ static void PrintUsage()
 			"    -md5            use md5mesh/md5anim format for skeletal mesh\n"
 			"    -gltf           use glTF 2.0 format for mesh\n"
 			"    -lods           export all available mesh LOD levels\n"
+#if RENDERING
+			"    -pose=<seq>[:N] export skeletal meshes as static meshes posed at frame N of\n"
+			"                    animation sequence <seq> (use -anim=<set> to select the\n"
+			"                    animation set); -pose= exports the reference pose\n"
+#endif
+#if UNREAL4
+			"    -meshlods=N     convert only N first LOD levels of UE4 meshes, 0 means all;\n"
+			"                    export without -lods converts a single LOD\n"
+#endif
 			"    -dds            export textures in DDS format whenever possible\n"
 			"    -png            export textures in PNG format instead of TGA\n"
 			"    -notgacomp      disable TGA compression\n"
 			"    -nooverwrite    prevent existing files from being overwritten (better\n"
 			"                    performance)\n"
+			"    -dedup          export objects with the same content once, create hard\n"
+			"                    links to these files for other copies\n"
+			"    -resume         record exported packages in umodel_manifest.txt, skip\n"
+			"                    packages recorded there by previous run\n"
+			"    -shard=i/N      export only i-th of N parts of the package list (i = 0..N-1);\n"
+			"                    -resume uses umodel_manifest.<i>.txt for each part\n"
+#if THREADING
+			"    -shards=N       run export in N processes with -shard=i/N options and\n"
+			"                    merge their logs and statistics, 0 = number of CPU cores;\n"
+			"                    CPU cores are shared between processes with -threads option\n"
+#endif
+			"    -writebuffer=N  use N Kb buffer for writing exported files (default is 4)\n"
+#if THREADING
+			"    -writebehind=N  write exported files in background I/O thread, N is the\n"
+			"                    maximal amount of queued data in Mb\n"
+#endif
 			"\n"
 			"Supported resources for export:\n"
 			"    SkeletalMesh    exported as ActorX psk file, MD5Mesh or glTF\n"
@@ -798,6 +933,13 @@ int main(int argc, const char **argv)
 	TArray<const char*> packagesToLoad, objectsToLoad;
 	TArray<const char*> params;
 	const char *attachAnimName = NULL;
+	int meshLods = -1;
+	const char *poseAnimName = NULL;
+#if RENDERING
+	float poseFrame = 0;
+#endif
+	const char *statsFilename = NULL;
+	int numShards = -1;
 	for (int arg = 1; arg < argc; arg++)
 	{
 		const char *opt = argv[arg];
@@ -827,7 +969,7 @@ int main(int argc, const char **argv)
 #endif
 			OPT_BOOL ("uncook",  GSettings.Export.SaveUncooked)
 			OPT_BOOL ("groups",  GSettings.Export.SaveGroups)
-			OPT_BOOL ("lods",    GExportLods)
+			OPT_BOOL ("lods",    GSettings.Export.ExportMeshLods)
 			OPT_BOOL ("uc",      GExportScripts)
 			// disable classes
 			OPT_NBOOL("nomesh",  GSettings.Startup.UseSkeletalMesh)
@@ -841,6 +983,10 @@ int main(int argc, const char **argv)
 			OPT_BOOL ("dds",     GSettings.Export.ExportDdsTexture)
 			OPT_BOOL ("notgacomp", GNoTgaCompress)
 			OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
+			OPT_BOOL ("dedup",   GExportDedup)
+			OPT_BOOL ("resume",  GResumeExport)
+			OPT_BOOL ("arena",   GUseObjectArena)
+			OPT_BOOL ("hashstats", GPrintHashDistribution)
 #if HAS_UI
 			OPT_BOOL ("gui",     forceUI)
 #endif
@@ -929,6 +1075,22 @@ int main(int argc, const char **argv)
 			objectsToLoad.Add(obj);
 			attachAnimName = obj;
 		}
+#if RENDERING
+		else if (!strnicmp(opt, "pose=", 5))
+		{
+			// -pose=Name[:Frame]
+			static char animName[256];
+			appStrncpyz(animName, opt+5, ARRAY_COUNT(animName));
+			char* s = strrchr(animName, ':');
+			if (s)
+			{
+				*s++ = 0;
+				poseFrame = atof(s);
+			}
+			poseAnimName = animName;
+			mainCmd = CMD_Export;
+		}
+#endif
 		else if (!stricmp(opt, "3rdparty"))
 		{
 			GSettings.Startup.UseScaleForm = GSettings.Startup.UseFaceFx = true;
@@ -937,6 +1099,63 @@ int main(int argc, const char **argv)
 		{
 			HandleAesKeyOption(opt+4);
 		}
+		else if (!strnicmp(opt, "stats=json", 10))
+		{
+			const char* filename = "umodel_stats.json";
+			if (opt[10] == ':' && opt[11])
+				filename = opt+11;
+			else if (opt[10])
+				CommandLineError("invalid option: -%s", opt);
+			appEnableStats(filename);
+			statsFilename = filename;
+		}
+		else if (!strnicmp(opt, "maxfiles=", 9))
+		{
+			int NumFiles = atoi(opt+9);
+			if (NumFiles < 1)
+				CommandLineError("invalid option: -%s", opt);
+			GMaxOpenFiles = NumFiles;
+		}
+		else if (!strnicmp(opt, "writebuffer=", 12))
+		{
+			int SizeKb = atoi(opt+12);
+			if (SizeKb < 4 || SizeKb > 65536)
+				CommandLineError("invalid option: -%s", opt);
+			GFileWriteBufferSize = SizeKb << 10;
+		}
+#if THREADING
+		else if (!strnicmp(opt, "writebehind=", 12))
+		{
+			int SizeMb = atoi(opt+12);
+			if (SizeMb < 0 || SizeMb > 1024 || !isdigit(opt[12]))
+				CommandLineError("invalid option: -%s", opt);
+			GFileWriteBehindBudget = SizeMb << 20;
+		}
+#endif
+		else if (!strnicmp(opt, "shard=", 6))
+		{
+			if (sscanf(opt+6, "%d/%d", &GExportShardIndex, &GExportShardCount) != 2 ||
+				GExportShardCount < 1 || GExportShardIndex < 0 || GExportShardIndex >= GExportShardCount)
+			{
+				CommandLineError("invalid option: -%s", opt);
+			}
+		}
+#if THREADING
+		else if (!strnicmp(opt, "shards=", 7))
+		{
+			numShards = atoi(opt+7);
+			if (numShards < 0 || numShards > 1024 || !isdigit(opt[7]))
+				CommandLineError("invalid option: -%s", opt);
+			if (numShards == 0)
+				numShards = CThread::GetLogicalCPUCount();
+		}
+#endif
+		else if (!strnicmp(opt, "meshlods=", 9))
+		{
+			meshLods = atoi(opt+9);
+			if (meshLods < 0 || !isdigit(opt[9]))
+				CommandLineError("invalid option: -%s", opt);
+		}
 		// information commands
 		else if (!stricmp(opt, "taglist"))
 		{
@@ -964,6 +1183,12 @@ int main(int argc, const char **argv)
 		{
 			GEnableThreads = false;
 		}
+		else if (!strnicmp(opt, "threads=", 8))
+		{
+			GMaxThreads = atoi(opt+8);
+			if (GMaxThreads < 1 || !isdigit(opt[8]))
+				CommandLineError("invalid thread count in -threads option");
+		}
 #endif
 		else if (!stricmp(opt, "testexport"))
 		{
@@ -980,6 +1205,16 @@ int main(int argc, const char **argv)
 		}
 	}
 
+#if THREADING
+	if (numShards >= 0)
+	{
+		// Driver mode: the work is done by child processes
+		if (mainCmd != CMD_Export || GExportShardCount)
+			CommandLineError("-shards could be used only for export, without -shard option");
+		return RunShardedExport(argc, argv, numShards, statsFilename);
+	}
+#endif
+
 	// Parse UMODEL [package_name [obj_name [class_name]]]
 	const char *argPkgName   = (params.Num() >= 1) ? params[0] : NULL;
 	const char *argObjName   = (params.Num() >= 2) ? params[1] : NULL;
@@ -1021,6 +1256,14 @@ int main(int argc, const char **argv)
 	GForceCompMethod = GSettings.Startup.PackageCompression;
 	GSettings.Export.Apply();
 
+#if UNREAL4
+	// Export without -lods uses only the first mesh LOD, don't keep other ones in memory
+	if (meshLods < 0 && mainCmd == CMD_Export && !GExportLods)
+		meshLods = 1;
+	if (meshLods >= 0)
+		GMaxMeshLods = meshLods;
+#endif
+
 	TArray<UnPackage*> Packages;
 	TArray<UObject*> Objects;
 
@@ -1077,8 +1320,23 @@ int main(int argc, const char **argv)
 		TStaticArray<const CGameFileInfo*, 32> Files;
 		appFindGameFiles(packagesToLoad[i], Files);
 
+		if (GExportShardCount)
+		{
+			// Keep only packages of the current shard
+			int NumFiles = 0;
+			for (int j = 0; j < Files.Num(); j++)
+			{
+				if (IsPackageInExportShard(*Files[j]->GetRelativeName()))
+					Files[NumFiles++] = Files[j];
+			}
+			if (!NumFiles && Files.Num()) continue;
+			Files.RemoveAt(NumFiles, Files.Num() - NumFiles);
+		}
+
 		if (!Files.Num())
 		{
+			if (GExportShardCount && !IsPackageInExportShard(packagesToLoad[i]))
+				continue;
 			// Handling case when only full package name has been passes: appFindGameFiles
 			// won't handle this, but UnPackage::LoadPackage() has a possibility to find a
 			// package with a full file name.
@@ -1118,6 +1376,12 @@ int main(int argc, const char **argv)
 		}
 	}
 
+	if (!GameFiles.Num() && GExportShardCount)
+	{
+		appPrintf("No packages in shard %d/%d\n", GExportShardIndex, GExportShardCount);
+		return 0;
+	}
+
 #if !HAS_UI
 	if (!GameFiles.Num())
 	{
@@ -1176,7 +1440,7 @@ int main(int argc, const char **argv)
 		return 0;					// already displayed when loaded package; extend it?
 	}
 
-	bool bShouldLoadObjects = (mainCmd != CMD_Export) || (objectsToLoad.Num() > 0);
+	bool bShouldLoadObjects = (mainCmd != CMD_Export) || (objectsToLoad.Num() > 0) || poseAnimName;
 
 	// load requested objects if any, or fully load everything
 	UObject::BeginLoad();
@@ -1257,6 +1521,26 @@ int main(int argc, const char **argv)
 	if (mainCmd == CMD_Export)
 	{
 		// If we have list of objects, the process only those ones. Otherwise, process full packages.
+#if RENDERING
+		if (poseAnimName)
+		{
+			if (Objects.Num() && !HasSkeletalMeshes(Objects))
+			{
+				// Only animation was specified with -anim or -obj option, pose all meshes of the packages
+				UObject::BeginLoad();
+				for (int pkg = 0; pkg < Packages.Num(); pkg++)
+					LoadWholePackage(Packages[pkg]);
+				UObject::EndLoad();
+				Objects.Empty();
+			}
+			BeginExport(true);
+			int NumPosed = ExportPosedMeshes(Objects.Num() ? Objects : UObject::GObjObjects, poseAnimName, poseFrame);
+			EndExport();
+			if (!NumPosed)
+				appPrintf("ERROR: no skeletal meshes were posed\n");
+		}
+		else
+#endif
 		if (Objects.Num())
 		{
 			BeginExport(true);
@@ -1334,7 +1618,7 @@ int main(int argc, const char **argv)
 //	ReleaseAllObjects();
 #if DUMP_MEM_ON_EXIT
 	//!! note: CUmodelApp is not destroyed here
-	appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
+	appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", appGetAllocationSize(), appGetAllocationCount());
 	appDumpMemoryAllocations();
 #endif
 
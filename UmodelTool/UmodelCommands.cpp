@@ -5,8 +5,15 @@
 #include "UnrealPackage/UnPackage.h"
 
 #include "UnrealPackage/PackageUtils.h"
+#include "FileSystem/GameFileSystem.h"
 #include "Exporters/Exporters.h"
 #include "UmodelApp.h"
+#include "UmodelCommands.h"
+
+#include "Parallel.h"
+#include "HashIndex.h"
+
+bool GResumeExport = false;
 
 
 bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
@@ -51,6 +58,204 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Export manifest
+-----------------------------------------------------------------------------*/
+
+// The manifest is an append-only text file in the export directory. When all files of a package
+// are written, names of these files are appended to the manifest as "file" lines, followed by the
+// "package" line with the package name and the key of its source file. Files of interrupted export
+// are not followed by the "package" line, so they're ignored when the manifest is loaded.
+// Every process of sharded export appends to its own manifest file, because appending to a shared
+// file is not atomic on all platforms. Manifests of all shards are loaded on resume, so the export
+// could be resumed with a different number of shards.
+
+#define EXPORT_MANIFEST_NAME		"umodel_manifest.txt"
+#define EXPORT_SHARD_MANIFEST_NAME	"umodel_manifest.%d.txt"
+
+// Key of the package source file: it changes when the file is modified or replaced with a patched one
+static uint64 GetPackageSourceKey(const UnPackage* Package)
+{
+	int64 Data[4];
+	const CGameFileInfo* Info = Package->FileInfo;
+	if (Info)
+	{
+		Data[0] = Info->Size;
+		Data[1] = Info->ExtraSizeInKb;
+		Data[2] = Info->FileSystem ? Info->FileSystem->GetFileOffset(Info->IndexInVfs) : -1;
+		Data[3] = 0;
+	}
+	else
+	{
+		// Package was opened by path without registering in the game file system
+		const FPackageFileSummary& S = Package->Summary;
+		Data[0] = S.NameCount;
+		Data[1] = S.ExportCount;
+		Data[2] = S.ImportCount;
+		Data[3] = S.HeadersSize;
+	}
+	return appMemHash64(Data, sizeof(Data));
+}
+
+class CExportManifest
+{
+public:
+	CExportManifest()
+	:	File(NULL)
+	{}
+
+	~CExportManifest()
+	{
+		if (File) fclose(File);
+	}
+
+	// Load the list of exported packages from existing manifests, and open own manifest for appending
+	bool Open()
+	{
+		guard(CExportManifest::Open);
+
+		char Filename[MAX_PACKAGE_PATH];
+		char OwnFilename[MAX_PACKAGE_PATH];
+		if (GExportShardCount)
+			appSprintf(ARRAY_ARG(OwnFilename), "%s/" EXPORT_SHARD_MANIFEST_NAME, GetBaseExportDirectory(), GExportShardIndex);
+		else
+			appSprintf(ARRAY_ARG(OwnFilename), "%s/%s", GetBaseExportDirectory(), EXPORT_MANIFEST_NAME);
+
+		// Load records of non-sharded export, and of all shards. Only own manifest could be fixed
+		// after interrupted write, manifests of other shards could be still written by their processes.
+		TArray<CDirectoryEntry> Entries;
+		appEnumerateDirectory(GetBaseExportDirectory(), Entries);
+		bool bIncompleteLine = false;
+		for (const CDirectoryEntry& Entry : Entries)
+		{
+			if (Entry.IsDirectory) continue;
+			if (stricmp(*Entry.Name, EXPORT_MANIFEST_NAME))
+			{
+				// Check for the shard manifest name
+				int ShardIndex;
+				char ShardName[64];
+				if (sscanf(*Entry.Name, EXPORT_SHARD_MANIFEST_NAME, &ShardIndex) != 1) continue;
+				appSprintf(ARRAY_ARG(ShardName), EXPORT_SHARD_MANIFEST_NAME, ShardIndex);
+				if (stricmp(*Entry.Name, ShardName)) continue;
+			}
+			appSprintf(ARRAY_ARG(Filename), "%s/%s", GetBaseExportDirectory(), *Entry.Name);
+			bool bIncomplete = Load(Filename);
+			if (!stricmp(Filename, OwnFilename))
+				bIncompleteLine = bIncomplete;
+		}
+
+		appMakeDirectoryForFile(OwnFilename);
+		File = fopen(OwnFilename, "a");
+		if (!File)
+		{
+			appPrintf("ERROR: unable to open export manifest %s\n", OwnFilename);
+			return false;
+		}
+		// Do not append records to the interrupted line
+		if (bIncompleteLine) fputc('\n', File);
+		return true;
+
+		unguard;
+	}
+
+	bool IsPackageExported(const char* Name, uint64 Key) const
+	{
+		int Index = FindPackage(Name);
+		return Index >= 0 && Packages[Index].Key == Key;
+	}
+
+	// Append record for the completely exported package
+	void AddExportedPackage(const char* Name, uint64 Key, const TArray<FString>& Files)
+	{
+		guard(CExportManifest::AddExportedPackage);
+		FString Record;
+		for (const FString& F : Files)
+		{
+			Record += "file\t";
+			Record += *F;
+			Record.AppendChar('\n');
+		}
+		char Line[MAX_PACKAGE_PATH + 64];
+		appSprintf(ARRAY_ARG(Line), "package\t%016llx\t%s\n", (unsigned long long)Key, Name);
+		Record += Line;
+		fwrite(*Record, Record.Len(), 1, File);
+		// Make the record persistent before exporting the next package
+		fflush(File);
+		AddPackage(Name, Key);
+		unguard;
+	}
+
+protected:
+	struct CPackageRecord
+	{
+		FString		Name;
+		uint64		Key;
+	};
+
+	FILE*			File;
+	TArray<CPackageRecord> Packages;
+	CHashIndex		HashIndex;
+
+	// Add records from the manifest file. Returns true when the file ends with an interrupted line.
+	bool Load(const char* Filename)
+	{
+		FILE* f = fopen(Filename, "r");
+		if (!f) return false;
+		bool bIncompleteLine = false;
+		int NumRecords = 0;
+		char Line[MAX_PACKAGE_PATH * 2];
+		while (fgets(Line, sizeof(Line), f))
+		{
+			// Remove line end
+			char* s = strchr(Line, '\n');
+			bIncompleteLine = (s == NULL);
+			if (!s) continue;				// interrupted write, or too long line
+			*s = 0;
+			if (strncmp(Line, "package\t", 8) != 0) continue;
+			// Parse "package <key> <name>"
+			char* KeyStr = Line + 8;
+			char* Name = strchr(KeyStr, '\t');
+			if (!Name) continue;
+			*Name++ = 0;
+			AddPackage(Name, strtoull(KeyStr, NULL, 16));
+			NumRecords++;
+		}
+		fclose(f);
+		appPrintf("Loaded export manifest %s: %d packages\n", Filename, NumRecords);
+		return bIncompleteLine;
+	}
+
+	static uint64 GetNameHash(const char* Name)
+	{
+		return appStrihash64(Name, strlen(Name));
+	}
+
+	int FindPackage(const char* Name) const
+	{
+		for (CHashIndex::CIterator It(HashIndex, GetNameHash(Name)); It; ++It)
+		{
+			if (!stricmp(*Packages[*It].Name, Name))
+				return *It;
+		}
+		return -1;
+	}
+
+	void AddPackage(const char* Name, uint64 Key)
+	{
+		// The package could be exported again after its file was changed, the last record wins
+		int Index = FindPackage(Name);
+		if (Index < 0)
+		{
+			CPackageRecord* Record = new (Packages) CPackageRecord;
+			Record->Name = Name;
+			Index = Packages.Num() - 1;
+			HashIndex.Add(GetNameHash(Name), Index);
+		}
+		Packages[Index].Key = Key;
+	}
+};
+
+
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress)
 {
 	guard(ExportPackages);
@@ -73,6 +278,12 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 
 	BeginExport(true);
 
+	// With resume mode, skip packages which were exported by previous run, and record exported packages
+	CExportManifest Manifest;
+	bool bUseManifest = GResumeExport && !GDummyExport && Manifest.Open();
+	TArray<FString> ExportedFiles;
+	int NumSkippedPackages = 0;
+
 	// For each package: load a package, export, then release
 	for (int i = 0; i < Packages.Num(); i++)
 	{
@@ -84,6 +295,20 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 			cancelled = true;
 			break;
 		}
+		FString PackageName;
+		uint64 PackageKey = 0;
+		if (bUseManifest)
+		{
+			PackageName = package->GetFilename();
+			PackageKey = GetPackageSourceKey(package);
+			if (Manifest.IsPackageExported(*PackageName, PackageKey))
+			{
+				NumSkippedPackages++;
+				continue;
+			}
+			ExportedFiles.Empty();
+			CollectExportedFiles(&ExportedFiles);
+		}
 		// Load
 		if (!LoadWholePackage(package, Progress))
 		{
@@ -96,6 +321,16 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 			cancelled = true;
 			break;
 		}
+		if (bUseManifest)
+		{
+			// All files of the package should be written before it is recorded in the manifest
+#if THREADING
+			ThreadPool::WaitForCompletion();
+#endif
+			appFlushFileWrites();
+			CollectExportedFiles(NULL);
+			Manifest.AddExportedPackage(*PackageName, PackageKey, ExportedFiles);
+		}
 		// Release
 		ReleaseAllObjects();
 	}
@@ -103,6 +338,9 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 	// Cleanup
 	EndExport(true);
 
+	if (NumSkippedPackages)
+		appPrintf("Skipped %d packages exported by previous run\n", NumSkippedPackages);
+
 #if PROFILE
 //	appPrintProfiler();
 #endif
@@ -205,3 +443,201 @@ void SavePackages(const TArray<const CGameFileInfo*>& Packages, IProgressCallbac
 
 	unguard;
 }
+
+
+/*-----------------------------------------------------------------------------
+	Sharded export
+-----------------------------------------------------------------------------*/
+
+int GExportShardIndex = 0;
+int GExportShardCount = 0;
+
+bool IsPackageInExportShard(const char* PackageName)
+{
+	if (!GExportShardCount) return true;
+	uint64 Hash = appStrihash64(PackageName, strlen(PackageName));
+	return (int)(Hash % GExportShardCount) == GExportShardIndex;
+}
+
+#if THREADING
+
+#if _WIN32
+#define popen		_popen
+#define pclose		_pclose
+#else
+#include <sys/wait.h>						// for WEXITSTATUS
+#endif
+
+static void AppendCommandLineArg(FString& Cmd, const char* Arg)
+{
+	if (!Cmd.IsEmpty()) Cmd.AppendChar(' ');
+#if _WIN32
+	Cmd.AppendChar('"');
+	for (const char* s = Arg; *s; s++)
+	{
+		if (*s == '"') Cmd.AppendChar('\\');
+		Cmd.AppendChar(*s);
+	}
+	Cmd.AppendChar('"');
+#else
+	Cmd.AppendChar('\'');
+	for (const char* s = Arg; *s; s++)
+	{
+		if (*s == '\'')
+			Cmd += "'\\''";
+		else
+			Cmd.AppendChar(*s);
+	}
+	Cmd.AppendChar('\'');
+#endif
+}
+
+static CMutex ShardLogMutex;
+
+// Thread which reads the log of the export process and prints it with the shard prefix
+class CShardLogReader : public CThread
+{
+public:
+	int			Index;
+	FILE*		Pipe;
+	CSemaphore*	Done;
+	int			NumExported;
+	int			NumObjects;
+
+	virtual void Run()
+	{
+		// Leave space for the prefix, appPrintf() buffer is 4096 bytes
+		char Line[2048];
+		// fgets() splits long lines, the prefix is printed only at the start of a line
+		bool bLineStart = true;
+		while (fgets(Line, sizeof(Line), Pipe))
+		{
+			// Collect the summary printed by EndExport()
+			int Exported, Objects;
+			if (bLineStart && sscanf(Line, "Exported %d/%d objects", &Exported, &Objects) == 2)
+			{
+				NumExported += Exported;
+				NumObjects += Objects;
+			}
+			CMutex::ScopedLock Lock(ShardLogMutex);
+			if (bLineStart)
+				appPrintf("[%d] %s", Index, Line);
+			else
+				appPrintf("%s", Line);
+			int Len = strlen(Line);
+			bLineStart = Len > 0 && Line[Len - 1] == '\n';
+		}
+		Done->Signal();
+	}
+};
+
+int RunShardedExport(int argc, const char** argv, int NumShards, const char* StatsFilename)
+{
+	guard(RunShardedExport);
+
+	appPrintf("Starting %d export processes\n", NumShards);
+	unsigned long StartTime = appMilliseconds();
+
+	CSemaphore Done;
+	TArray<CShardLogReader*> Readers;
+	int Result = 0;
+
+	// Share CPUs between processes, unless thread count is specified in the command line
+	bool bHasThreadsOption = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!stricmp(argv[i], "-nomt") || !strnicmp(argv[i], "-threads=", 9))
+			bHasThreadsOption = true;
+	}
+	int ThreadsPerShard = max(CThread::GetLogicalCPUCount() / NumShards, 1);
+
+	for (int Shard = 0; Shard < NumShards; Shard++)
+	{
+		// Pass the same command line to the child process. The log file is written by this process only,
+		// and every child saves statistics to its own file, which is merged later.
+		FString Cmd;
+		AppendCommandLineArg(Cmd, argv[0]);
+		for (int i = 1; i < argc; i++)
+		{
+			const char* Arg = argv[i];
+			if (!strnicmp(Arg, "-shards=", 8) || !strnicmp(Arg, "-log=", 5) || !strnicmp(Arg, "-stats=", 7))
+				continue;
+			AppendCommandLineArg(Cmd, Arg);
+		}
+		char Buf[1024];
+		appSprintf(ARRAY_ARG(Buf), "-shard=%d/%d", Shard, NumShards);
+		AppendCommandLineArg(Cmd, Buf);
+		if (!bHasThreadsOption)
+		{
+			appSprintf(ARRAY_ARG(Buf), "-threads=%d", ThreadsPerShard);
+			AppendCommandLineArg(Cmd, Buf);
+		}
+		if (StatsFilename)
+		{
+			appSprintf(ARRAY_ARG(Buf), "-stats=json:%s.%d", StatsFilename, Shard);
+			AppendCommandLineArg(Cmd, Buf);
+		}
+		// Merge error messages into the log
+		Cmd += " 2>&1";
+#if _WIN32
+		// cmd.exe strips the first and the last quote characters of the command line
+		FString QuotedCmd("\"");
+		QuotedCmd += Cmd;
+		QuotedCmd.AppendChar('"');
+		Cmd = QuotedCmd;
+#endif
+
+		FILE* Pipe = popen(*Cmd, "r");
+		if (!Pipe)
+		{
+			appPrintf("ERROR: unable to start export process %d\n", Shard);
+			Result = 1;
+			continue;
+		}
+
+		CShardLogReader* Reader = new CShardLogReader;
+		Reader->Index = Shard;
+		Reader->Pipe = Pipe;
+		Reader->Done = &Done;
+		Reader->NumExported = Reader->NumObjects = 0;
+		Readers.Add(Reader);
+		Reader->Start();
+	}
+
+	// Wait until all processes close their output
+	for (int i = 0; i < Readers.Num(); i++)
+		Done.Wait();
+
+	int NumExported = 0, NumObjects = 0;
+	for (CShardLogReader* Reader : Readers)
+	{
+		int ExitCode = pclose(Reader->Pipe);
+#if !_WIN32
+		ExitCode = (ExitCode != -1 && WIFEXITED(ExitCode)) ? WEXITSTATUS(ExitCode) : 1;
+#endif
+		if (ExitCode != 0)
+		{
+			appPrintf("ERROR: export process %d failed with exit code %d\n", Reader->Index, ExitCode);
+			Result = 1;
+		}
+		NumExported += Reader->NumExported;
+		NumObjects += Reader->NumObjects;
+
+		if (StatsFilename)
+		{
+			char ShardStatsFilename[1024];
+			appSprintf(ARRAY_ARG(ShardStatsFilename), "%s.%d", StatsFilename, Reader->Index);
+			if (appMergeStats(ShardStatsFilename))
+				remove(ShardStatsFilename);
+		}
+		delete Reader;
+	}
+
+	appPrintf("Exported %d/%d objects in %d processes in %.1f sec\n", NumExported, NumObjects, NumShards,
+		(appMilliseconds() - StartTime) / 1000.0f);
+	return Result;
+
+	unguard;
+}
+
+#endif // THREADING
@@ -10,6 +10,22 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress
 // Export everything from provided package list.
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress = NULL);
 
+// Skip packages recorded in the export manifest by previous ExportPackages() call, see "-resume" option.
+extern bool GResumeExport;
+
+// Partition of the package list processed by this process, see "-shard=i/N" option. GExportShardCount
+// is 0 when the whole list is processed.
+extern int GExportShardIndex;
+extern int GExportShardCount;
+
+// Check if the package belongs to the current shard. The result depends only on the package name,
+// so all processes get the same partition regardless of the order of found files.
+bool IsPackageInExportShard(const char* PackageName);
+
+// Run export in 'NumShards' child processes started with the same command line plus "-shard=i/N",
+// print their logs and merge statistics. Returns process exit code.
+int RunShardedExport(int argc, const char** argv, int NumShards, const char* StatsFilename);
+
 void DisplayPackageStats(const TArray<UnPackage*> &Packages);
 
 void SavePackages(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress = NULL);
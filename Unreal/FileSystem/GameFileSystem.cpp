@@ -7,6 +7,7 @@
 #include "IOStoreFileSystem.h"
 
 #include "Parallel.h"
+#include "HashIndex.h"
 
 // includes for file enumeration
 #if _WIN32
@@ -153,30 +154,27 @@ static TArray<CGameFileInfo*> GameFiles;
 int GNumPackageFiles = 0;
 int GNumForeignFiles = 0;
 
-#define GAME_FILE_HASH_SIZE		32768
+bool GPrintHashDistribution = false;
 
-//#define PRINT_HASH_DISTRIBUTION	1
 //#define DEBUG_HASH				1
 //#define DEBUG_HASH_NAME			"21680"
 
-static CGameFileInfo* GameFileHash[GAME_FILE_HASH_SIZE];
-
-#define GAME_FOLDER_HASH_SIZE	1024
+// Maps hash of file name without extension to index in GameFiles
+static CHashIndex GameFileHash;
 
 struct CGameFolderInfo
 {
 	FString Name;
-	int		HashNext;		// index in GameFileHash array
 	int		NumFiles;		// number of files located in this folder
 
 	CGameFolderInfo()
-	: HashNext(0)
-	, NumFiles(0)
+	: NumFiles(0)
 	{}
 };
 
 static TArray<CGameFolderInfo> GameFolders;
-static int GameFoldersHash[GAME_FOLDER_HASH_SIZE];
+// Maps hash of folder name to index in GameFolders
+static CHashIndex GameFoldersHash;
 
 
 #if UNREAL3
@@ -190,24 +188,13 @@ void FVirtualFileSystem::Reserve(int count)
 {
 	guard(FVirtualFileSystem::Reserve);
 	GameFiles.Reserve(GameFiles.Num() + count);
+	GameFileHash.Reserve(GameFiles.Num() + count);
 	unguard;
 }
 
-FORCEINLINE uint32 GetHashInternal(const char* s, int len)
-{
-	uint16 hash = 0;
-	for (int i = 0; i < len; i++)
-	{
-		char c = *s++ & 0xDF;				// uppercase the character with "& 0xDF"
-//		hash = ROL16(hash, 5) - hash + ((c << 4) + c ^ 0x13F);	// some crazy hash function
-		hash = ROL16(hash, 1) + c;			// note: if we'll use more than 16-bit GAME_FILE_HASH_SIZE value, should use ROL32 here
-	}
-	return hash;
-}
-
 // Compute hash for filename, with skipping file extension. Name should not have path.
 template<bool MayHaveExtension>
-static int GetHashForFileName(const char* FileName)
+static uint64 GetHashForFileName(const char* FileName)
 {
 	// Locate the end of string or extension
 	const char* s = FileName;
@@ -237,68 +224,46 @@ static int GetHashForFileName(const char* FileName)
 		s++;
 	}
 
-	uint32 hash = GetHashInternal(FileName, len) & (GAME_FILE_HASH_SIZE - 1);
+	uint64 hash = appStrihash64(FileName, len);
 #ifdef DEBUG_HASH_NAME
 	if (strstr(FileName, DEBUG_HASH_NAME))
-		appPrintf("-> hash[%s] (%s,%d) -> %X\n", FileName, s1, len, hash);
+		appPrintf("-> hash[%s] (%d) -> %llX\n", FileName, len, hash);
 #endif
 	return hash;
 }
 
-inline int GetHashForFolderName(const char* FolderName)
+inline uint64 GetHashForFolderName(const char* FolderName)
 {
-	return GetHashInternal(FolderName, strlen(FolderName)) & (GAME_FOLDER_HASH_SIZE - 1);
+	return appStrihash64(FolderName, strlen(FolderName));
 }
 
-#if PRINT_HASH_DISTRIBUTION
-
 static void PrintHashDistribution()
 {
-	int hashCounts[1024];
-	int totalCount = 0;
-	memset(hashCounts, 0, sizeof(hashCounts));
-	for (int hash = 0; hash < GAME_FILE_HASH_SIZE; hash++)
-	{
-		int count = 0;
-		for (CGameFileInfo* info = GameFileHash[hash]; info; info = info->HashNext)
-			count++;
-		assert(count < ARRAY_COUNT(hashCounts));
-		hashCounts[count]++;
-		totalCount += count;
-	}
-	appPrintf("Filename hash distribution: collision count -> num chains\n");
-	int totalCount2 = 0;
-	for (int i = 0; i < ARRAY_COUNT(hashCounts); i++)
-	{
-		int count = hashCounts[i];
-		if (count > 0)
-		{
-			totalCount2 += count * i;
-			float percent = totalCount2 * 100.0f / totalCount;
-			appPrintf("%d -> %d [%.1f%%]\n", i, count, percent);
-		}
-	}
-	assert(totalCount == totalCount2);
+	GameFileHash.PrintStats("File name");
+	GameFoldersHash.PrintStats("Folder name");
+#if UNREAL4
+	PrintPackageIdHashDistribution();
+#endif
 }
 
-#endif // PRINT_HASH_DISTRIBUTION
-
-int appGetGameFolderIndex(const char* FolderName)
+static int FindGameFolder(const char* FolderName, uint64 hash)
 {
-	int hash = GetHashForFolderName(FolderName);
-	for (int index = GameFoldersHash[hash]; index; /* empty */)
+	for (CHashIndex::CIterator It(GameFoldersHash, hash); It; ++It)
 	{
-		CGameFolderInfo& info = GameFolders[index];
-		if (!stricmp(*info.Name, FolderName))
+		if (!stricmp(*GameFolders[*It].Name, FolderName))
 		{
 			// Found
-			return index;
+			return *It;
 		}
-		index = info.HashNext;
 	}
 	return -1;
 }
 
+int appGetGameFolderIndex(const char* FolderName)
+{
+	return FindGameFolder(FolderName, GetHashForFolderName(FolderName));
+}
+
 int appGetGameFolderCount()
 {
 	return GameFolders.Num();
@@ -308,19 +273,10 @@ int RegisterGameFolder(const char* FolderName)
 {
 	guard(RegisterGameFolder);
 
-	// Find existing folder entry. Copy-pasted of appGetGameFolderIndex, but with passing 'hash'
-	// to the code below.
-	int hash = GetHashForFolderName(FolderName);
-	for (int index = GameFoldersHash[hash]; index; /* empty */)
-	{
-		CGameFolderInfo& info = GameFolders[index];
-		if (!stricmp(*info.Name, FolderName))
-		{
-			// Found
-			return index;
-		}
-		index = info.HashNext;
-	}
+	// Find existing folder entry
+	uint64 hash = GetHashForFolderName(FolderName);
+	int index = FindGameFolder(FolderName, hash);
+	if (index >= 0) return index;
 
 	// Add new entry
 
@@ -339,8 +295,7 @@ int RegisterGameFolder(const char* FolderName)
 	int newIndex = GameFolders.AddDefaulted();
 	CGameFolderInfo& info = GameFolders[newIndex];
 	info.Name = FolderName; // there's no much need to pass folder name through appStrdupPool, so keep it as FString
-	info.HashNext = GameFoldersHash[hash];
-	GameFoldersHash[hash] = newIndex;
+	GameFoldersHash.Add(hash, newIndex);
 
 	return newIndex;
 
@@ -658,12 +613,13 @@ CGameFileInfo* CGameFileInfo::Register(FVirtualFileSystem* parentVfs, const CReg
 	}
 #endif // UNREAL3
 
-	int hash = GetHashForFileName<true>(info->ShortFilename);
+	uint64 hash = GetHashForFileName<true>(info->ShortFilename);
 
 	// find if we have previously registered file with the same name
 	FastNameComparer FilenameCmp(info->ShortFilename);
-	for (CGameFileInfo* prevInfo = GameFileHash[hash]; prevInfo; prevInfo = prevInfo->HashNext)
+	for (CHashIndex::CIterator It(GameFileHash, hash); It; ++It)
 	{
+		CGameFileInfo* prevInfo = GameFiles[*It];
 		if ((prevInfo->FolderIndex == FolderIndex) && FilenameCmp(prevInfo->ShortFilename))
 		{
 			// this is a duplicate of the file (patch), use new information
@@ -671,7 +627,7 @@ CGameFileInfo* CGameFileInfo::Register(FVirtualFileSystem* parentVfs, const CReg
 			// return allocated info back to pool, so it will be reused next time
 			DeallocFileInfo(info);
 #if DEBUG_HASH
-			appPrintf("--> dup(%s) pkg=%d hash=%X\n", prevInfo->ShortFilename, prevInfo->IsPackage, hash);
+			appPrintf("--> dup(%s) pkg=%d hash=%llX\n", prevInfo->ShortFilename, prevInfo->IsPackage(), hash);
 #endif
 			return prevInfo;
 		}
@@ -683,15 +639,14 @@ CGameFileInfo* CGameFileInfo::Register(FVirtualFileSystem* parentVfs, const CReg
 		// Resize GameFiles array with large steps
 		GameFiles.Reserve(GameFiles.Num() + 1024);
 	}
-	GameFiles.Add(info);
+	int fileIndex = GameFiles.Add(info);
 	if (IsPackage) GNumPackageFiles++;
 	GameFolders[FolderIndex].NumFiles++;
 
-	info->HashNext = GameFileHash[hash];
-	GameFileHash[hash] = info;
+	GameFileHash.Add(hash, fileIndex);
 
 #if DEBUG_HASH
-	appPrintf("--> add(%s) pkg=%d hash=%X\n", info->ShortFilename, info->IsPackage, hash);
+	appPrintf("--> add(%s) pkg=%d hash=%llX\n", info->ShortFilename, info->IsPackage(), hash);
 #endif
 
 	return info;
@@ -699,86 +654,90 @@ CGameFileInfo* CGameFileInfo::Register(FVirtualFileSystem* parentVfs, const CReg
 	unguardf("%s", RegisterInfo.Filename);
 }
 
-static bool ScanGameDirectory(const char *dir, bool recurse)
+bool appEnumerateDirectory(const char* Dir, TArray<CDirectoryEntry>& Entries)
 {
-	guard(ScanGameDirectory);
+	guard(appEnumerateDirectory);
 
 	char Path[MAX_PACKAGE_PATH];
-	bool res = true;
-//	printf("Scan %s\n", dir);
-
-	struct FileInfo
-	{
-		FStaticString<256> Filename;	// short file name
-		int64 Size;						// file size
-	};
-
-	//todo: check - there's TArray<FStaticString> what's unsafe
-	TArray<FileInfo> Files;
-	Files.Empty(1024);
-
-	guard(ReadDir);
 
 #if _WIN32
-	appSprintf(ARRAY_ARG(Path), "%s/*.*", dir);
+	appSprintf(ARRAY_ARG(Path), "%s/*.*", Dir);
 	_finddatai64_t found;
 	intptr_t hFind = _findfirsti64(Path, &found);
-	if (hFind == -1) return true;
+	if (hFind == -1) return false;
 	do
 	{
 		if (found.name[0] == '.') continue;			// "." or ".."
-		// directory -> recurse
-		if (found.attrib & _A_SUBDIR)
-		{
-			if (recurse)
-			{
-				appSprintf(ARRAY_ARG(Path), "%s/%s", dir, found.name);
-				res = ScanGameDirectory(Path, recurse);
-			}
-		}
-		else
-		{
-			Files.Add( { found.name, found.size } );
-		}
-	} while (res && _findnexti64(hFind, &found) != -1);
+		CDirectoryEntry* Entry = new (Entries) CDirectoryEntry;
+		Entry->Name = found.name;
+		Entry->Size = found.size;
+		Entry->IsDirectory = (found.attrib & _A_SUBDIR) != 0;
+	} while (_findnexti64(hFind, &found) != -1);
 	_findclose(hFind);
 #else
-	DIR *find = opendir(dir);
-	if (!find) return true;
+	DIR *find = opendir(Dir);
+	if (!find) return false;
 	struct dirent *ent;
-	while (/*res &&*/ (ent = readdir(find)))
+	while ((ent = readdir(find)))
 	{
 		if (ent->d_name[0] == '.') continue;			// "." or ".."
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
-		// directory -> recurse
+		appSprintf(ARRAY_ARG(Path), "%s/%s", Dir, ent->d_name);
 		// note: using 'stat64' here because 'stat' ignores large files
 		struct stat64 buf;
 		if (stat64(Path, &buf) < 0) continue;			// or break?
-		if (S_ISDIR(buf.st_mode))
+		CDirectoryEntry* Entry = new (Entries) CDirectoryEntry;
+		Entry->Name = ent->d_name;
+		Entry->Size = buf.st_size;
+		Entry->IsDirectory = S_ISDIR(buf.st_mode);
+	}
+	closedir(find);
+#endif
+	return true;
+
+	unguardf("%s", Dir);
+}
+
+static bool ScanGameDirectory(const char *dir, bool recurse)
+{
+	guard(ScanGameDirectory);
+
+	char Path[MAX_PACKAGE_PATH];
+	bool res = true;
+//	printf("Scan %s\n", dir);
+
+	TArray<CDirectoryEntry> Entries;
+	Entries.Empty(1024);
+	appEnumerateDirectory(dir, Entries);
+
+	TArray<const CDirectoryEntry*> Files;
+	Files.Empty(Entries.Num());
+	for (const CDirectoryEntry& Entry : Entries)
+	{
+		// directory -> recurse
+		if (Entry.IsDirectory)
 		{
-			if (recurse)
+			if (recurse && res)
+			{
+				appSprintf(ARRAY_ARG(Path), "%s/%s", dir, *Entry.Name);
 				res = ScanGameDirectory(Path, recurse);
+			}
 		}
 		else
 		{
-			Files.Add( { ent->d_name, buf.st_size } );
+			Files.Add(&Entry);
 		}
 	}
-	closedir(find);
-#endif
-
-	unguard;
 
 	// Register files in sorted order - should be done for pak files, so patches will work.
-	Files.Sort([](const FileInfo& p1, const FileInfo& p2) -> int
+	Files.Sort([](const CDirectoryEntry* const& p1, const CDirectoryEntry* const& p2) -> int
 		{
-			return stricmp(*p1.Filename, *p2.Filename);
+			return stricmp(*p1->Name, *p2->Name);
 		});
 
-	for (const FileInfo& File : Files)
+	for (const CDirectoryEntry* File : Files)
 	{
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, *File.Filename);
-		RegisterGameFile(Path, File.Size);
+		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, *File->Name);
+		RegisterGameFile(Path, File->Size);
 	}
 
 	return res;
@@ -840,9 +799,9 @@ void appSetRootDirectory(const char *dir, bool recurse)
 	appPrintProfiler("Scanned game directory");
 #endif
 
-#if PRINT_HASH_DISTRIBUTION
-	PrintHashDistribution();
-#endif
+	if (GPrintHashDistribution)
+		PrintHashDistribution();
+
 	unguardf("dir=%s", dir);
 }
 
@@ -1025,9 +984,9 @@ const CGameFileInfo* CGameFileInfo::Find(const char *Filename, int GameFolder)
 	// Get hash before stripping extension (could be required for files with double extension, like .hdr.rtc for games with Redux textures).
 	// If 'Ext' has been provided, ShortFilename has NO extension, and we're going to append Ext to the filename later, so there's nothing to
 	// cut in this case.
-	int hash = GetHashForFileName<true>(ShortFilename);
+	uint64 hash = GetHashForFileName<true>(ShortFilename);
 #if DEBUG_HASH
-	appPrintf("--> find(%s) hash=%X\n", ShortFilename, hash);
+	appPrintf("--> find(%s) hash=%llX\n", ShortFilename, hash);
 #endif
 
 	// check for extension in filename
@@ -1040,7 +999,7 @@ const CGameFileInfo* CGameFileInfo::Find(const char *Filename, int GameFolder)
 	// 'Extension' points to extension, or NULL if not supplied (therefore looking for package file)
 
 #if defined(DEBUG_HASH_NAME) || DEBUG_HASH
-	appPrintf("--> Loading %s (%s, len=%d, hash=%X)\n", buf, ShortFilename, nameLenNoExt, hash);
+	appPrintf("--> Loading %s (%s, len=%d, hash=%llX)\n", buf, ShortFilename, nameLenNoExt, hash);
 #endif
 
 	CGameFileInfo* bestMatch = NULL;
@@ -1050,8 +1009,9 @@ const CGameFileInfo* CGameFileInfo::Find(const char *Filename, int GameFolder)
 	FastNameComparer nameCmp(ShortFilename, nameLenNoExt);
 	FastNameComparer extCmp(Extension ? Extension : "");
 
-	for (CGameFileInfo* info = GameFileHash[hash]; info; info = info->HashNext)
+	for (CHashIndex::CIterator It(GameFileHash, hash); It; ++It)
 	{
+		CGameFileInfo* info = GameFiles[*It];
 #if defined(DEBUG_HASH_NAME) || DEBUG_HASH
 		appPrintf("----> verify %s\n", *info->GetRelativeName());
 #endif
@@ -1166,15 +1126,16 @@ void CGameFileInfo::FindOtherFiles(TArray<const CGameFileInfo*>& files) const
 	if (!s) return;
 	*s = 0;
 
-	int hash = GetHashForFileName<false>(*Name);
+	uint64 hash = GetHashForFileName<false>(*Name);
 
 	// Restore point at extension part, for comparing "name."
 	*s = '.';
 	FastNameComparer FilenameCmp(*Name, s - *Name + 1);
 
 	int folderIndex = FolderIndex;
-	for (CGameFileInfo* otherFile = GameFileHash[hash]; otherFile; otherFile = otherFile->HashNext)
+	for (CHashIndex::CIterator It(GameFileHash, hash); It; ++It)
 	{
+		const CGameFileInfo* otherFile = GameFiles[*It];
 		if (otherFile->FolderIndex != folderIndex || otherFile == this)
 			continue;
 		if (FilenameCmp(otherFile->ShortFilename))
@@ -1186,33 +1147,234 @@ void CGameFileInfo::FindOtherFiles(TArray<const CGameFileInfo*>& files) const
 	unguard;
 }
 
-struct FindPackageWildcardData
+/*-----------------------------------------------------------------------------
+	Folder tree for wildcard search
+-----------------------------------------------------------------------------*/
+
+// Node of the folder prefix tree. Every registered folder has a node, plus there are
+// nodes for intermediate path components which has no files (e.g. "Game" for "Game/Maps").
+struct CFolderTreeNode
 {
-	TArray<const CGameFileInfo*> FoundFiles;
-	bool			WildcardContainsPath;
-	FString			Wildcard;
+	int		PathFolder;		// index of GameFolders entry whose name starts with this node's path
+	int		PathLen;		// length of node's path inside PathFolder name
+	int		FolderIndex;	// GameFolders index for this path, 0 for intermediate nodes
+	int		FirstChild;
+	int		NextSibling;
 };
 
-static bool FindPackageWildcardCallback(const CGameFileInfo *file, FindPackageWildcardData &data)
+// Node 0 is the root (empty path)
+static TArray<CFolderTreeNode> FolderTree;
+// Maps hash of node's path to index in FolderTree
+static CHashIndex FolderTreeHash;
+// Indices of packages in GameFiles grouped by folder: files of folder N are located
+// in FolderFiles[FolderFilesStart[N] .. FolderFilesStart[N+1]-1]
+static TArray<int> FolderFiles;
+static TArray<int> FolderFilesStart;
+// Numbers of files and folders the tree was built for
+static int FolderTreeNumFiles = -1;
+static int FolderTreeNumFolders = -1;
+
+static int FindFolderTreeNode(const char* Path, int Len, uint64 Hash)
 {
-	FStaticString<MAX_PACKAGE_PATH> Name;
+	for (CHashIndex::CIterator It(FolderTreeHash, Hash); It; ++It)
+	{
+		const CFolderTreeNode& Node = FolderTree[*It];
+		if (Node.PathLen == Len && !strnicmp(*GameFolders[Node.PathFolder].Name, Path, Len))
+		{
+			return *It;
+		}
+	}
+	return -1;
+}
+
+static void BuildFolderTree()
+{
+	guard(BuildFolderTree);
+
+	FolderTree.Empty(GameFolders.Num() * 2 + 1);
+	FolderTreeHash.Empty();
+	FolderTreeHash.Reserve(GameFolders.Num() * 2);
 
-	bool useThisPackage = false;
-	if (data.WildcardContainsPath)
+	CFolderTreeNode& Root = FolderTree.AddZeroed_GetRef();
+	Root.FirstChild = Root.NextSibling = -1;
+
+	// Folder 0 is invalid, skip it
+	for (int FolderIndex = 1; FolderIndex < GameFolders.Num(); FolderIndex++)
 	{
-		file->GetRelativeName(Name);
-		useThisPackage = appMatchWildcard(*Name, *data.Wildcard, true);
+		const char* Name = *GameFolders[FolderIndex].Name;
+		if (!Name[0])
+		{
+			// Files located in game's root directory
+			FolderTree[0].FolderIndex = FolderIndex;
+			continue;
+		}
+		// Walk over all path components, adding missing nodes
+		int ParentNode = 0;
+		for (int Len = 1; ; Len++)
+		{
+			char c = Name[Len];
+			if (c != '/' && c != 0) continue;
+			uint64 Hash = appStrihash64(Name, Len);
+			int Node = FindFolderTreeNode(Name, Len, Hash);
+			if (Node < 0)
+			{
+				Node = FolderTree.AddZeroed();
+				CFolderTreeNode& NewNode = FolderTree[Node];
+				NewNode.PathFolder = FolderIndex;
+				NewNode.PathLen = Len;
+				NewNode.FirstChild = -1;
+				NewNode.NextSibling = FolderTree[ParentNode].FirstChild;
+				FolderTree[ParentNode].FirstChild = Node;
+				FolderTreeHash.Add(Hash, Node);
+			}
+			ParentNode = Node;
+			if (!c) break;
+		}
+		FolderTree[ParentNode].FolderIndex = FolderIndex;
 	}
-	else
+
+	// Group packages by folder, preserving GameFiles order inside each folder
+	FolderFilesStart.Empty(GameFolders.Num() + 1);
+	FolderFilesStart.AddZeroed(GameFolders.Num() + 1);
+	int NumPackages = 0;
+	for (const CGameFileInfo* File : GameFiles)
 	{
-		file->GetCleanName(Name);
-		useThisPackage = appMatchWildcard(*Name, *data.Wildcard, true);
+		if (!File->IsPackage()) continue;
+		FolderFilesStart[File->FolderIndex + 1]++;
+		NumPackages++;
 	}
-	if (useThisPackage)
+	for (int i = 1; i <= GameFolders.Num(); i++)
 	{
-		data.FoundFiles.Add(file);
+		FolderFilesStart[i] += FolderFilesStart[i-1];
+	}
+	FolderFiles.Empty(NumPackages);
+	FolderFiles.AddUninitialized(NumPackages);
+	TArray<int> FillPos;
+	CopyArray(FillPos, FolderFilesStart);
+	for (int FileIndex = 0; FileIndex < GameFiles.Num(); FileIndex++)
+	{
+		const CGameFileInfo* File = GameFiles[FileIndex];
+		if (!File->IsPackage()) continue;
+		FolderFiles[FillPos[File->FolderIndex]++] = FileIndex;
+	}
+
+	FolderTreeNumFiles = GameFiles.Num();
+	FolderTreeNumFolders = GameFolders.Num();
+
+	unguard;
+}
+
+// Case-insensitive wildcard matcher which could consume text by parts, so path prefix
+// could be tested once for all files and subfolders. Matcher state is a set of mask
+// positions reachable after consuming the text. Matching rules are the same as in
+// appMatchWildcard(): '*' matches any sequence of characters including '/'.
+struct CWildcardMatcher
+{
+	char	Mask[MAX_PACKAGE_PATH];
+	int		MaskLen;
+
+	typedef byte State_t[MAX_PACKAGE_PATH+1];
+
+	void Init(const char* InMask)
+	{
+		appStrncpylwr(Mask, InMask, ARRAY_COUNT(Mask));
+		MaskLen = strlen(Mask);
+	}
+
+	// Include positions reachable by skipping '*'
+	FORCEINLINE void Closure(State_t& State) const
+	{
+		for (int i = 0; i < MaskLen; i++)
+		{
+			if (State[i] && Mask[i] == '*') State[i+1] = 1;
+		}
+	}
+
+	// Set state with all text up to mask position 'Pos' consumed
+	void InitState(State_t& State, int Pos) const
+	{
+		memset(State, 0, MaskLen + 1);
+		State[Pos] = 1;
+		Closure(State);
+	}
+
+	// Consume 'Len' characters of 'Text'. Returns false when mask can't match any text
+	// starting with consumed characters.
+	bool Consume(State_t& State, const char* Text, int Len) const
+	{
+		State_t NewState;
+		for (int TextPos = 0; TextPos < Len; TextPos++)
+		{
+			char c = tolower(Text[TextPos]);
+			memset(NewState, 0, MaskLen + 1);
+			bool bAny = false;
+			for (int i = 0; i < MaskLen; i++)
+			{
+				if (!State[i]) continue;
+				char m = Mask[i];
+				if (m == '*')
+				{
+					NewState[i] = 1;
+					bAny = true;
+				}
+				else if (m == '?' || m == c)
+				{
+					NewState[i+1] = 1;
+					bAny = true;
+				}
+			}
+			if (!bAny) return false;
+			Closure(NewState);
+			memcpy(State, NewState, MaskLen + 1);
+		}
+		return true;
+	}
+
+	// Check if the rest of text fully matches the mask
+	bool Match(const State_t& State, const char* Text) const
+	{
+		State_t TmpState;
+		memcpy(TmpState, State, MaskLen + 1);
+		return Consume(TmpState, Text, strlen(Text)) && TmpState[MaskLen];
+	}
+};
+
+static void MatchFolderFiles(const CWildcardMatcher& Matcher, const CWildcardMatcher::State_t& State, int FolderIndex, TArray<int>& OutFiles)
+{
+	for (int i = FolderFilesStart[FolderIndex]; i < FolderFilesStart[FolderIndex+1]; i++)
+	{
+		int FileIndex = FolderFiles[i];
+		if (Matcher.Match(State, GameFiles[FileIndex]->GetCleanName()))
+		{
+			OutFiles.Add(FileIndex);
+		}
+	}
+}
+
+// State corresponds to this node's path followed by '/'
+static void MatchFolderTree(const CWildcardMatcher& Matcher, const CWildcardMatcher::State_t& State, int NodeIndex, TArray<int>& OutFiles)
+{
+	const CFolderTreeNode& Node = FolderTree[NodeIndex];
+	if (Node.FolderIndex)
+	{
+		MatchFolderFiles(Matcher, State, Node.FolderIndex, OutFiles);
+	}
+
+	// Child's path is "<Node path>/<Component>", or just "<Component>" for the root node
+	int ComponentStart = NodeIndex ? Node.PathLen + 1 : 0;
+	for (int ChildIndex = Node.FirstChild; ChildIndex >= 0; ChildIndex = FolderTree[ChildIndex].NextSibling)
+	{
+		const CFolderTreeNode& Child = FolderTree[ChildIndex];
+		const char* ChildPath = *GameFolders[Child.PathFolder].Name;
+		CWildcardMatcher::State_t ChildState;
+		memcpy(ChildState, State, Matcher.MaskLen + 1);
+		// Skip the whole subtree if its path can't match the mask
+		if (Matcher.Consume(ChildState, ChildPath + ComponentStart, Child.PathLen - ComponentStart) &&
+			Matcher.Consume(ChildState, "/", 1))
+		{
+			MatchFolderTree(Matcher, ChildState, ChildIndex, OutFiles);
+		}
 	}
-	return true;
 }
 
 
@@ -1232,28 +1394,66 @@ void appFindGameFiles(const char *Filename, TArray<const CGameFileInfo*>& Files)
 
 	char buf[MAX_PACKAGE_PATH];
 	appStrncpyz(buf, Filename, ARRAY_COUNT(buf));
-	// replace backslashes
+	// replace backslashes, find the literal path prefix
 	bool containsPath = false;
+	int literalPathLen = 0;
+	bool literalPath = true;
 	for (char* s = buf; *s; s++)
 	{
 		char c = *s;
-		if (c == '\\')
+		if (c == '*' || c == '?')
 		{
-			*s = '/';
-			containsPath = true;
+			literalPath = false;
 		}
-		else if (c == '/')
+		else if (c == '\\' || c == '/')
 		{
+			*s = '/';
 			containsPath = true;
+			if (literalPath) literalPathLen = s - buf + 1;
 		}
 	}
 
-	FindPackageWildcardData findData;
-	findData.WildcardContainsPath = containsPath;
-	findData.Wildcard = buf;
-	appEnumGameFiles(FindPackageWildcardCallback, findData);
+	if (GameFiles.Num() != FolderTreeNumFiles || GameFolders.Num() != FolderTreeNumFolders)
+	{
+		// Files were registered since the last call
+		BuildFolderTree();
+	}
+
+	CWildcardMatcher Matcher;
+	Matcher.Init(buf);
+	CWildcardMatcher::State_t State;
 
-	CopyArray(Files, findData.FoundFiles);
+	TArray<int> FoundFiles;
+	if (containsPath)
+	{
+		// Find the folder matching the literal part of the mask, and search only inside it
+		int StartNode = 0;
+		if (literalPathLen > 1)
+		{
+			StartNode = FindFolderTreeNode(buf, literalPathLen - 1, appStrihash64(buf, literalPathLen - 1));
+		}
+		if (StartNode >= 0)
+		{
+			Matcher.InitState(State, StartNode ? literalPathLen : 0);
+			MatchFolderTree(Matcher, State, StartNode, FoundFiles);
+		}
+	}
+	else
+	{
+		// Mask has no path, match it against file names in all folders
+		Matcher.InitState(State, 0);
+		for (int FolderIndex = 1; FolderIndex < GameFolders.Num(); FolderIndex++)
+		{
+			MatchFolderFiles(Matcher, State, FolderIndex, FoundFiles);
+		}
+	}
+	// Return files in registration order
+	FoundFiles.Sort([](const int& A, const int& B) -> int { return A - B; });
+	Files.Empty(FoundFiles.Num());
+	for (int FileIndex : FoundFiles)
+	{
+		Files.Add(GameFiles[FileIndex]);
+	}
 
 	unguardf("wildcard=%s", Filename);
 }
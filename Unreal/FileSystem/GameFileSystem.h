@@ -31,6 +31,11 @@ public:
 	virtual bool AttachReader(FArchive* reader, FString& error) = 0;
 	// Open a file from VFS.
 	virtual FArchive* CreateReader(int index) = 0;
+	// Get position of the file inside VFS container, used to detect changed files. Returns -1 when not known.
+	virtual int64 GetFileOffset(int index) const
+	{
+		return -1;
+	}
 
 	// Reserve space for 'count' files
 	void Reserve(int count);
@@ -44,4 +49,15 @@ public:
 
 int RegisterGameFolder(const char* FolderName);
 
+// File or subdirectory of OS directory
+struct CDirectoryEntry
+{
+	FString		Name;					// short file name
+	int64		Size;					// file size
+	bool		IsDirectory;
+};
+
+// Get list of directory entries, "." and ".." are not included. Returns false if directory can't be opened.
+bool appEnumerateDirectory(const char* Dir, TArray<CDirectoryEntry>& Entries);
+
 #endif // __GAME_FILE_SYSTEM_H__
@@ -6,6 +6,8 @@
 
 #include "IOStoreFileSystem.h"
 
+#include "HashIndex.h"
+
 #if UNREAL4
 
 // Print file-chunk mapping for better understanding container structure
@@ -353,8 +355,6 @@ void FIOStoreFile::Serialize(void *data, int size)
 		IsFileOpen = true;
 	}
 
-	FArchive* Reader = Parent->Reader;
-
 	// References:
 	// - FIoStoreReaderImpl::Read() - simpler implementation
 	// - FFileIoStore::ReadBlocks() - more complex asynchronous reading, doing the same
@@ -378,15 +378,13 @@ void FIOStoreFile::Serialize(void *data, int size)
 			if (!(Parent->ContainerFlags & int(EIoContainerFlags::Encrypted)))
 			{
 				CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
-				Reader->Seek64(Block.GetOffset());
-				Reader->Serialize(CompressedData, CompressedBlockSize);
+				Parent->ReadData(Block.GetOffset(), CompressedData, CompressedBlockSize);
 			}
 			else
 			{
 				int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
 				CompressedData = (byte*)appMallocNoInit(EncryptedSize);
-				Reader->Seek64(Block.GetOffset());
-				Reader->Serialize(CompressedData, EncryptedSize);
+				Parent->ReadData(Block.GetOffset(), CompressedData, EncryptedSize);
 				FileRequiresAesKey();
 				Parent->DecryptDataBlock(CompressedData, EncryptedSize);
 			}
@@ -435,54 +433,60 @@ struct PackageHashEntry
 {
 	FPackageId Id;
 	const CGameFileInfo* File;
-	PackageHashEntry* Next;
 };
 
-#define PACKAGE_HASH_BITS	12
-#define PACKAGE_HASH_MASK	((1 << PACKAGE_HASH_BITS)-1)
-
-static PackageHashEntry* PackageHashHeads[1 << PACKAGE_HASH_BITS];
-static PackageHashEntry* PackageHashStore = NULL;
-static CMemoryChain* PackageHashMemory = NULL;
+static TArray<PackageHashEntry> PackageHashEntries;
+static CHashIndex PackageHash;
 
-FORCEINLINE int PackageIdToHash(FPackageId PackageId)
+// FPackageId is already a hash of the package name, but mix it to be safe
+FORCEINLINE uint64 PackageIdToHash(FPackageId PackageId)
 {
-	return PackageId & PACKAGE_HASH_MASK;
+	uint64 Hash = PackageId;
+	Hash ^= Hash >> 33;
+	Hash *= 0xFF51AFD7ED558CCDULL;
+	Hash ^= Hash >> 33;
+	return Hash;
 }
 
-const CGameFileInfo* FindPackageById(FPackageId PackageId)
+static PackageHashEntry* FindPackageEntry(FPackageId PackageId, uint64 Hash)
 {
-	int Hash = PackageIdToHash(PackageId);
-	for (const PackageHashEntry* Entry = PackageHashHeads[Hash]; Entry; Entry = Entry->Next)
+	for (CHashIndex::CIterator It(PackageHash, Hash); It; ++It)
 	{
-		if (Entry->Id == PackageId)
+		PackageHashEntry& Entry = PackageHashEntries[*It];
+		if (Entry.Id == PackageId)
 		{
-			return Entry->File;
+			return &Entry;
 		}
 	}
 	return NULL;
 }
 
+const CGameFileInfo* FindPackageById(FPackageId PackageId)
+{
+	const PackageHashEntry* Entry = FindPackageEntry(PackageId, PackageIdToHash(PackageId));
+	return Entry ? Entry->File : NULL;
+}
+
 void RegisterPackageId(FPackageId PackageId, const CGameFileInfo* File)
 {
-	int Hash = PackageIdToHash(PackageId);
-	for (PackageHashEntry* Entry = PackageHashHeads[Hash]; Entry; Entry = Entry->Next)
+	uint64 Hash = PackageIdToHash(PackageId);
+	if (PackageHashEntry* Entry = FindPackageEntry(PackageId, Hash))
 	{
-		if (Entry->Id == PackageId)
-		{
-			// The file could be overridden in patches
-			Entry->File = File;
-			return;
-		}
+		// The file could be overridden in patches
+		Entry->File = File;
+		return;
 	}
 
-	if (!PackageHashMemory) PackageHashMemory = new CMemoryChain();
-	PackageHashEntry* Entry = (PackageHashEntry*)PackageHashMemory->Alloc(sizeof(PackageHashEntry));
-	Entry->Next = PackageHashHeads[Hash];
-	PackageHashHeads[Hash] = Entry;
+	int Index = PackageHashEntries.AddUninitialized();
+	PackageHashEntry& Entry = PackageHashEntries[Index];
+	Entry.Id = PackageId;
+	Entry.File = File;
+	PackageHash.Add(Hash, Index);
+}
 
-	Entry->Id = PackageId;
-	Entry->File = File;
+void PrintPackageIdHashDistribution()
+{
+	PackageHash.PrintStats("Package id");
 }
 
 
@@ -528,6 +532,28 @@ void FIOStoreFileSystem::DecryptDataBlock(byte* Data, int DataSize)
 	unguard;
 }
 
+void FIOStoreFileSystem::ReadData(int64 Pos, void* Data, int Size)
+{
+	guard(FIOStoreFileSystem::ReadData);
+
+	FFileReader* FileReader = Reader->CastTo<FFileReader>();
+	if (FileReader)
+	{
+		// Positional read, doesn't touch shared reader state
+		FileReader->ReadAt(Pos, Data, Size);
+		return;
+	}
+
+	// Reader is not a file: seek and read under lock
+#if THREADING
+	CMutex::ScopedLock Lock(ReaderMutex);
+#endif
+	Reader->Seek64(Pos);
+	Reader->Serialize(Data, Size);
+
+	unguard;
+}
+
 bool FIOStoreFileSystem::AttachReader(FArchive* reader, FString& error)
 {
 	guard(FIOStoreFileSystem::AttachReader);
@@ -3,6 +3,10 @@
 
 #if UNREAL4
 
+#if THREADING
+#include "Parallel.h"
+#endif
+
 class FIOStoreFileSystem;
 enum class EIoChunkType : uint8;
 struct FIoChunkId;
@@ -87,10 +91,17 @@ protected:
 
 	void DecryptDataBlock(byte* Data, int DataSize);
 
+	// Read a block of container data, could be called from any thread
+	void ReadData(int64 Pos, void* Data, int Size);
+
 	void WalkDirectoryTreeRecursive(struct FIoDirectoryIndexResource& IndexResource, int DirectoryIndex, const FString& ParentDirectory);
 
 	FString Filename;
 	FArchive* Reader;
+#if THREADING
+	// Reader is shared by all files in the container, protect its state
+	CMutex ReaderMutex;
+#endif
 
 	// utoc/ucas information
 	bool bIsGlobalContainer;
@@ -107,6 +118,8 @@ protected:
 
 const CGameFileInfo* FindPackageById(FPackageId PackageId);
 
+void PrintPackageIdHashDistribution();
+
 #endif // UNREAL4
 
 #endif // __IOSTORE_FILE_SYSTEM_H__
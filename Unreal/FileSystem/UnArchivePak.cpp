@@ -9,11 +9,6 @@
 
 #define PAK_FILE_MAGIC		0x5A6F12E1
 
-// Number of pak file handles kept open when files no longer used (cache of open pak file handles).
-// We're limiting number of simultaneously open pak files to this value in a case game has number
-// of pak files exceeding C library limitations (2048 files in msvcrt.dll).
-#define MAX_OPEN_PAKS		32
-
 FArchive& operator<<(FArchive& Ar, FPakInfo& P)
 {
 	// New FPakInfo fields.
@@ -346,15 +341,13 @@ void FPakFile::Serialize(void *data, int size)
 				if (!Info->bEncrypted)
 				{
 					CompressedData = (byte*)appMallocNoInit(CompressedBlockSize);
-					Reader->Seek64(Block.CompressedStart);
-					Reader->Serialize(CompressedData, CompressedBlockSize);
+					Parent->ReadData(Block.CompressedStart, CompressedData, CompressedBlockSize);
 				}
 				else
 				{
 					int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
 					CompressedData = (byte*)appMallocNoInit(EncryptedSize);
-					Reader->Seek64(Block.CompressedStart);
-					Reader->Serialize(CompressedData, EncryptedSize);
+					Parent->ReadData(Block.CompressedStart, CompressedData, EncryptedSize);
 					FileRequiresAesKey();
 					Parent->DecryptDataBlock(CompressedData, EncryptedSize);
 				}
@@ -396,12 +389,11 @@ void FPakFile::Serialize(void *data, int size)
 				// Should fetch block and decrypt it.
 				// Note: AES is block encryption, so we should always align read requests for correct decryption.
 				UncompressedBufferPos = ArPos & ~(EncryptionAlign - 1);
-				Reader->Seek64(Info->Pos + Info->StructSize + UncompressedBufferPos);
 				int RemainingSize = Info->Size - UncompressedBufferPos;
 				if (RemainingSize > EncryptedBufferSize)
 					RemainingSize = EncryptedBufferSize;
 				RemainingSize = Align(RemainingSize, EncryptionAlign); // align for AES, pak contains aligned data
-				Reader->Serialize(UncompressedBuffer, RemainingSize);
+				Parent->ReadData(Info->Pos + Info->StructSize + UncompressedBufferPos, UncompressedBuffer, RemainingSize);
 				FileRequiresAesKey();
 				Parent->DecryptDataBlock(UncompressedBuffer, RemainingSize);
 			}
@@ -430,6 +422,9 @@ void FPakFile::Serialize(void *data, int size)
 		// Pure data
 		// seek every time in a case if the same 'Reader' was used by different FPakFile
 		// (this is a lightweight operation for buffered FArchive)
+	#if THREADING
+		CMutex::ScopedLock Lock(Parent->ReaderMutex);
+	#endif
 		Reader->Seek64(Info->Pos + Info->StructSize + ArPos);
 		Reader->Serialize(data, size);
 		ArPos += size;
@@ -535,9 +530,6 @@ bool FPakVFS::AttachReader(FArchive* reader, FString& error)
 	unguardf("PakVer=%d.%d", mainVer, subVer);
 }
 
-// FPakVFS objects which has Reader open, but no active files (MRU)
-static TStaticArray<FPakVFS*, MAX_OPEN_PAKS>  VFSWithOpenReaders;
-
 FArchive* FPakVFS::CreateReader(int index)
 {
 	guard(FPakVFS::CreateReader);
@@ -552,23 +544,14 @@ FArchive* FPakVFS::CreateReader(int index)
 void FPakVFS::FileOpened()
 {
 	guard(FPakVFS::FileOpened);
+#if THREADING
+	CMutex::ScopedLock Lock(ReaderMutex);
+#endif
 
-	if (NumOpenFiles++ == 0)
+	// OS file handles are cached by FFileReader, so reopening the pak is cheap
+	if (NumOpenFiles++ == 0 && !Reader->IsOpen())
 	{
-		// This is the very first open handle in pak.
-		// This pak could be in VFSWithOpenReaders list, in this case just reuse it without opening.
-		int FoundIndex = VFSWithOpenReaders.FindItem(this);
-		if (FoundIndex >= 0)
-		{
-			// This pak should be already opened
-			assert(VFSWithOpenReaders[FoundIndex]->Reader->IsOpen());
-			VFSWithOpenReaders.RemoveAt(FoundIndex);
-		}
-		else
-		{
-			if (!Reader->IsOpen())
-				Reader->Open();
-		}
+		Reader->Open();
 	}
 
 	unguard;
@@ -577,23 +560,41 @@ void FPakVFS::FileOpened()
 void FPakVFS::FileClosed()
 {
 	guard(FPakVFS::FileClosed);
+#if THREADING
+	CMutex::ScopedLock Lock(ReaderMutex);
+#endif
 
 	assert(NumOpenFiles > 0);
 	if (--NumOpenFiles == 0)
 	{
-		// Put this pak file into VFSWithOpenReaders.
-		// Check for MRU list overflow, drop the olders pak file.
-		if (VFSWithOpenReaders.Num() == MAX_OPEN_PAKS)
-		{
-			VFSWithOpenReaders[MAX_OPEN_PAKS-1]->Reader->Close();
-			VFSWithOpenReaders.RemoveAt(MAX_OPEN_PAKS-1);
-		}
-		VFSWithOpenReaders.Insert(this, 0);
+		Reader->Close();
 	}
 
 	unguard;
 }
 
+void FPakVFS::ReadData(int64 Pos, void* Data, int Size)
+{
+	guard(FPakVFS::ReadData);
+
+	FFileReader* FileReader = Reader->CastTo<FFileReader>();
+	if (FileReader)
+	{
+		// Positional read, doesn't touch shared reader state
+		FileReader->ReadAt(Pos, Data, Size);
+		return;
+	}
+
+	// Reader is not a file, e.g. obb archive: seek and read under lock
+#if THREADING
+	CMutex::ScopedLock Lock(ReaderMutex);
+#endif
+	Reader->Seek64(Pos);
+	Reader->Serialize(Data, Size);
+
+	unguard;
+}
+
 static bool ValidateString(FArchive& Ar)
 {
 	// We're operating with index data, which is definitely less than 2Gb of size, so use Tell instead of Tell64.
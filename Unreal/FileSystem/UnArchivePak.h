@@ -3,6 +3,10 @@
 
 #if UNREAL4
 
+#if THREADING
+#include "Parallel.h"
+#endif
+
 // Pak file versions
 enum
 {
@@ -169,6 +173,11 @@ public:
 
 	virtual FArchive* CreateReader(int index);
 
+	virtual int64 GetFileOffset(int index) const
+	{
+		return FileInfos[index].Pos;
+	}
+
 	const FString& GetPakEncryptionKey() const;
 
 protected:
@@ -179,6 +188,10 @@ protected:
 	int					NumEncryptedFiles;
 	int					NumOpenFiles;
 	FString				PakEncryptionKey;
+#if THREADING
+	// Reader is shared by all files in the pak, protect its state
+	CMutex				ReaderMutex;
+#endif
 
 	// Called when some FPakFile has been opened
 	void FileOpened();
@@ -186,6 +199,9 @@ protected:
 	// Called by FPakFile when it is destroyed
 	void FileClosed();
 
+	// Read a block of pak file data, could be called from any thread
+	void ReadData(int64 Pos, void* Data, int Size);
+
 	// UE4.24 and older
 	bool LoadPakIndexLegacy(FArchive* reader, const FPakInfo& info, FString& error);
 	// UE4.25 and newer
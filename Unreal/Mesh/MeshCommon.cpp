@@ -4,23 +4,70 @@
 #include "MeshCommon.h"
 #include "UnrealMesh/UnMathTools.h"		// CVertexShare
 #include "UnrealMaterial/UnMaterial.h"
+#include "Parallel.h"
 
 #define STRIP_BINORMAL		1
 
 // WARNING for BuildNnnCommon functions: do not access Verts[i] directly, use VERT macro only!
 #define VERT(n)		OffsetPointer(Verts, (n) * VertexSize)
 
+// Build lists of triangle corners (corner is an index in index buffer) grouped by a key (shared vertex
+// or wedge). Corners in each list are sorted by triangle index, so accumulating values in list order
+// gives the same result as a sequential loop over triangles. Corners of the key 'k' are placed at
+// OutCorners[OutStart[k] .. OutStart[k+1]-1].
+static void BuildCornerLists(const TArray<int>& CornerKeys, int NumKeys, TArray<int>& OutStart, TArray<int>& OutCorners)
+{
+	guard(BuildCornerLists);
+
+	int i;
+	int NumCorners = CornerKeys.Num();
+	const int* Keys = CornerKeys.GetData();
+
+	// count corners per key
+	OutStart.Empty(NumKeys + 1);
+	OutStart.AddZeroed(NumKeys + 1);
+	int* Start = OutStart.GetData();
+	for (i = 0; i < NumCorners; i++)
+		Start[Keys[i] + 1]++;
+	for (i = 1; i <= NumKeys; i++)
+		Start[i] += Start[i - 1];
+
+	// place corners, Start[k] will be advanced to the start of the next key ...
+	OutCorners.Empty(NumCorners);
+	OutCorners.AddUninitialized(NumCorners);
+	int* Corners = OutCorners.GetData();
+	for (i = 0; i < NumCorners; i++)
+		Corners[Start[Keys[i]]++] = i;
+	// ... so shift it back
+	for (i = NumKeys; i > 0; i--)
+		Start[i] = Start[i - 1];
+	Start[0] = 0;
+
+	unguard;
+}
+
+// Compute angles of triangle at its vertices
+static FORCEINLINE void ComputeCornerAngles(const CVecT* P[3], float Angle[3])
+{
+	CVecT D[3];				// 0->1, 1->2, 2->0
+	VectorSubtract(*P[1], *P[0], D[0]);
+	VectorSubtract(*P[2], *P[1], D[1]);
+	VectorSubtract(*P[0], *P[2], D[2]);
+	for (int j = 0; j < 3; j++) D[j].Normalize();
+	Angle[0] = acos(-dot(D[0], D[2]));
+	Angle[1] = acos(-dot(D[0], D[1]));
+	Angle[2] = acos(-dot(D[1], D[2]));
+}
+
 void BuildNormalsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const CIndexBuffer &Indices)
 {
 	guard(BuildNormalsCommon);
 
-	int i, j;
+	int i;
 
 	// Find vertices to share.
 	// We are using very simple algorithm here: to share all vertices with the same position
 	// independently on normals of faces which share this vertex.
-	TArray<CVec3> tmpNorm;
-	tmpNorm.AddZeroed(NumVerts);					// really will use Points.Num() items, which value is smaller than NumVerts
 	CVertexShare Share;
 	Share.Prepare(Verts, NumVerts, VertexSize);
 	for (i = 0; i < NumVerts; i++)
@@ -30,48 +77,66 @@ void BuildNormalsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const
 		Share.AddVertex(VERT(i)->Position, NullVec);
 	}
 
+	int NumTris = Indices.Num() / 3;
 	CIndexBuffer::IndexAccessor_t Index = Indices.GetAccessor();
-	for (i = 0; i < Indices.Num() / 3; i++)
-	{
-		CMeshVertex *V[3];
-		CVec3 *N[3];
-		for (j = 0; j < 3; j++)
+
+	// Compute angle-weighted face normal for each triangle corner. Triangles are processed in parallel,
+	// results are accumulated per shared vertex later without any locking.
+	TArray<CVec3> CornerNormals;
+	TArray<int> CornerPoints;
+	CornerNormals.AddUninitialized(NumTris * 3);
+	CornerPoints.AddUninitialized(NumTris * 3);
+	CVec3* CornerNormal = CornerNormals.GetData();
+	int* CornerPoint = CornerPoints.GetData();
+	const int* WedgeToVert = Share.WedgeToVert.GetData();
+	ParallelFor(NumTris, [&](int Tri)
 		{
-			int idx = Index(i * 3 + j);				// index in Verts[]
-			V[j] = VERT(idx);
-			N[j] = &tmpNorm[Share.WedgeToVert[idx]]; // remap to shared verts
-		}
-
-		// compute edges
-		CVec3 D[3];				// 0->1, 1->2, 2->0
-		VectorSubtract(V[1]->Position, V[0]->Position, D[0]);
-		VectorSubtract(V[2]->Position, V[1]->Position, D[1]);
-		VectorSubtract(V[0]->Position, V[2]->Position, D[2]);
-		// compute face normal
-		CVec3 norm;
-		cross(D[1], D[0], norm);
-		norm.Normalize();
-		// compute angles
-		for (j = 0; j < 3; j++) D[j].Normalize();
-		float angle[3];
-		angle[0] = acos(-dot(D[0], D[2]));
-		angle[1] = acos(-dot(D[0], D[1]));
-		angle[2] = acos(-dot(D[1], D[2]));
-		// add normals for triangle verts
-		for (j = 0; j < 3; j++)
-			VectorMA(*N[j], angle[j], norm);
-	}
+			const CVecT* P[3];
+			for (int j = 0; j < 3; j++)
+			{
+				int idx = Index(Tri * 3 + j);		// index in Verts[]
+				P[j] = &VERT(idx)->Position;
+				CornerPoint[Tri * 3 + j] = WedgeToVert[idx]; // remap to shared verts
+			}
+			// compute face normal
+			CVecT D0, D1, norm;
+			VectorSubtract(*P[1], *P[0], D0);
+			VectorSubtract(*P[2], *P[1], D1);
+			cross(D1, D0, norm);
+			norm.Normalize();
+			// compute angles
+			float angle[3];
+			ComputeCornerAngles(P, angle);
+			for (int j = 0; j < 3; j++)
+				VectorScale(norm, angle[j], CornerNormal[Tri * 3 + j]);
+		});
 
 	// TODO: add "hard angle threshold" - do not share vertex between faces when angle between them
 	// is too large.
 
-	// normalize shared normals ...
-	for (i = 0; i < Share.Points.Num(); i++)
-		tmpNorm[i].Normalize();
+	// Accumulate and normalize shared normals ...
+	TArray<int> PointCornerStart, PointCorners;
+	BuildCornerLists(CornerPoints, Share.Points.Num(), PointCornerStart, PointCorners);
+
+	TArray<CVec3> tmpNorm;
+	tmpNorm.AddUninitialized(Share.Points.Num());
+	CVec3* SharedNormal = tmpNorm.GetData();
+	const int* Start = PointCornerStart.GetData();
+	const int* Corners = PointCorners.GetData();
+	ParallelFor(Share.Points.Num(), [&](int Point)
+		{
+			CVec3& N = SharedNormal[Point];
+			N.Set(0, 0, 0);
+			for (int c = Start[Point]; c < Start[Point + 1]; c++)
+				VectorAdd(N, CornerNormal[Corners[c]], N);
+			N.Normalize();
+		});
 
 	// ... then place ("unshare") normals to Verts
-	for (i = 0; i < NumVerts; i++)
-		Pack(VERT(i)->Normal, tmpNorm[Share.WedgeToVert[i]]);
+	ParallelFor(NumVerts, [&](int Vert)
+		{
+			Pack(VERT(Vert)->Normal, SharedNormal[WedgeToVert[Vert]]);
+		});
 
 	unguard;
 }
@@ -81,92 +146,176 @@ void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, const CIndexBuffer
 {
 	guard(BuildTangentsCommon);
 
-	int i, j;
-
-	// TODO: this is not a 100% correct algorithm. Here we're iterating over all indices, processing the
-	// same wedge as many times as many triangles using it, with overwriting previous results. We should
-	// accumulate tangent value between triangles, counting number of triangles using them in a first
-	// loop. Then (in 2nd loop), offset the tangent vector to make it perpendicular to normal. And after
-	// this, in 3rd loop, compute a correct binormal.
-	// Should review the algorithm described above, to check for case when the same vertex should not
-	// share tangent space due to mirored texture (i.e. vertex use different tangent vector direction
-	// for different triangles).
+	// The algorithm is similar to MikkTSpace: per-face tangent and binormal are computed from UV
+	// gradients, normalized, weighted with the triangle angle at the vertex and accumulated per wedge.
+	// Then the tangent is made orthogonal to the wedge normal, and binormal sign is computed from the
+	// accumulated binormal. Wedges are not split when triangles sharing them have mirrored mapping,
+	// in this case the dominating direction wins.
+	int NumTris = Indices.Num() / 3;
 	CIndexBuffer::IndexAccessor_t Index = Indices.GetAccessor();
-	for (i = 0; i < Indices.Num() / 3; i++)
+
+	TArray<int> CornerWedges;
+	CornerWedges.AddUninitialized(NumTris * 3);
+	int NumVerts = 0;
+	for (int i = 0; i < NumTris * 3; i++)
 	{
-		CMeshVertex *V[3];
-		for (j = 0; j < 3; j++)
-		{
-			int idx = Index(i * 3 + j);
-			V[j] = VERT(idx);
-		}
-
-		// compute tangent
-		CVecT tang;
-		float U0 = V[0]->UV.U;
-		float V0 = V[0]->UV.V;
-		float U1 = V[1]->UV.U;
-		float V1 = V[1]->UV.V;
-		float U2 = V[2]->UV.U;
-		float V2 = V[2]->UV.V;
-
-		if (V0 == V2)
-		{
-			// W[0] -> W[2] -- axis for tangent
-			VectorSubtract(V[2]->Position, V[0]->Position, tang);
-			// we should make 'tang' to look in direction of growing 'U'
-			if (U2 < U0) tang.Negate();
-		}
-		else
+		int idx = Index(i);
+		CornerWedges[i] = idx;
+		if (idx >= NumVerts) NumVerts = idx + 1;
+	}
+
+	// Per-corner weighted tangent and binormal
+	TArray<CVec3> CornerTangents, CornerBinormals;
+	CornerTangents.AddUninitialized(NumTris * 3);
+	CornerBinormals.AddUninitialized(NumTris * 3);
+	const int* CornerWedge = CornerWedges.GetData();
+	CVec3* CornerTangent = CornerTangents.GetData();
+	CVec3* CornerBinormal = CornerBinormals.GetData();
+	ParallelFor(NumTris, [&](int Tri)
 		{
-			float pos = (V1 - V0) / (V2 - V0);			// fraction, where W[1] is placed between W[0] and W[2] (may be < 0 or > 1)
-			CVecT tmp;
-			Lerp(V[0]->Position, V[2]->Position, pos, tmp);
-			VectorSubtract(tmp, V[1]->Position, tang);
-			// tang.V == W[1].V; but tang.U may be greater or smaller than W[1].U
-			// we should make tang to look in side of growing U
-			float tU = Lerp(U0, U2, pos);
-			if (tU < U1) tang.Negate();
-		}
-		// now, tang is on triangle plane
-		// now we should place tangent orthogonal to normal, then normalize vector
-		float binormalScale = 1.0f;
-		for (j = 0; j < 3; j++)
+			const CMeshVertex* V[3];
+			const CVecT* P[3];
+			for (int j = 0; j < 3; j++)
+			{
+				V[j] = VERT(CornerWedge[Tri * 3 + j]);
+				P[j] = &V[j]->Position;
+			}
+
+			CVecT dP1, dP2;
+			VectorSubtract(*P[1], *P[0], dP1);
+			VectorSubtract(*P[2], *P[0], dP2);
+			float dU1 = V[1]->UV.U - V[0]->UV.U;
+			float dV1 = V[1]->UV.V - V[0]->UV.V;
+			float dU2 = V[2]->UV.U - V[0]->UV.U;
+			float dV2 = V[2]->UV.V - V[0]->UV.V;
+
+			CVecT tang, binorm;
+			float det = dU1 * dV2 - dU2 * dV1;
+			bool bValidMapping = fabs(det) > 1e-20f;
+			if (bValidMapping)
+			{
+				// tang = (dP1 * dV2 - dP2 * dV1) / det, binorm = (dP2 * dU1 - dP1 * dU2) / det
+				CVecT tmp;
+				tmp = dP1; tmp.Scale(dV2);
+				VectorMA(tmp, -dV1, dP2, tang);
+				tmp = dP2; tmp.Scale(dU1);
+				VectorMA(tmp, -dU2, dP1, binorm);
+				// we only need directions: the sign of 'det' defines orientation, and normalization
+				// removes the scale
+				if (det < 0)
+				{
+					tang.Negate();
+					binorm.Negate();
+				}
+				tang.Normalize();
+				binorm.Normalize();
+			}
+
+			float angle[3];
+			ComputeCornerAngles(P, angle);
+			for (int j = 0; j < 3; j++)
+			{
+				if (bValidMapping)
+				{
+					VectorScale(tang, angle[j], CornerTangent[Tri * 3 + j]);
+					VectorScale(binorm, angle[j], CornerBinormal[Tri * 3 + j]);
+				}
+				else
+				{
+					// degenerate mapping, the triangle doesn't contribute to tangents
+					CornerTangent[Tri * 3 + j].Set(0, 0, 0);
+					CornerBinormal[Tri * 3 + j].Set(0, 0, 0);
+				}
+			}
+		});
+
+	// Accumulate values per wedge
+	TArray<int> WedgeCornerStart, WedgeCorners;
+	BuildCornerLists(CornerWedges, NumVerts, WedgeCornerStart, WedgeCorners);
+	const int* Start = WedgeCornerStart.GetData();
+	const int* Corners = WedgeCorners.GetData();
+
+	ParallelFor(NumVerts, [&](int Vert)
 		{
-			CMeshVertex &DW = *V[j];
-			CVecT normal;
-			Unpack(normal, DW.Normal);
-			float pos = dot(normal, tang);
+			int FirstCorner = Start[Vert];
+			int EndCorner = Start[Vert + 1];
+			if (FirstCorner == EndCorner) return;		// wedge is not used by triangles
 
-			CVecT tangent;
-			VectorMA(tang, -pos, normal, tangent);
-			tangent.Normalize();
-			Pack(DW.Tangent, tangent);		// store
+			CVec3 tang, binorm;
+			tang.Set(0, 0, 0);
+			binorm.Set(0, 0, 0);
+			for (int c = FirstCorner; c < EndCorner; c++)
+			{
+				int Corner = Corners[c];
+				VectorAdd(tang, CornerTangent[Corner], tang);
+				VectorAdd(binorm, CornerBinormal[Corner], binorm);
+			}
 
-			CVecT binormal;
-			cross(normal, tangent, binormal);
-			binormal.Normalize();
-			if (j == 0)		// do this only once per triangle
+			CMeshVertex &DW = *VERT(Vert);
+			CVec3 normal;
+			Unpack(normal, DW.Normal);
+			// place tangent orthogonal to normal, then normalize vector
+			CVec3 tangent;
+			VectorMA(tang, -dot(normal, tang), normal, tangent);
+			if (tangent.Normalize() < 1e-6f)
 			{
-				// check binormal sign
-				// find two points with different V
-				int W1 = 0;
-				int W2 = (V1 != V0) ? 1 : 2;
-				// check projections of these points to binormal
-				float p1 = dot(V[W1]->Position, binormal);
-				float p2 = dot(V[W2]->Position, binormal);
-				if ((p1 - p2) * (V[W1]->UV.V - V[W2]->UV.V) < 0)
-					binormalScale = -1.0f;
+				// no valid tangent, use any vector orthogonal to normal
+				CVec3 axis;
+				axis.Set(0, 0, 0);
+				axis[fabs(normal[0]) < 0.9f ? 0 : 1] = 1.0f;
+				VectorMA(axis, -dot(normal, axis), normal, tangent);
+				tangent.Normalize();
 			}
+			Pack(DW.Tangent, tangent);		// store
+
+			// check binormal sign: binormal should look in side of growing V
+			CVec3 binormal;
+			cross(normal, tangent, binormal);
+			float binormalScale = (dot(binormal, binorm) < 0) ? -1.0f : 1.0f;
 #if !STRIP_BINORMAL
+			binormal.Normalize();
 			binormal.Scale(binormalScale);
 			Pack(DW.Binormal, binormal);	// store
 #else
 			DW.Normal.SetW(binormalScale);
 #endif
-		}
+		});
+
+	unguard;
+}
+
+void CBaseMeshLod::GetContentKey(FArchive& Ar, const void* Verts, int VertexSize) const
+{
+	guard(CBaseMeshLod::GetContentKey);
+
+	int NumSections = Sections.Num();
+	int VertCount = NumVerts;
+	int TexCoordCount = NumTexCoords;
+	int NumIndices = Indices.Num();
+	int Is32Bit = Indices.Is32Bit();
+	int HasColors = VertexColors != NULL;
+	Ar << NumSections << VertCount << TexCoordCount << NumIndices << Is32Bit << HasColors;
+
+	// Exported mesh refers materials by name
+	for (int i = 0; i < NumSections; i++)
+	{
+		const CMeshSection& S = Sections[i];
+		FString MaterialName(S.Material ? S.Material->Name : "None");
+		int FirstIndex = S.FirstIndex;
+		int NumFaces = S.NumFaces;
+		Ar << MaterialName << FirstIndex << NumFaces;
 	}
 
+	Ar.Serialize(const_cast<void*>(Verts), NumVerts * VertexSize);
+	for (int i = 0; i < NumTexCoords - 1; i++)
+		Ar.Serialize(ExtraUV[i], NumVerts * sizeof(CMeshUVFloat));
+	if (VertexColors)
+		Ar.Serialize(VertexColors, NumVerts * sizeof(FColor));
+	if (Is32Bit)
+		Ar.Serialize(const_cast<uint32*>(Indices.Indices32.GetData()), NumIndices * sizeof(uint32));
+	else
+		Ar.Serialize(const_cast<uint16*>(Indices.Indices16.GetData()), NumIndices * sizeof(uint16));
+
 	unguard;
 }
 
@@ -199,6 +199,9 @@ struct CBaseMeshLod
 		VertexColors = (FColor*)appMalloc(sizeof(FColor) * NumVerts);
 	}
 
+	// Serialize LOD data for UObject::GetContentKey(). Verts points to VertexSize-sized vertices.
+	void GetContentKey(FArchive& Ar, const void* Verts, int VertexSize) const;
+
 #if RENDERING
 	void LockMaterials();
 	void UnlockMaterials();
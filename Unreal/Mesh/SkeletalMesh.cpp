@@ -174,6 +174,60 @@ int CSkeletalMesh::GetRootBone() const
 #endif
 }
 
+void CSkeletalMesh::GetContentKey(FArchive& Ar) const
+{
+	guard(CSkeletalMesh::GetContentKey);
+
+	// Math types are serialized as raw data
+	CVec3 Origin = MeshOrigin, Scale = MeshScale;
+	FRotator Rot = RotOrigin;
+	Ar.Serialize(&Origin, sizeof(Origin));
+	Ar.Serialize(&Scale, sizeof(Scale));
+	Ar << Rot;
+
+	int NumBones = RefSkeleton.Num();
+	Ar << NumBones;
+	for (int i = 0; i < NumBones; i++)
+	{
+		CSkelMeshBone B = RefSkeleton[i];
+		Ar << B.Name << B.ParentIndex;
+		Ar.Serialize(&B.Position, sizeof(B.Position));
+		Ar.Serialize(&B.Orientation, sizeof(B.Orientation));
+	}
+
+	int NumSockets = Sockets.Num();
+	Ar << NumSockets;
+	for (int i = 0; i < NumSockets; i++)
+	{
+		CSkelMeshSocket S = Sockets[i];
+		Ar << S.Name << S.Bone;
+		Ar.Serialize(&S.Transform, sizeof(S.Transform));
+	}
+
+	int NumMorphs = Morphs.Num();
+	Ar << NumMorphs;
+	for (int i = 0; i < NumMorphs; i++)
+	{
+		CMorphTarget* Morph = Morphs[i];
+		int NumMorphLods = Morph->Lods.Num();
+		Ar << Morph->Name << NumMorphLods;
+		for (int j = 0; j < NumMorphLods; j++)
+		{
+			const TArray<CMorphVertex>& Verts = Morph->Lods[j].Vertices;
+			int NumMorphVerts = Verts.Num();
+			Ar << NumMorphVerts;
+			Ar.Serialize(const_cast<CMorphVertex*>(Verts.GetData()), NumMorphVerts * sizeof(CMorphVertex));
+		}
+	}
+
+	int NumLods = Lods.Num();
+	Ar << NumLods;
+	for (int i = 0; i < NumLods; i++)
+		Lods[i].GetContentKey(Ar, Lods[i].Verts, sizeof(CSkelMeshVertex));
+
+	unguard;
+}
+
 void CSkeletalMesh::FinalizeMesh()
 {
 	guard(CSkeletalMesh::FinalizeMesh);
@@ -192,6 +192,9 @@ public:
 	int FindBone(const char *Name) const;
 	int GetRootBone() const;
 
+	// Serialize mesh data for UObject::GetContentKey()
+	void GetContentKey(FArchive& Ar) const;
+
 #if DECLARE_VIEWER_PROPS
 	DECLARE_STRUCT(CSkeletalMesh)
 	BEGIN_PROP_TABLE
@@ -80,6 +80,15 @@ public:
 			Lods[i].BuildNormals();
 	}
 
+	// Serialize mesh data for UObject::GetContentKey()
+	void GetContentKey(FArchive& Ar) const
+	{
+		int NumLods = Lods.Num();
+		Ar << NumLods;
+		for (int i = 0; i < NumLods; i++)
+			Lods[i].GetContentKey(Ar, Lods[i].Verts, sizeof(CStaticMeshVertex));
+	}
+
 #if RENDERING
 	void LockMaterials()
 	{
@@ -1,6 +1,7 @@
 #include "Core.h"
 #include "UnCore.h"
 #include "TypeInfo.h"
+#include "HashIndex.h"
 
 #include "UnObject.h"		// dumping UObject in a few places
 
@@ -20,10 +21,35 @@ static int GClassCount = 0;
 static const char* GSuppressedClasses[MAX_SUPPRESSED_CLASSES];
 static int GSuppressedClassCount = 0;
 
+// Hash tables for FindClassType(), rebuilt after changing GClasses
+static CHashIndex GClassHash;			// hash of class name without prefix letter
+static CHashIndex GStructHash;			// hash of full type name
+static bool GClassHashValid = false;
+
+static void BuildClassHash()
+{
+	guard(BuildClassHash);
+	GClassHash.Empty();
+	GStructHash.Empty();
+	GClassHash.Reserve(GClassCount);
+	GStructHash.Reserve(GClassCount);
+	for (int i = 0; i < GClassCount; i++)
+	{
+		const char* Name = GClasses[i].Name;
+		int Len = strlen(Name);
+		GStructHash.Add(appStrihash64(Name, Len), i);
+		GClassHash.Add(appStrihash64(Name + 1, Len - 1), i);
+	}
+	GClassHashValid = true;
+	unguard;
+}
+
 void RegisterClasses(const CClassInfo* Table, int Count)
 {
 	if (Count <= 0) return;
 	assert(GClassCount + Count < ARRAY_COUNT(GClasses));
+	GClassHashValid = false;
+	ReleasePropertyCache();
 	for (int i = 0; i < Count; i++)
 	{
 		const char* ClassName = Table[i].Name;
@@ -53,6 +79,8 @@ void RegisterClasses(const CClassInfo* Table, int Count)
 
 void UnregisterClass(const char* Name, bool WholeTree)
 {
+	GClassHashValid = false;
+	ReleasePropertyCache();
 	for (int i = 0; i < GClassCount; i++)
 		if (!strcmp(GClasses[i].Name + 1, Name) ||
 			(WholeTree && (GClasses[i].TypeInfo()->IsA(Name))))
@@ -91,20 +119,24 @@ const CTypeInfo* FindClassType(const char* Name, bool ClassType)
 #if DEBUG_TYPES
 	appPrintf("--- find %s %s ... ", ClassType ? "class" : "struct", Name);
 #endif
-	for (int i = 0; i < GClassCount; i++)
+	if (!GClassHashValid) BuildClassHash();
+
+	// Find the first registered class with matching name
+	int Found = -1;
+	const CHashIndex& Hash = ClassType ? GClassHash : GStructHash;
+	for (CHashIndex::CIterator It(Hash, appStrihash64(Name, strlen(Name))); It; ++It)
 	{
+		int i = *It;
+		if (Found >= 0 && i > Found) continue;
 		// skip 1st char only for ClassType==true?
-		if (ClassType)
-		{
-			if (stricmp(GClasses[i].Name + 1, Name) != 0) continue;
-		}
-		else
-		{
-			if (stricmp(GClasses[i].Name, Name) != 0) continue;
-		}
+		const char* ClassName = ClassType ? GClasses[i].Name + 1 : GClasses[i].Name;
+		if (stricmp(ClassName, Name) == 0) Found = i;
+	}
 
-		if (!GClasses[i].TypeInfo) appError("No typeinfo for class");
-		const CTypeInfo *Type = GClasses[i].TypeInfo();
+	if (Found >= 0)
+	{
+		if (!GClasses[Found].TypeInfo) appError("No typeinfo for class");
+		const CTypeInfo *Type = GClasses[Found].TypeInfo();
 		// FindUnversionedProp() calls FindStructType for classes and structs, so disable the comparison for now
 		// if (Type->IsClass() != ClassType) continue;
 #if DEBUG_TYPES
@@ -217,29 +249,65 @@ struct PropPatch
 
 static TArray<PropPatch> Patches;
 
-/*static*/ void CTypeInfo::RemapProp(const char *ClassName, const char *OldName, const char *NewName)
+// Property lookup table, built for each CTypeInfo on first FindProperty() call. Contains
+// all properties visible from the type, including parent type's ones, with aliases and
+// patches already resolved. Property lookup is performed from the loading thread only,
+// so tables are not protected for multithreaded use.
+struct CPropLookupEntry
 {
-	PropPatch *p = new (Patches) PropPatch;
-	p->ClassName = ClassName;
-	p->OldName   = OldName;
-	p->NewName   = NewName;
-}
+	const char*			Name;
+	const CPropInfo*	Prop;			// NULL when property was remapped to non-existing one
+	const char*			MissingAlias;	// alias target which doesn't exist, reported on lookup
+};
 
-const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
+struct CPropLookupTable
 {
-	guard(CTypeInfo::FindProperty);
-	// check for remap
-	for (const PropPatch &p : Patches)
+	const CTypeInfo*	Type;
+	TArray<CPropLookupEntry> Entries;
+	CHashIndex			Hash;
+
+	const CPropLookupEntry* Find(const char* Name, uint64 NameHash) const
 	{
-		;
-		if (!stricmp(p.ClassName, this->Name) && !stricmp(p.OldName, Name))
+		for (CHashIndex::CIterator It(Hash, NameHash); It; ++It)
 		{
-			Name = p.NewName;
-			break;
+			const CPropLookupEntry& Entry = Entries[*It];
+			if (!stricmp(Entry.Name, Name)) return &Entry;
 		}
+		return NULL;
 	}
-	// find property
-	for (const CTypeInfo *Type = this; Type; Type = Type->Parent)
+
+	// Returns false if the name was already added
+	bool Add(const char* Name, const CPropInfo* Prop, const char* MissingAlias = NULL)
+	{
+		uint64 NameHash = appStrihash64(Name, strlen(Name));
+		if (Find(Name, NameHash)) return false;
+		int Index = Entries.AddUninitialized();
+		CPropLookupEntry& Entry = Entries[Index];
+		Entry.Name = Name;
+		Entry.Prop = Prop;
+		Entry.MissingAlias = MissingAlias;
+		Hash.Add(NameHash, Index);
+		return true;
+	}
+};
+
+static TArray<CPropLookupTable*> GPropTables;
+static CHashIndex GPropTableHash;
+
+FORCEINLINE uint64 GetPointerHash(const void* A, const void* B = NULL)
+{
+	uint64 Hash = (uint64)(size_t)A ^ ((uint64)(size_t)B * 0x9E3779B97F4A7C15ULL);
+	Hash ^= Hash >> 33;
+	Hash *= 0xFF51AFD7ED558CCDULL;
+	Hash ^= Hash >> 33;
+	return Hash;
+}
+
+// Find property in the type hierarchy without using lookup tables and patches
+static const CPropInfo* FindPropertyInTypes(const CTypeInfo* StartType, const char* Name, const char*& OutMissingAlias)
+{
+	OutMissingAlias = NULL;
+	for (const CTypeInfo *Type = StartType; Type; Type = Type->Parent)
 	{
 		const char* AliasName = NULL;
 		const CPropInfo* CurrentProp = Type->Props;
@@ -267,13 +335,174 @@ const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
 					return CurrentProp;
 				}
 			}
-			appError("Alias %s for property %s::%s not found", AliasName, this->Name, Name);
+			OutMissingAlias = AliasName;
+			return NULL;
 		}
 	}
 	return NULL;
+}
+
+static CPropLookupTable* BuildPropLookupTable(const CTypeInfo* Type)
+{
+	guard(BuildPropLookupTable);
+
+	CPropLookupTable* Table = new CPropLookupTable;
+	Table->Type = Type;
+
+	const char* MissingAlias;
+	// Patches has priority over real properties; the first matching patch is used
+	for (const PropPatch &p : Patches)
+	{
+		if (!stricmp(p.ClassName, Type->Name))
+		{
+			const CPropInfo* Prop = FindPropertyInTypes(Type, p.NewName, MissingAlias);
+			Table->Add(p.OldName, Prop, MissingAlias);
+		}
+	}
+	// Properties of derived type hides parent's properties with the same name. Only names are
+	// collected here, resolving is done with FindPropertyInTypes() to get the same aliasing rules.
+	for (const CTypeInfo* Parent = Type; Parent; Parent = Parent->Parent)
+	{
+		for (int i = 0; i < Parent->NumProps; i++)
+		{
+			const char* Name = Parent->Props[i].Name;
+			if (Table->Add(Name, NULL))
+			{
+				CPropLookupEntry& Entry = Table->Entries[Table->Entries.Num() - 1];
+				Entry.Prop = FindPropertyInTypes(Type, Name, Entry.MissingAlias);
+			}
+		}
+	}
+
+	int Index = GPropTables.Add(Table);
+	GPropTableHash.Add(GetPointerHash(Type), Index);
+	return Table;
+
+	unguardf("%s", Type->Name);
+}
+
+static const CPropLookupTable* GLastPropTable = NULL;
+
+static const CPropLookupTable* GetPropLookupTable(const CTypeInfo* Type)
+{
+	// Most often properties of the same type are requested several times in a row
+	if (GLastPropTable && GLastPropTable->Type == Type)
+		return GLastPropTable;
+
+	const CPropLookupTable* Table = NULL;
+	for (CHashIndex::CIterator It(GPropTableHash, GetPointerHash(Type)); It; ++It)
+	{
+		if (GPropTables[*It]->Type == Type)
+		{
+			Table = GPropTables[*It];
+			break;
+		}
+	}
+	if (!Table)
+	{
+		Table = BuildPropLookupTable(Type);
+	}
+	GLastPropTable = Table;
+	return Table;
+}
+
+static void ReleasePropLookupTables()
+{
+	for (CPropLookupTable* Table : GPropTables)
+	{
+		delete Table;
+	}
+	GPropTables.Empty();
+	GPropTableHash.Empty();
+	GLastPropTable = NULL;
+#if UNREAL4
+	// Schemas are holding resolved CPropInfo pointers too
+	ReleaseUnversionedSchemas();
+#endif
+}
+
+/*static*/ void CTypeInfo::RemapProp(const char *ClassName, const char *OldName, const char *NewName)
+{
+	PropPatch *p = new (Patches) PropPatch;
+	p->ClassName = ClassName;
+	p->OldName   = OldName;
+	p->NewName   = NewName;
+	// Patches are folded into lookup tables, so rebuild them
+	ReleasePropLookupTables();
+	ReleasePropertyCache();
+}
+
+const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
+{
+	guard(CTypeInfo::FindProperty);
+	const CPropLookupTable* Table = GetPropLookupTable(this);
+	const CPropLookupEntry* Entry = Table->Find(Name, appStrihash64(Name, strlen(Name)));
+	if (!Entry) return NULL;
+	if (Entry->MissingAlias)
+	{
+		appError("Alias %s for property %s::%s not found", Entry->MissingAlias, this->Name, Name);
+	}
+	return Entry->Prop;
 	unguard;
 }
 
+// Cache for FindPropertyCached(). Key is a pair of CTypeInfo and property name, where name
+// is a string from appStrdupPool(), so it is compared as pointer. Package names are stored
+// in the pool, so all property tags with the same name share the same pointer.
+struct CPropTagCacheEntry
+{
+	const CTypeInfo*	Type;
+	const char*			Name;
+	const CPropInfo*	Prop;
+	const CTypeInfo*	StructType;
+};
+
+static TArray<CPropTagCacheEntry> GPropTagCache;
+static CHashIndex GPropTagCacheHash;
+
+const CPropInfo *CTypeInfo::FindPropertyCached(const char *InternedName, const CTypeInfo** OutStructType) const
+{
+	guard(CTypeInfo::FindPropertyCached);
+
+	uint64 Hash = GetPointerHash(this, InternedName);
+	for (CHashIndex::CIterator It(GPropTagCacheHash, Hash); It; ++It)
+	{
+		const CPropTagCacheEntry& Entry = GPropTagCache[*It];
+		if (Entry.Type == this && Entry.Name == InternedName)
+		{
+			if (OutStructType) *OutStructType = Entry.StructType;
+			return Entry.Prop;
+		}
+	}
+
+	// Not cached yet
+	const CPropInfo* Prop = FindProperty(InternedName);
+	const CTypeInfo* StructType = NULL;
+	if (Prop && Prop->Count != 0 && Prop->TypeName)
+	{
+		StructType = FindStructType(Prop->TypeName);
+	}
+
+	int Index = GPropTagCache.AddUninitialized();
+	CPropTagCacheEntry& Entry = GPropTagCache[Index];
+	Entry.Type = this;
+	Entry.Name = InternedName;
+	Entry.Prop = Prop;
+	Entry.StructType = StructType;
+	GPropTagCacheHash.Add(Hash, Index);
+
+	if (OutStructType) *OutStructType = StructType;
+	return Prop;
+
+	unguardf("%s", InternedName);
+}
+
+void ReleasePropertyCache()
+{
+	GPropTagCache.Empty();
+	GPropTagCacheHash.Empty();
+}
+
 
 /*-----------------------------------------------------------------------------
 	CTypeInfo dump functionality
@@ -121,6 +121,27 @@ struct CPropInfo
 };
 
 
+#if UNREAL4
+
+// Special values for CUnversionedPropInfo::SkipSize
+#define UNVERSIONED_SKIP_UNKNOWN		0
+#define UNVERSIONED_SKIP_INT32_ARRAY	-1
+
+// Information about unversioned property, resolved from its index
+struct CUnversionedPropInfo
+{
+	// Property name or '#' marker, NULL for unknown property
+	const char*		Name;
+	// Resolved property, NULL for markers or not existing properties
+	const CPropInfo* Prop;
+	int				ArrayIndex;
+	// Number of bytes to skip for '#' marker, or UNVERSIONED_SKIP_... constant
+	int				SkipSize;
+	bool			bResolved;
+};
+
+#endif // UNREAL4
+
 struct CTypeInfo
 {
 	const char*		Name;
@@ -150,6 +171,9 @@ struct CTypeInfo
 	}
 	bool IsA(const char *TypeName) const;
 	const CPropInfo *FindProperty(const char *Name) const;
+	// The same as FindProperty(), but for names interned with appStrdupPool() (FName strings),
+	// results are cached by name pointer. Also returns typeinfo of property's structure type.
+	const CPropInfo *FindPropertyCached(const char *InternedName, const CTypeInfo** OutStructType = NULL) const;
 	static void RemapProp(const char *Class, const char *OldName, const char *NewName);
 
 	// Serialize Unreal engine UObject property block
@@ -158,6 +182,8 @@ struct CTypeInfo
 #if UNREAL4
 	void SerializeUnversionedProperties4(FArchive& Ar, void* ObjectData) const;
 	const char* FindUnversionedProp(int InPropIndex, int& OutArrayIndex, int InGame) const;
+	// The same as FindUnversionedProp(), with property resolved; results are cached per type and game
+	void FindUnversionedPropCached(int InPropIndex, int InGame, CUnversionedPropInfo& OutInfo) const;
 #endif
 
 	void ReadUnrealProperty(FArchive& Ar, struct FPropertyTag& Tag, void* ObjectData, int PropTagPos) const;
@@ -320,6 +346,14 @@ void SuppressUnknownClass(const char* ClassNameWildcard);
 const CTypeInfo* FindClassType(const char* Name, bool ClassType = true);
 bool IsSuppressedClass(const char* Name);
 
+// Drop cached results of CTypeInfo::FindPropertyCached()
+void ReleasePropertyCache();
+
+#if UNREAL4
+// Drop cached results of CTypeInfo::FindUnversionedPropCached()
+void ReleaseUnversionedSchemas();
+#endif
+
 FORCEINLINE const CTypeInfo *FindStructType(const char *Name)
 {
 	return FindClassType(Name, false);
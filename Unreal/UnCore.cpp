@@ -38,6 +38,385 @@ void appPrintProfiler(const char* label)
 #endif // PROFILE
 
 
+/*-----------------------------------------------------------------------------
+	Load and export statistics
+-----------------------------------------------------------------------------*/
+
+bool GStatsEnabled = false;
+
+static char StatsFilename[512];
+static uint64 StatsStartTime;
+
+#if THREADING
+static CMutex GStatsMutex;
+#endif
+
+// Innermost active scope of the current thread
+static thread_local CStatsScope* GCurrentStatsScope = NULL;
+
+void CStatsCounters::Add(const CStatsCounters& Other)
+{
+	BytesRead += Other.BytesRead;
+	BytesDecompressed += Other.BytesDecompressed;
+	BytesWritten += Other.BytesWritten;
+	for (int i = 0; i < STATS_Count; i++)
+	{
+		Time[i] += Other.Time[i];
+		Count[i] += Other.Count[i];
+	}
+}
+
+struct CStatsRecord
+{
+	CStatsRecord*	HashNext;
+	CStatsCounters	Counters;
+	char			Name[1];
+};
+
+#define STATS_HASH_SIZE		1024
+
+struct CStatsTable
+{
+	CStatsRecord*	Hash[STATS_HASH_SIZE];
+	TArray<CStatsRecord*> Records;
+
+	// Find a record by name, create a new one when not found
+	CStatsRecord* Find(const char* Name)
+	{
+		// FNV-1a hash, the same as in appStrdupPool()
+		uint32 hash = 0x811C9DC5;
+		for (const char* s = Name; *s; s++)
+			hash = 0x01000193 * (hash ^ *s);
+		hash &= STATS_HASH_SIZE - 1;
+
+		for (CStatsRecord* Rec = Hash[hash]; Rec; Rec = Rec->HashNext)
+		{
+			if (!strcmp(Rec->Name, Name))
+				return Rec;
+		}
+
+		int len = strlen(Name);
+		CStatsRecord* Rec = (CStatsRecord*)appMalloc(sizeof(CStatsRecord) + len); // note: null byte is taken into account in CStatsRecord
+		memcpy(Rec->Name, Name, len + 1);
+		Rec->HashNext = Hash[hash];
+		Hash[hash] = Rec;
+		Records.Add(Rec);
+		return Rec;
+	}
+};
+
+static CStatsTable StatsClasses;
+static CStatsTable StatsPackages;
+static CStatsCounters StatsTotals;
+static CStatsCounters StatsUnattributed;		// I/O performed outside of any CStatsScope
+static CFileHandleStats StatsMergedHandles;		// file handle statistics of merged reports
+static bool StatsHasMergedHandles = false;
+
+static const char* StatsScopeNames[] = { "open", "load", "postload", "export" };
+static_assert(ARRAY_COUNT(StatsScopeNames) == STATS_Count, "StatsScopeNames mismatch");
+
+void appEnableStats(const char* Filename)
+{
+	appStrncpyz(StatsFilename, Filename, ARRAY_COUNT(StatsFilename));
+	if (!GStatsEnabled)
+	{
+		GStatsEnabled = true;
+		StatsStartTime = appMicroseconds();
+		atexit(appDumpStats);
+	}
+}
+
+void CStatsScope::Begin(EStatsScope InKind, const char* InClassName, const char* InPackageName)
+{
+	Kind = InKind;
+	memset(&Counters, 0, sizeof(Counters));
+	ClassName = InClassName;
+	appStrncpyz(PackageName, InPackageName ? InPackageName : "", ARRAY_COUNT(PackageName));
+	ChildTime = 0;
+	Parent = GCurrentStatsScope;
+	GCurrentStatsScope = this;
+	StartTime = appMicroseconds();
+}
+
+void CStatsScope::End()
+{
+	uint64 Elapsed = appMicroseconds() - StartTime;
+	GCurrentStatsScope = Parent;
+	if (Parent) Parent->ChildTime += Elapsed;
+
+	Counters.Time[Kind] = Elapsed - ChildTime;
+	Counters.Count[Kind] = 1;
+
+#if THREADING
+	CMutex::ScopedLock Lock(GStatsMutex);
+#endif
+	StatsTotals.Add(Counters);
+	if (ClassName) StatsClasses.Find(ClassName)->Counters.Add(Counters);
+	if (PackageName[0]) StatsPackages.Find(PackageName)->Counters.Add(Counters);
+}
+
+void appStatsAddIO(int64 BytesRead, int64 BytesDecompressed, int64 BytesWritten)
+{
+	CStatsCounters* Counters;
+	CStatsScope* Scope = GCurrentStatsScope;
+	if (Scope)
+	{
+		// Scope is owned by current thread, no locking needed
+		Counters = &Scope->Counters;
+	}
+	else
+	{
+#if THREADING
+		GStatsMutex.Lock();
+#endif
+		Counters = &StatsUnattributed;
+	}
+
+	Counters->BytesRead += BytesRead;
+	Counters->BytesDecompressed += BytesDecompressed;
+	Counters->BytesWritten += BytesWritten;
+
+#if THREADING
+	if (!Scope) GStatsMutex.Unlock();
+#endif
+}
+
+static void WriteJsonString(FILE* f, const char* s)
+{
+	fputc('"', f);
+	for ( ; *s; s++)
+	{
+		char c = *s;
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if ((byte)c < 0x20)
+			fprintf(f, "\\u%04X", (byte)c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void WriteJsonCounters(FILE* f, const CStatsCounters& C)
+{
+	fprintf(f, "{ \"bytes_read\": %lld, \"bytes_decompressed\": %lld, \"bytes_written\": %lld",
+		(long long)C.BytesRead, (long long)C.BytesDecompressed, (long long)C.BytesWritten);
+	for (int i = 0; i < STATS_Count; i++)
+	{
+		if (C.Count[i])
+			fprintf(f, ", \"num_%s\": %d, \"%s_us\": %llu", StatsScopeNames[i], C.Count[i], StatsScopeNames[i], (unsigned long long)C.Time[i]);
+	}
+	fprintf(f, " }");
+}
+
+static void WriteJsonTable(FILE* f, const char* Label, CStatsTable& Table)
+{
+	// Sort records by name to make reports comparable
+	Table.Records.Sort([](CStatsRecord* const& A, CStatsRecord* const& B) -> int
+		{
+			return strcmp(A->Name, B->Name);
+		});
+
+	fprintf(f, "  \"%s\": {", Label);
+	for (int i = 0; i < Table.Records.Num(); i++)
+	{
+		const CStatsRecord* Rec = Table.Records[i];
+		fprintf(f, i ? ",\n    " : "\n    ");
+		WriteJsonString(f, Rec->Name);
+		fprintf(f, ": ");
+		WriteJsonCounters(f, Rec->Counters);
+	}
+	fprintf(f, "\n  }");
+}
+
+void appDumpStats()
+{
+	if (!GStatsEnabled) return;
+	GStatsEnabled = false;
+
+#if THREADING
+	CMutex::ScopedLock Lock(GStatsMutex);
+#endif
+
+	FILE* f = fopen(StatsFilename, "w");
+	if (!f)
+	{
+		appPrintf("Unable to create statistics file \"%s\"\n", StatsFilename);
+		return;
+	}
+
+	CStatsCounters Totals = StatsTotals;
+	Totals.Add(StatsUnattributed);
+
+	fprintf(f, "{\n  \"elapsed_us\": %llu,\n", (unsigned long long)(appMicroseconds() - StatsStartTime));
+	fprintf(f, "  \"totals\": ");
+	WriteJsonCounters(f, Totals);
+	fprintf(f, ",\n  \"unattributed\": ");
+	WriteJsonCounters(f, StatsUnattributed);
+	fprintf(f, ",\n");
+	WriteJsonTable(f, "classes", StatsClasses);
+	fprintf(f, ",\n");
+	WriteJsonTable(f, "packages", StatsPackages);
+
+	CFileHandleStats Handles;
+	appGetFileHandleStats(Handles);
+	if (StatsHasMergedHandles)
+	{
+		Handles.Opens += StatsMergedHandles.Opens;
+		Handles.Closes += StatsMergedHandles.Closes;
+		Handles.Evictions += StatsMergedHandles.Evictions;
+		Handles.Reuses += StatsMergedHandles.Reuses;
+		Handles.PeakOpen = max(Handles.PeakOpen, StatsMergedHandles.PeakOpen);
+	}
+	fprintf(f, ",\n  \"file_handles\": { \"opens\": %d, \"closes\": %d, \"evictions\": %d, \"reuses\": %d, \"peak_open\": %d, \"limit\": %d }",
+		Handles.Opens, Handles.Closes, Handles.Evictions, Handles.Reuses, Handles.PeakOpen, GMaxOpenFiles);
+	fprintf(f, "\n}\n");
+	fclose(f);
+
+	appPrintf("Statistics saved to %s\n", StatsFilename);
+	appPrintf("File handles: %d opens, %d closes (%d evictions), %d reuses, peak %d of %d\n",
+		Handles.Opens, Handles.Closes, Handles.Evictions, Handles.Reuses, Handles.PeakOpen, GMaxOpenFiles);
+}
+
+// Parse string written by WriteJsonString(), 's' is advanced after the closing quote
+static bool ParseJsonString(const char*& s, char* Out, int OutSize)
+{
+	if (*s != '"') return false;
+	s++;
+	int Len = 0;
+	while (*s && *s != '"')
+	{
+		char c = *s++;
+		if (c == '\\')
+		{
+			unsigned Code;
+			if (*s == 'u' && sscanf(s + 1, "%4X", &Code) == 1)
+			{
+				c = (char)Code;
+				s += 5;
+			}
+			else if (*s)
+			{
+				c = *s++;
+			}
+		}
+		if (Len < OutSize - 1) Out[Len++] = c;
+	}
+	Out[Len] = 0;
+	if (*s != '"') return false;
+	s++;
+	return true;
+}
+
+// Parse counters written by WriteJsonCounters()
+static bool ParseJsonCounters(const char* s, CStatsCounters& C)
+{
+	memset(&C, 0, sizeof(C));
+	long long BytesRead, BytesDecompressed, BytesWritten;
+	if (sscanf(s, "{ \"bytes_read\": %lld, \"bytes_decompressed\": %lld, \"bytes_written\": %lld",
+		&BytesRead, &BytesDecompressed, &BytesWritten) != 3)
+	{
+		return false;
+	}
+	C.BytesRead = BytesRead;
+	C.BytesDecompressed = BytesDecompressed;
+	C.BytesWritten = BytesWritten;
+	for (int i = 0; i < STATS_Count; i++)
+	{
+		char Key[64], Format[128];
+		appSprintf(ARRAY_ARG(Key), "\"num_%s\": ", StatsScopeNames[i]);
+		const char* p = strstr(s, Key);
+		if (!p) continue;
+		appSprintf(ARRAY_ARG(Format), "\"num_%s\": %%d, \"%s_us\": %%llu", StatsScopeNames[i], StatsScopeNames[i]);
+		unsigned long long Time;
+		if (sscanf(p, Format, &C.Count[i], &Time) == 2)
+			C.Time[i] = Time;
+	}
+	return true;
+}
+
+bool appMergeStats(const char* Filename)
+{
+	guard(appMergeStats);
+
+	FILE* f = fopen(Filename, "r");
+	if (!f) return false;
+
+#if THREADING
+	CMutex::ScopedLock Lock(GStatsMutex);
+#endif
+
+	CStatsCounters Totals, Unattributed;
+	memset(&Totals, 0, sizeof(Totals));
+	memset(&Unattributed, 0, sizeof(Unattributed));
+	CStatsTable* Table = NULL;
+
+	// The file has the fixed layout produced by appDumpStats(): every value which should be merged
+	// is placed on its own line
+	char Line[4096];
+	while (fgets(Line, sizeof(Line), f))
+	{
+		if (!strncmp(Line, "  \"totals\": ", 12))
+		{
+			ParseJsonCounters(Line + 12, Totals);
+		}
+		else if (!strncmp(Line, "  \"unattributed\": ", 18))
+		{
+			ParseJsonCounters(Line + 18, Unattributed);
+		}
+		else if (!strncmp(Line, "  \"classes\": {", 14))
+		{
+			Table = &StatsClasses;
+		}
+		else if (!strncmp(Line, "  \"packages\": {", 15))
+		{
+			Table = &StatsPackages;
+		}
+		else if (!strncmp(Line, "  }", 3))
+		{
+			Table = NULL;
+		}
+		else if (Table && !strncmp(Line, "    \"", 5))
+		{
+			const char* s = Line + 4;
+			char Name[1024];
+			CStatsCounters Counters;
+			if (ParseJsonString(s, ARRAY_ARG(Name)) && !strncmp(s, ": ", 2) && ParseJsonCounters(s + 2, Counters))
+				Table->Find(Name)->Counters.Add(Counters);
+		}
+		else if (!strncmp(Line, "  \"file_handles\": ", 18))
+		{
+			CFileHandleStats H;
+			if (sscanf(Line + 18, "{ \"opens\": %d, \"closes\": %d, \"evictions\": %d, \"reuses\": %d, \"peak_open\": %d",
+				&H.Opens, &H.Closes, &H.Evictions, &H.Reuses, &H.PeakOpen) == 5)
+			{
+				StatsMergedHandles.Opens += H.Opens;
+				StatsMergedHandles.Closes += H.Closes;
+				StatsMergedHandles.Evictions += H.Evictions;
+				StatsMergedHandles.Reuses += H.Reuses;
+				StatsMergedHandles.PeakOpen = max(StatsMergedHandles.PeakOpen, H.PeakOpen);
+				StatsHasMergedHandles = true;
+			}
+		}
+	}
+	fclose(f);
+
+	// "totals" of the report include "unattributed" counters, keep them separately as appDumpStats() does
+	StatsUnattributed.Add(Unattributed);
+	StatsTotals.BytesRead += Totals.BytesRead - Unattributed.BytesRead;
+	StatsTotals.BytesDecompressed += Totals.BytesDecompressed - Unattributed.BytesDecompressed;
+	StatsTotals.BytesWritten += Totals.BytesWritten - Unattributed.BytesWritten;
+	for (int i = 0; i < STATS_Count; i++)
+	{
+		StatsTotals.Time[i] += Totals.Time[i] - Unattributed.Time[i];
+		StatsTotals.Count[i] += Totals.Count[i] - Unattributed.Count[i];
+	}
+	return true;
+
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	FArray
 -----------------------------------------------------------------------------*/
@@ -73,6 +73,92 @@ void appPrintProfiler(const char* label = NULL);
 
 #define MAX_PACKAGE_PATH		512
 
+/*-----------------------------------------------------------------------------
+	Load and export statistics
+-----------------------------------------------------------------------------*/
+
+// Unlike PROFILE, this instrumentation is always compiled in, and enabled at runtime
+// with "-stats=json" command line option. Numbers are accumulated per object class and
+// per package, and written to a JSON file at exit.
+
+enum EStatsScope
+{
+	STATS_OpenPackage,			// package summary and name/import/export tables
+	STATS_Load,					// UObject::Serialize()
+	STATS_PostLoad,				// UObject::PostLoad()
+	STATS_Export,				// exporter function
+	STATS_Count
+};
+
+struct CStatsCounters
+{
+	int64		BytesRead;					// bytes read from disk
+	int64		BytesDecompressed;			// output of appDecompress()
+	int64		BytesWritten;				// bytes written by FFileWriter
+	uint64		Time[STATS_Count];			// exclusive time of each scope kind, in microseconds
+	int32		Count[STATS_Count];			// number of scopes of each kind
+
+	void Add(const CStatsCounters& Other);
+};
+
+extern bool GStatsEnabled;
+
+// Enable statistics collection, with writing the report to 'Filename' at exit
+void appEnableStats(const char* Filename);
+void appDumpStats();
+// Add the report written by appDumpStats() of another process (e.g. export shard) to the statistics
+bool appMergeStats(const char* Filename);
+
+// I/O hooks. Numbers are attributed to the innermost CStatsScope active on the calling thread.
+void appStatsAddIO(int64 BytesRead, int64 BytesDecompressed, int64 BytesWritten);
+
+FORCEINLINE void appStatsRead(int64 Size)
+{
+	if (GStatsEnabled) appStatsAddIO(Size, 0, 0);
+}
+
+FORCEINLINE void appStatsDecompressed(int64 Size)
+{
+	if (GStatsEnabled) appStatsAddIO(0, Size, 0);
+}
+
+FORCEINLINE void appStatsWritten(int64 Size)
+{
+	if (GStatsEnabled) appStatsAddIO(0, 0, Size);
+}
+
+// Measure the time of the code block. Time of nested scopes is excluded from the enclosing
+// one, so per-class and per-package numbers could be summed up.
+class CStatsScope
+{
+public:
+	CStatsScope(EStatsScope InKind, const char* InClassName, const char* InPackageName)
+	{
+		Kind = -1;
+		if (GStatsEnabled) Begin(InKind, InClassName, InPackageName);
+	}
+	// Implemented in UnObject.cpp
+	CStatsScope(EStatsScope InKind, const UObject* Obj);
+
+	~CStatsScope()
+	{
+		if (Kind >= 0) End();
+	}
+
+	CStatsCounters	Counters;
+
+protected:
+	void Begin(EStatsScope InKind, const char* InClassName, const char* InPackageName);
+	void End();
+
+	int				Kind;
+	uint64			StartTime;
+	uint64			ChildTime;
+	CStatsScope*	Parent;
+	const char*		ClassName;
+	char			PackageName[MAX_PACKAGE_PATH];
+};
+
 /*-----------------------------------------------------------------------------
 	Game directory support
 -----------------------------------------------------------------------------*/
@@ -104,7 +190,6 @@ public:
 protected:
 	uint32		Flags;								// set of GFI_... flags
 	uint8		ExtensionOffset;					// Extension = ShortName+ExtensionOffset, points after '.'
-	CGameFileInfo* HashNext;						// used for fast search; computed from ShortFilename excluding extension
 
 	const char*	ShortFilename;						// without path, points to filename part of RelativeName
 
@@ -126,6 +211,7 @@ public:
 	uint16		NumStaticMeshes;
 	uint16		NumAnimations;
 	uint16		NumTextures;
+	const struct CPackageExportSummary* ExportSummary; // object references, see PackageUtils.h
 
 	// Find/register stuff
 
@@ -157,6 +243,10 @@ public:
 	FString GetRelativeName() const;
 	// Get file name with extension but without path
 	void GetCleanName(FString& OutName) const;
+	const char* GetCleanName() const
+	{
+		return ShortFilename;
+	}
 	// Get path part of the name
 	const FString& GetPath() const
 	{
@@ -169,10 +259,9 @@ public:
 	// Update information about the file when it exists in multiple pak files (e.g. patched)
 	void UpdateFrom(const CGameFileInfo* other)
 	{
-		// Copy information from 'other' entry, but preserve hash chains
-		CGameFileInfo* saveHash = HashNext;
+		// Copy information from 'other' entry; hash table refers to the file by index, so
+		// nothing should be preserved
 		memcpy(this, other, sizeof(CGameFileInfo));
-		HashNext = saveHash;
 	}
 
 	FORCEINLINE bool IsPackage() const
@@ -194,6 +283,9 @@ private:
 extern int GNumPackageFiles;
 extern int GNumForeignFiles;
 
+// Print statistics for file system hash tables after scanning game directory
+extern bool GPrintHashDistribution;
+
 // Find folder in registered folders list. Returns -1 if not found.
 int appGetGameFolderIndex(const char* FolderName);
 
@@ -632,6 +724,8 @@ public:
 
 	virtual void Serialize(void *data, int size) = 0;
 	void ByteOrderSerialize(void *data, int size);
+	// Serialize block which could be larger than 2Gb
+	void Serialize64(void *data, int64 size);
 
 	// "Stopper" is used to check for overrun serialization.
 	// Note: there's no 64-bit "stopper" - large files are used only as containers for smaller
@@ -821,6 +915,8 @@ enum class EFileArchiveOptions
 	OpenWarning = 2,
 	// Open as a text file
 	TextFile = 4,
+	// FFileWriter: pass filled buffers to the background I/O thread when write-behind is enabled
+	WriteBehind = 8,
 };
 
 BITFIELD_ENUM(EFileArchiveOptions);
@@ -870,6 +966,25 @@ inline bool appFileExists(const char* filename)
 }
 
 
+// Maximal number of OS file handles kept open by FFileReader objects. FFileReader doesn't own
+// a file handle all the time: handles are stored in a global pool, closing the archive keeps
+// its handle cached, and the least recently used handle is closed when the pool is full. The
+// handle is reopened on the next read.
+extern int GMaxOpenFiles;
+
+struct CFileHandleStats
+{
+	int			Opens;							// number of real file open operations
+	int			Closes;							// number of real file close operations
+	int			Evictions;						// closes made to fit into GMaxOpenFiles limit
+	int			Reuses;							// FFileReader::Open() calls served by a cached handle
+	int			PeakOpen;						// maximal number of simultaneously open handles
+};
+
+void appGetFileHandleStats(CFileHandleStats& Stats);
+
+// Binary file reader. Reads are performed with positional OS functions (pread), so the same
+// file handle could be used from different threads with ReadAt().
 class FFileReader : public FFileArchive
 {
 	DECLARE_ARCHIVE(FFileReader, FFileArchive);
@@ -879,6 +994,8 @@ public:
 
 	virtual void Serialize(void *data, int size);
 	virtual bool Open();
+	virtual bool IsOpen() const;
+	virtual void Close();
 	virtual void Seek(int Pos);
 	virtual void Seek64(int64 Pos);
 	virtual int Tell() const;
@@ -886,14 +1003,42 @@ public:
 	virtual int64 GetFileSize64() const;
 	virtual bool IsEof() const;
 
+	// Read data at specified file position. Doesn't use or change archive's position and buffer,
+	// so it is safe to call it from different threads at the same time. Works for closed archive.
+	void ReadAt(int64 Pos, void* Data, int Size);
+
 protected:
 	int64		SeekPos;
 	int64		FileSize;
 	int			BufferBytesLeft;
 	int			LocalReadPos;
+	bool		bIsOpen;						// archive state, OS file handle could be closed when it is open
+
+	// File handle pool data
+	int			Handle;							// OS file descriptor, -1 when closed
+	int			NumActiveReads;					// the handle can't be closed by the pool when non-zero
+	FFileReader* PoolPrev;						// MRU list of objects with open handles
+	FFileReader* PoolNext;
+
+	friend struct CFileHandlePool;
+
+	int AcquireHandle();
+	void ReleaseHandle();
+	int ReadFromHandle(int64 Pos, void* Data, int Size, bool bExactSize);
 };
 
 
+// Size of FFileWriter's buffer. Larger buffers reduce number of write calls.
+extern int GFileWriteBufferSize;
+// Write-behind mode: FFileWriter opened with EFileArchiveOptions::WriteBehind doesn't write data
+// itself, but passes filled buffers to a dedicated I/O thread. This value limits the amount of
+// data queued for writing (in bytes), 0 disables write-behind.
+extern int GFileWriteBehindBudget;
+
+// Wait until all queued writes are completed and files are closed. Throws an error if any
+// write has failed.
+void appFlushFileWrites();
+
 class FFileWriter : public FFileArchive
 {
 	DECLARE_ARCHIVE(FFileWriter, FFileArchive);
@@ -916,8 +1061,11 @@ public:
 protected:
 	int64		FileSize;
 	int64		ArPos64;
+	int			BufferCapacity;
+	struct CWriteBehindFile* AsyncFile;	// not NULL when writing with I/O thread
 
 	void FlushBuffer();
+	void WriteToFile(int64 Pos, const void* Data, int Size);
 };
 
 
@@ -2599,9 +2747,9 @@ void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int Compressio
 struct FByteBulkData //?? separate FUntypedBulkData
 {
 	uint32	BulkDataFlags;				// BULKDATA_...
-	int32	ElementCount;				// number of array elements
+	int64	ElementCount;				// number of array elements; 32-bit in file, 64-bit in UE4.22+ with BULKDATA_Size64Bit
 	int64	BulkDataOffsetInFile;		// position in file, points to BulkData; 32-bit in UE3, 64-bit in UE4
-	int32	BulkDataSizeOnDisk;			// size of bulk data on disk
+	int64	BulkDataSizeOnDisk;			// size of bulk data on disk
 //	int		SavedBulkDataFlags;
 //	int		SavedElementCount;
 //	int		SavedBulkDataOffsetInFile;
@@ -2632,6 +2780,11 @@ struct FByteBulkData //?? separate FUntypedBulkData
 		return 1;
 	}
 
+	int64 GetBulkDataSize() const
+	{
+		return ElementCount * GetElementSize();
+	}
+
 	void ReleaseData()
 	{
 		if (BulkData) appFree(BulkData);
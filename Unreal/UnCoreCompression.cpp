@@ -340,6 +340,8 @@ int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *Uncompressed
 
 	guard(appDecompress);
 
+	appStatsDecompressed(UncompressedSize);
+
 #if GEARSU
 	if (GForceGame == GAME_GoWU)
 	{
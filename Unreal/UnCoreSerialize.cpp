@@ -10,7 +10,14 @@
 #include <errno.h>				// not needed for VC
 
 #if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>			// for ReadFile
 #include <io.h>					// for _filelengthi64
+#include <fcntl.h>
+#else
+#include <unistd.h>				// for pread
+#include <fcntl.h>
+#include <sys/stat.h>
 #endif
 
 #if THREADING
@@ -466,6 +473,24 @@ void FArchive::ByteOrderSerialize(void *data, int size)
 }
 
 
+void FArchive::Serialize64(void *data, int64 size)
+{
+	guard(FArchive::Serialize64);
+
+	// Serialize() has 32-bit size, split data into chunks
+	const int64 ChunkSize = 1 << 30;
+	while (size > 0)
+	{
+		int chunk = (int)min(size, ChunkSize);
+		Serialize(data, chunk);
+		data = OffsetPointer(data, chunk);
+		size -= chunk;
+	}
+
+	unguard;
+}
+
+
 void FArchive::Printf(const char *fmt, ...)
 {
 	va_list	argptr;
@@ -602,12 +627,176 @@ bool FFileArchive::OpenFile()
 	unguard;
 }
 
+/*-----------------------------------------------------------------------------
+	File handle pool for FFileReader
+-----------------------------------------------------------------------------*/
+
+int GMaxOpenFiles = 256;
+
+static int OsOpenFile(const char* Filename)
+{
+#if _WIN32
+	return _open(Filename, _O_RDONLY | _O_BINARY);
+#else
+	int Flags = O_RDONLY;
+	#ifdef O_CLOEXEC
+	Flags |= O_CLOEXEC;
+	#endif
+	return open(Filename, Flags);
+#endif
+}
+
+static void OsCloseFile(int Handle)
+{
+#if _WIN32
+	_close(Handle);
+#else
+	close(Handle);
+#endif
+}
+
+// Positional read, returns number of bytes read or -1 on error
+static int OsReadFile(int Handle, void* Data, int Size, int64 Pos)
+{
+#if _WIN32
+	OVERLAPPED Overlapped;
+	memset(&Overlapped, 0, sizeof(Overlapped));
+	Overlapped.Offset = (DWORD)Pos;
+	Overlapped.OffsetHigh = (DWORD)(Pos >> 32);
+	DWORD ReadBytes = 0;
+	if (!ReadFile((HANDLE)_get_osfhandle(Handle), Data, Size, &ReadBytes, &Overlapped))
+	{
+		return (GetLastError() == ERROR_HANDLE_EOF) ? 0 : -1;
+	}
+	return (int)ReadBytes;
+#else
+	int Done = 0;
+	while (Done < Size)
+	{
+		ssize_t Res = pread(Handle, (byte*)Data + Done, Size - Done, Pos + Done);
+		if (Res < 0)
+		{
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (Res == 0) break;		// end of file
+		Done += (int)Res;
+	}
+	return Done;
+#endif
+}
+
+static int64 OsGetFileSize(int Handle)
+{
+#if _WIN32
+	return _filelengthi64(Handle);
+#else
+	struct stat Info;
+	if (fstat(Handle, &Info) != 0) return -1;
+	return Info.st_size;
+#endif
+}
+
+struct CFileHandlePool
+{
+	FFileReader*		Head;			// most recently used
+	FFileReader*		Tail;
+	int					NumOpen;
+	CFileHandleStats	Stats;
+#if THREADING
+	CMutex				Mutex;
+#endif
+
+	void Unlink(FFileReader* File)
+	{
+		if (File->PoolPrev) File->PoolPrev->PoolNext = File->PoolNext; else Head = File->PoolNext;
+		if (File->PoolNext) File->PoolNext->PoolPrev = File->PoolPrev; else Tail = File->PoolPrev;
+		File->PoolPrev = File->PoolNext = NULL;
+	}
+
+	void LinkToHead(FFileReader* File)
+	{
+		File->PoolPrev = NULL;
+		File->PoolNext = Head;
+		if (Head) Head->PoolPrev = File; else Tail = File;
+		Head = File;
+	}
+
+	void Touch(FFileReader* File)
+	{
+		if (Head != File)
+		{
+			Unlink(File);
+			LinkToHead(File);
+		}
+	}
+
+	void CloseHandle(FFileReader* File)
+	{
+		Unlink(File);
+		OsCloseFile(File->Handle);
+		File->Handle = -1;
+		NumOpen--;
+		Stats.Closes++;
+	}
+
+	// Open the file handle, closing the least recently used handles when over the limit. Returns false on error.
+	bool OpenHandle(FFileReader* File)
+	{
+		FFileReader* Victim = Tail;
+		while (NumOpen >= GMaxOpenFiles && Victim)
+		{
+			// Files with reads in progress can't be closed. If all handles are busy, we'll exceed
+			// the limit rather than waiting.
+			FFileReader* Prev = Victim->PoolPrev;
+			if (Victim->NumActiveReads == 0)
+			{
+				CloseHandle(Victim);
+				Stats.Evictions++;
+			}
+			Victim = Prev;
+		}
+
+		File->Handle = OsOpenFile(File->FullName);
+		if (File->Handle < 0) return false;
+
+		LinkToHead(File);
+		NumOpen++;
+		Stats.Opens++;
+		if (NumOpen > Stats.PeakOpen) Stats.PeakOpen = NumOpen;
+		return true;
+	}
+};
+
+static CFileHandlePool GFilePool;
+
+#if THREADING
+#define FILE_POOL_LOCK		CMutex::ScopedLock PoolLock(GFilePool.Mutex)
+#else
+#define FILE_POOL_LOCK
+#endif
+
+void appGetFileHandleStats(CFileHandleStats& Stats)
+{
+	FILE_POOL_LOCK;
+	Stats = GFilePool.Stats;
+}
+
+/*-----------------------------------------------------------------------------
+	FFileReader
+-----------------------------------------------------------------------------*/
+
 FFileReader::FFileReader(const char *Filename, EFileArchiveOptions InOptions)
 :	FFileArchive(Filename, InOptions)
 ,	SeekPos(-1)
 ,	FileSize(-1)
 ,	BufferBytesLeft(0)
 ,	LocalReadPos(0)
+,	bIsOpen(false)
+,	Handle(-1)
+,	NumActiveReads(0)
+,	PoolPrev(NULL)
+,	PoolNext(NULL)
 {
 	guard(FFileReader::FFileReader);
 	IsLoading = true;
@@ -618,6 +807,126 @@ FFileReader::FFileReader(const char *Filename, EFileArchiveOptions InOptions)
 FFileReader::~FFileReader()
 {
 	Close();
+	FILE_POOL_LOCK;
+	assert(NumActiveReads == 0);
+	if (Handle >= 0)
+	{
+		GFilePool.CloseHandle(this);
+	}
+}
+
+bool FFileReader::Open()
+{
+	guard(FFileReader::Open);
+	assert(!bIsOpen);
+
+	bool bOpened;
+	{
+		FILE_POOL_LOCK;
+		if (Handle >= 0)
+		{
+			// The handle is still cached in the pool
+			GFilePool.Touch(this);
+			GFilePool.Stats.Reuses++;
+			bOpened = true;
+		}
+		else
+		{
+			bOpened = GFilePool.OpenHandle(this);
+		}
+	}
+
+	if (!bOpened)
+	{
+		// Failed to open the file
+		if (EnumHasAnyFlags(Options, EFileArchiveOptions::OpenWarning))
+		{
+			// Display an error message
+			appPrintf("WARNING: can't open file (%s) %s\n", strerror(errno), FullName);
+		}
+		else if (!EnumHasAnyFlags(Options, EFileArchiveOptions::NoOpenError))
+		{
+			// Throw fatal error
+			appError("Can't open file (%s) %s", strerror(errno), FullName);
+		}
+		return false;
+	}
+
+	bIsOpen = true;
+	Buffer = (byte*)appMallocNoInit(FILE_BUFFER_SIZE);
+	BufferPos = 0;
+	BufferSize = 0;
+	BufferBytesLeft = 0;
+	LocalReadPos = 0;
+	SeekPos = -1;
+	return true;
+
+	unguardf("%s", FullName);
+}
+
+bool FFileReader::IsOpen() const
+{
+	return bIsOpen;
+}
+
+void FFileReader::Close()
+{
+	// Keep the OS file handle in the pool, so the file could be reopened quickly
+	if (bIsOpen)
+	{
+		appFree(Buffer);
+		Buffer = NULL;
+		bIsOpen = false;
+	}
+}
+
+int FFileReader::AcquireHandle()
+{
+	FILE_POOL_LOCK;
+	if (Handle < 0)
+	{
+		// The handle was closed by the pool
+		if (!GFilePool.OpenHandle(this))
+			return -1;
+	}
+	else
+	{
+		GFilePool.Touch(this);
+	}
+	NumActiveReads++;
+	return Handle;
+}
+
+void FFileReader::ReleaseHandle()
+{
+	FILE_POOL_LOCK;
+	NumActiveReads--;
+}
+
+int FFileReader::ReadFromHandle(int64 Pos, void* Data, int Size, bool bExactSize)
+{
+	int OsHandle = AcquireHandle();
+	if (OsHandle < 0)
+		appError("Can't reopen file (%s) %s", strerror(errno), FullName);
+	int ReadBytes = OsReadFile(OsHandle, Data, Size, Pos);
+	ReleaseHandle();
+
+	if (ReadBytes < 0 || (bExactSize && ReadBytes != Size) || ReadBytes == 0)
+		appError("Unable to read %d bytes at pos=0x%llX", bExactSize ? Size : 1, Pos);
+#if PROFILE
+	GNumSerialize++;
+	GSerializeBytes += ReadBytes;
+#endif
+	appStatsRead(ReadBytes);
+	return ReadBytes;
+}
+
+void FFileReader::ReadAt(int64 Pos, void* Data, int Size)
+{
+	guard(FFileReader::ReadAt);
+	if (Size > 0)
+		ReadFromHandle(Pos, Data, Size, true);
+	unguardf("File=%s", ShortName);
 }
 
 void FFileReader::Serialize(void *data, int size)
@@ -661,36 +970,19 @@ void FFileReader::Serialize(void *data, int size)
 		}
 		else
 		{
-			// Buffer is empty
+			// Buffer is empty. Without pending seek, continue reading after the buffer.
+			int64 ReadPos = BufferPos + BufferSize;
 			if (SeekPos >= 0)
 			{
-				// Seek to desired position
-				if (SeekPos != FilePos)
-				{
-					if (fseeko64(f, SeekPos, SEEK_SET) != 0)
-						appError("Error seeking to position 0x%llX", SeekPos);
-					FilePos = SeekPos;
-				}
+				ReadPos = SeekPos;
 				SeekPos = -1;
 			}
-		#if MAX_DEBUG
-			int tell = ftell(f); // msvcrt.dll doesn't have ftelli64, ftell() returns -1 when position is larger than 4Gb
-			if (tell != -1 && tell != FilePos)
-				appError("Bad FilePos!");
-		#endif
 			if (size >= FILE_BUFFER_SIZE / 2)
 			{
 				// Large block, read directly to destination skipping buffer
-//				appPrintf("read2: %d+%d -> %d\n", (int)FilePos, size, (int)FilePos + size);
-				int res = fread(data, size, 1, f);
-				if (res != 1)
-					appError("Unable to read %d bytes at pos=0x%llX", size, FilePos);
-			#if PROFILE
-				GNumSerialize++;
-				GSerializeBytes += size;
-			#endif
-				FilePos += size;
-				BufferPos = FilePos;
+//				appPrintf("read2: %d+%d -> %d\n", (int)ReadPos, size, (int)ReadPos + size);
+				ReadFromHandle(ReadPos, data, size, true);
+				BufferPos = ReadPos + size;
 				// Invalidate buffer
 				BufferSize = 0;
 				BufferBytesLeft = 0;
@@ -698,17 +990,10 @@ void FFileReader::Serialize(void *data, int size)
 				return;
 			}
 			// Fill buffer
-			int ReadBytes = fread(Buffer, 1, FILE_BUFFER_SIZE, f);
-//			appPrintf("read: %d+%d -> %d\n", (int)FilePos, ReadBytes, (int)FilePos + ReadBytes);
-			if (ReadBytes == 0)
-				appError("Unable to read %d bytes at pos=0x%llX", 1, FilePos);
-		#if PROFILE
-			GNumSerialize++;
-			GSerializeBytes += ReadBytes;
-		#endif
-			BufferPos = FilePos;
+			int ReadBytes = ReadFromHandle(ReadPos, Buffer, FILE_BUFFER_SIZE, false);
+//			appPrintf("read: %d+%d -> %d\n", (int)ReadPos, ReadBytes, (int)ReadPos + ReadBytes);
+			BufferPos = ReadPos;
 			BufferSize = ReadBytes;
-			FilePos += ReadBytes;
 			BufferBytesLeft = ReadBytes;
 			LocalReadPos = 0;
 		}
@@ -717,11 +1002,6 @@ void FFileReader::Serialize(void *data, int size)
 	unguardf("File=%s", ShortName);
 }
 
-bool FFileReader::Open()
-{
-	return OpenFile();
-}
-
 void FFileReader::Seek(int Pos)
 {
 	Seek64(Pos);
@@ -738,7 +1018,7 @@ void FFileReader::Seek64(int64 Pos)
 		BufferSize = 0;
 		BufferBytesLeft = 0;
 		LocalReadPos = 0;
-		// SeekPos will be reset to -1 after actual seek
+		// SeekPos will be reset to -1 after actual read
 		BufferPos = SeekPos = Pos;
 	}
 	else
@@ -766,13 +1046,11 @@ int64 FFileReader::GetFileSize64() const
 	if (FileSize < 0)
 	{
 		FFileReader* _this = const_cast<FFileReader*>(this);
-#if _WIN32
-		_this->FileSize = _filelengthi64(fileno(f));
-#else
-		fseeko64(f, 0, SEEK_END);
-		_this->FileSize = ftello64(f);
-		fseeko64(f, 0, FilePos);
-#endif // _WIN32
+		int OsHandle = _this->AcquireHandle();
+		if (OsHandle < 0)
+			appError("Can't reopen file (%s) %s", strerror(errno), FullName);
+		_this->FileSize = OsGetFileSize(OsHandle);
+		_this->ReleaseHandle();
 	}
 	return FileSize;
 }
@@ -785,9 +1063,213 @@ bool FFileReader::IsEof() const
 		// skipping "\r" characters, so position may not match.
 		appError("FFileReader::IsEof is not suitable for text files (%s)", FullName);
 	}
-	return (BufferBytesLeft == 0) && (FilePos == GetFileSize64());
+	return Tell64() >= GetFileSize64();
+}
+
+/*-----------------------------------------------------------------------------
+	Write-behind I/O thread
+-----------------------------------------------------------------------------*/
+
+int GFileWriteBufferSize = FILE_BUFFER_SIZE;
+int GFileWriteBehindBudget = 0;
+
+#if THREADING
+
+// File state used by the I/O thread. Allocated when FFileWriter is opened, and released by the
+// I/O thread together with closing the file, so FFileWriter may be destroyed before data is written.
+struct CWriteBehindFile
+{
+	FILE*		f;
+	int64		FilePos;
+	bool		bFailed;
+	char		FileName[1];			// allocated together with the structure
+};
+
+struct CWriteRequest
+{
+	CWriteBehindFile* File;
+	CWriteRequest* Next;
+	byte*		Data;					// allocated with appMalloc and owned by the request; NULL for close request
+	int			Size;
+	int64		Pos;
+};
+
+namespace WriteBehind
+{
+
+static CMutex			Mutex;
+static CSemaphore		WorkSemaphore;			// signalled once for every queued request
+static CSemaphore		ProgressSemaphore;		// signalled for every waiting thread when a request is completed
+static int				NumWaiters = 0;			// number of threads waiting for ProgressSemaphore
+static CWriteRequest*	QueueHead = NULL;
+static CWriteRequest*	QueueTail = NULL;
+static int64			BytesInFlight = 0;
+static int				NumPendingRequests = 0;
+static bool				bThreadStarted = false;
+static char				ErrorMessage[1024];		// the first write error, reported by appFlushFileWrites()
+
+static void SetError(CWriteBehindFile* File, const char* Message, int Size, int64 Pos)
+{
+	File->bFailed = true;
+	CMutex::ScopedLock Lock(Mutex);
+	if (!ErrorMessage[0])
+		appSprintf(ARRAY_ARG(ErrorMessage), "%s %d bytes at pos=0x%llX (%s)", Message, Size, Pos, File->FileName);
+}
+
+static void ProcessRequest(CWriteRequest* Req)
+{
+	CWriteBehindFile* File = Req->File;
+	if (Req->Data)
+	{
+		if (!File->bFailed)
+		{
+			if (Req->Pos != File->FilePos && fseeko64(File->f, Req->Pos, SEEK_SET) != 0)
+				SetError(File, "Error seeking to write", Req->Size, Req->Pos);
+			else if (fwrite(Req->Data, Req->Size, 1, File->f) != 1)
+				SetError(File, "Unable to write", Req->Size, Req->Pos);
+			else
+				File->FilePos = Req->Pos + Req->Size;
+		}
+		appFree(Req->Data);
+	}
+	else
+	{
+		// Close request
+		if (fclose(File->f) != 0)
+			SetError(File, "Unable to write", 0, File->FilePos);
+		if (File->bFailed)
+		{
+			appPrintf("Deleting partially saved file %s\n", File->FileName);
+			remove(File->FileName);
+		}
+		appFree(File);
+	}
+}
+
+class CWriteBehindThread : public CThread
+{
+protected:
+	virtual void Run()
+	{
+		while (true)
+		{
+			WorkSemaphore.Wait();
+
+			CWriteRequest* Req;
+			{
+				CMutex::ScopedLock Lock(Mutex);
+				Req = QueueHead;
+				assert(Req);
+				QueueHead = Req->Next;
+				if (!QueueHead) QueueTail = NULL;
+			}
+
+			int Size = Req->Size;
+			ProcessRequest(Req);
+			delete Req;
+
+			CMutex::ScopedLock Lock(Mutex);
+			BytesInFlight -= Size;
+			NumPendingRequests--;
+			// Space in the queue was freed, wake up waiting threads so they'll check their conditions
+			for ( ; NumWaiters > 0; NumWaiters--)
+				ProgressSemaphore.Signal();
+		}
+	}
+};
+
+// Block until the I/O thread will complete a request. Should be called with locked Mutex, returns with
+// the Mutex locked too.
+static void WaitForProgress()
+{
+	NumWaiters++;
+	Mutex.Unlock();
+	ProgressSemaphore.Wait();
+	Mutex.Lock();
+}
+
+static void WaitForWrites()
+{
+	CMutex::ScopedLock Lock(Mutex);
+	while (NumPendingRequests != 0)
+		WaitForProgress();
+}
+
+static void FlushOnExit()
+{
+	WaitForWrites();
+	if (ErrorMessage[0])
+		appPrintf("ERROR: %s\n", ErrorMessage);
+}
+
+// Pass the request to the I/O thread. Blocks while the amount of queued data exceeds the budget.
+static void QueueRequest(CWriteBehindFile* File, int64 Pos, byte* Data, int Size)
+{
+	CWriteRequest* Req = new CWriteRequest;
+	Req->File = File;
+	Req->Next = NULL;
+	Req->Data = Data;
+	Req->Size = Size;
+	Req->Pos = Pos;
+
+	{
+		CMutex::ScopedLock Lock(Mutex);
+		if (!bThreadStarted)
+		{
+			CWriteBehindThread* Thread = new CWriteBehindThread;
+			Thread->Start();
+			bThreadStarted = true;
+			atexit(FlushOnExit);
+		}
+		// Always accept a request when the queue is empty, so a block larger than the budget could be written
+		while (NumPendingRequests != 0 && BytesInFlight + Size > GFileWriteBehindBudget)
+			WaitForProgress();
+		if (QueueTail)
+			QueueTail->Next = Req;
+		else
+			QueueHead = Req;
+		QueueTail = Req;
+		BytesInFlight += Size;
+		NumPendingRequests++;
+	}
+	WorkSemaphore.Signal();
 }
 
+static CWriteBehindFile* AllocFile(FILE* f, const char* FileName)
+{
+	int NameLen = strlen(FileName);
+	CWriteBehindFile* File = (CWriteBehindFile*)appMalloc(sizeof(CWriteBehindFile) + NameLen);
+	File->f = f;
+	File->FilePos = 0;
+	File->bFailed = false;
+	memcpy(File->FileName, FileName, NameLen + 1);
+	return File;
+}
+
+} // namespace WriteBehind
+
+#endif // THREADING
+
+void appFlushFileWrites()
+{
+	guard(appFlushFileWrites);
+#if THREADING
+	WriteBehind::WaitForWrites();
+	if (WriteBehind::ErrorMessage[0])
+	{
+		char Message[1024];
+		appStrncpyz(Message, WriteBehind::ErrorMessage, ARRAY_COUNT(Message));
+		WriteBehind::ErrorMessage[0] = 0;
+		appError("%s", Message);
+	}
+#endif
+	unguard;
+}
+
+/*-----------------------------------------------------------------------------
+	FFileWriter
+-----------------------------------------------------------------------------*/
+
 static TArray<FFileWriter*> GFileWriters;
 
 #if THREADING
@@ -798,6 +1280,8 @@ FFileWriter::FFileWriter(const char *Filename, EFileArchiveOptions InOptions)
 :	FFileArchive(Filename, InOptions)
 ,	FileSize(0)
 ,	ArPos64(0)
+,	BufferCapacity(max(GFileWriteBufferSize, FILE_BUFFER_SIZE))
+,	AsyncFile(NULL)
 {
 	guard(FFileWriter::FFileWriter);
 	IsLoading = false;
@@ -823,11 +1307,19 @@ void FFileWriter::CleanupOnError()
 #if THREADING
 	CMutex::ScopedLock Lock(GFileWritersMutex);
 #endif
+	TArray<FString> FileNames;
 	for (int i = GFileWriters.Num() - 1; i >= 0; i--)
 	{
 		FFileWriter* Writer = GFileWriters[i];
-		FString FileName(Writer->FullName);
+		FileNames.Add(Writer->FullName);
 		delete Writer;
+	}
+#if THREADING
+	// Files could be still written and closed by the I/O thread
+	WriteBehind::WaitForWrites();
+#endif
+	for (const FString& FileName : FileNames)
+	{
 		appPrintf("Deleting partially saved file %s\n", *FileName);
 #if MAX_DEBUG
 		char NewFileName[1024];
@@ -843,35 +1335,21 @@ void FFileWriter::Serialize(void *data, int size)
 {
 	guard(FFileWriter::Serialize);
 
-	assert(data);
+	// Empty arrays are written as (NULL, 0)
+	assert(data || !size);
 
 	while (size > 0)
 	{
-		int LocalPos64 = int(ArPos64 - BufferPos);
-		if (LocalPos64 < 0 || LocalPos64 >= FILE_BUFFER_SIZE || size >= FILE_BUFFER_SIZE)
+		int64 LocalPos64 = ArPos64 - BufferPos;
+		if (LocalPos64 < 0 || LocalPos64 >= BufferCapacity || size >= BufferCapacity)
 		{
 			// trying to write outside of buffer
 			FlushBuffer();
-			if (size >= FILE_BUFFER_SIZE)
+			if (size >= BufferCapacity)
 			{
 				// large block, write directly to file
-				if (ArPos64 != FilePos)
-				{
-					if (fseeko64(f, ArPos64, SEEK_SET) != 0)
-						appError("Error seeking to position 0x%llX", ArPos64);
-//					int ret = fseeko64(f, ArPos64, SEEK_SET);
-//					assert(ret == 0);
-					FilePos = ArPos64;
-				}
-				int res = fwrite(data, size, 1, f);
-				if (res != 1)
-					appError("Unable to write %d bytes at pos=0x%llX", size, ArPos64);
-			#if PROFILE
-				GNumSerialize++;
-				GSerializeBytes += size;
-			#endif
+				WriteToFile(ArPos64, data, size);
 				ArPos64 += size;
-				FilePos += size;
 				return;
 			}
 			BufferPos = ArPos64;
@@ -883,7 +1361,7 @@ void FFileWriter::Serialize(void *data, int size)
 		int LocalPos = (int)LocalPos64;
 
 		// have something for buffer
-		int CanCopy = FILE_BUFFER_SIZE - LocalPos;
+		int CanCopy = BufferCapacity - LocalPos;
 		if (CanCopy > size) CanCopy = size;
 		memcpy(Buffer + LocalPos, data, CanCopy);
 		data = OffsetPointer(data, CanCopy);
@@ -898,16 +1376,36 @@ void FFileWriter::Serialize(void *data, int size)
 bool FFileWriter::Open()
 {
 	assert(!IsOpen());
-	Buffer = (byte*)appMallocNoInit(FILE_BUFFER_SIZE);
-	BufferPos = 0;
-	BufferSize = 0;
 	ArPos64 = 0;
-	return OpenFile();
+	bool bOpened = OpenFile();
+	if (BufferCapacity != FILE_BUFFER_SIZE)
+	{
+		// OpenFile() allocates buffer of default size
+		appFree(Buffer);
+		Buffer = (byte*)appMallocNoInit(BufferCapacity);
+	}
+#if THREADING
+	if (bOpened && GFileWriteBehindBudget > 0 && EnumHasAnyFlags(Options, EFileArchiveOptions::WriteBehind))
+		AsyncFile = WriteBehind::AllocFile(f, FullName);
+#endif
+	return bOpened;
 }
 
 void FFileWriter::Close()
 {
 	FlushBuffer();
+#if THREADING
+	if (AsyncFile)
+	{
+		// The file will be closed by the I/O thread after writing all queued data
+		WriteBehind::QueueRequest(AsyncFile, FilePos, NULL, 0);
+		AsyncFile = NULL;
+		f = NULL;
+		appFree(Buffer);
+		Buffer = NULL;
+		return;
+	}
+#endif
 	Super::Close();
 }
 
@@ -915,25 +1413,59 @@ void FFileWriter::FlushBuffer()
 {
 	if (BufferSize > 0)
 	{
-		if (BufferPos != FilePos)
+#if THREADING
+		if (AsyncFile)
 		{
-			int ret = fseeko64(f, BufferPos, SEEK_SET);
-			assert(ret == 0);
-			FilePos = BufferPos;
-		}
-		int res = fwrite(Buffer, BufferSize, 1, f);
-		if (res != 1)
-			appError("Unable to write %d bytes at pos=0x%llX", BufferSize, ArPos64);
+			// Pass the buffer to the I/O thread and allocate a new one
+			WriteBehind::QueueRequest(AsyncFile, BufferPos, Buffer, BufferSize);
+			Buffer = (byte*)appMallocNoInit(BufferCapacity);
 #if PROFILE
-		GNumSerialize++;
-		GSerializeBytes += BufferSize;
+			GNumSerialize++;
+			GSerializeBytes += BufferSize;
+#endif
+			appStatsWritten(BufferSize);
+			FilePos = BufferPos + BufferSize;
+		}
+		else
 #endif
-		FilePos += BufferSize;
+		{
+			WriteToFile(BufferPos, Buffer, BufferSize);
+		}
 		BufferSize = 0;
 		if (FilePos > FileSize) FileSize = FilePos;
 	}
 }
 
+// Write data at specified position, or queue it for the I/O thread
+void FFileWriter::WriteToFile(int64 Pos, const void* Data, int Size)
+{
+#if THREADING
+	if (AsyncFile)
+	{
+		byte* Copy = (byte*)appMallocNoInit(Size);
+		memcpy(Copy, Data, Size);
+		WriteBehind::QueueRequest(AsyncFile, Pos, Copy, Size);
+	}
+	else
+#endif
+	{
+		if (Pos != FilePos)
+		{
+			if (fseeko64(f, Pos, SEEK_SET) != 0)
+				appError("Error seeking to position 0x%llX", Pos);
+		}
+		if (fwrite(Data, Size, 1, f) != 1)
+			appError("Unable to write %d bytes at pos=0x%llX", Size, Pos);
+	}
+#if PROFILE
+	GNumSerialize++;
+	GSerializeBytes += Size;
+#endif
+	appStatsWritten(Size);
+	FilePos = Pos + Size;
+	if (FilePos > FileSize) FileSize = FilePos;
+}
+
 void FFileWriter::Seek(int Pos)
 {
 	ArPos64 = Pos;
@@ -1177,12 +1709,22 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 		bIsUE4Data = true;
 
 		Ar << BulkDataFlags;
-		assert(!(BulkDataFlags & BULKDATA_Size64Bit));
-		Ar << ElementCount;
-		Ar << BulkDataSizeOnDisk;
+		if (BulkDataFlags & BULKDATA_Size64Bit)
+		{
+			Ar << ElementCount << BulkDataSizeOnDisk;
+		}
+		else
+		{
+			int32 ElementCount32, BulkDataSizeOnDisk32;
+			Ar << ElementCount32 << BulkDataSizeOnDisk32;
+			ElementCount = ElementCount32;
+			BulkDataSizeOnDisk = BulkDataSizeOnDisk32;
+		}
 		if (Ar.ArVer < VER_UE4_BULKDATA_AT_LARGE_OFFSETS)
 		{
-			Ar << (int&)BulkDataOffsetInFile;		// 32-bit
+			int32 BulkDataOffsetInFile32;
+			Ar << BulkDataOffsetInFile32;
+			BulkDataOffsetInFile = BulkDataOffsetInFile32;
 		}
 		else
 		{
@@ -1191,7 +1733,7 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 		UnPackage* Package = Ar.CastTo<UnPackage>();
 		assert(Package);
 	#if DEBUG_BULK
-		appPrintf("BulkHdrEndPos: %X, %d elements x %d bytes, Flags=%X, DataPos=pkg(%llX)+%llX, DiskSize=%X\n",
+		appPrintf("BulkHdrEndPos: %X, %lld elements x %d bytes, Flags=%X, DataPos=pkg(%llX)+%llX, DiskSize=%llX\n",
 			Ar.Tell(), ElementCount, GetElementSize(), BulkDataFlags, Package->Summary.BulkDataStartOffset, BulkDataOffsetInFile, BulkDataSizeOnDisk);
 	#endif
 		if (!(BulkDataFlags & BULKDATA_NoOffsetFixUp)) // UE4.26 flag
@@ -1212,11 +1754,11 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 		assert(Ar.IsLoading);
 
 		BulkDataFlags = 4;						// unknown
-		BulkDataSizeOnDisk = INDEX_NONE;
+		int32 BulkDataSizeOnDisk32 = INDEX_NONE;
 		int32 EndPosition;
 		Ar << EndPosition;
 		if (Ar.ArVer >= 254)
-			Ar << BulkDataSizeOnDisk;
+			Ar << BulkDataSizeOnDisk32;
 		if (Ar.ArVer >= 251)
 		{
 			int LazyLoaderFlags;
@@ -1230,9 +1772,9 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 			FName unk;
 			Ar << unk;
 		}
-		Ar << ElementCount;
-		if (BulkDataSizeOnDisk == INDEX_NONE)
-			BulkDataSizeOnDisk = ElementCount * GetElementSize();
+		int32 ElementCount32;
+		Ar << ElementCount32;
+		ElementCount = ElementCount32;
 		BulkDataOffsetInFile = Ar.Tell();
 		BulkDataSizeOnDisk   = EndPosition - (int)BulkDataOffsetInFile;
 		unguard;
@@ -1241,17 +1783,16 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 	{
 		// current bulk format
 		// read header
-		Ar << BulkDataFlags << ElementCount;
+		int32 tmpElementCount32, tmpBulkDataSizeOnDisk32, tmpBulkDataOffsetInFile32;
+		Ar << BulkDataFlags << tmpElementCount32;
+		ElementCount = tmpElementCount32;
 		assert(Ar.IsLoading);
-		int32 tmpBulkDataOffsetInFile32;
 
 #if MKVSDC
 		if (Ar.Game == GAME_MK && Ar.ArVer >= 677)
 		{
 			// MK X has 64-bit offset and size fields
-			int64 tmpBulkDataSizeOnDisk64;
-			Ar << tmpBulkDataSizeOnDisk64 << BulkDataOffsetInFile;
-			BulkDataSizeOnDisk = (int32)tmpBulkDataSizeOnDisk64;
+			Ar << BulkDataSizeOnDisk << BulkDataOffsetInFile;
 			goto header_done;
 		}
 #endif // MKVSDC
@@ -1259,14 +1800,16 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 		if (Ar.Game == GAME_Batman4 && Ar.ArLicenseeVer >= 153)
 		{
 			// 64-bit offset
-			Ar << BulkDataSizeOnDisk << BulkDataOffsetInFile;
+			Ar << tmpBulkDataSizeOnDisk32 << BulkDataOffsetInFile;
+			BulkDataSizeOnDisk = tmpBulkDataSizeOnDisk32;
 			goto header_done;
 		}
 #endif // BATMAN
 #if ROCKET_LEAGUE
 		if (Ar.Game == GAME_RocketLeague && Ar.ArLicenseeVer >= 20)
 		{
-			Ar << BulkDataSizeOnDisk;
+			Ar << tmpBulkDataSizeOnDisk32;
+			BulkDataSizeOnDisk = tmpBulkDataSizeOnDisk32;
 
 			// Offset only serialized with BULKDATA_StoreInSeparateFile
 			if (BulkDataFlags & BULKDATA_StoreInSeparateFile)
@@ -1291,7 +1834,8 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 		}
 #endif // ROCKET_LEAGUE
 
-		Ar << BulkDataSizeOnDisk << tmpBulkDataOffsetInFile32;
+		Ar << tmpBulkDataSizeOnDisk32 << tmpBulkDataOffsetInFile32;
+		BulkDataSizeOnDisk = tmpBulkDataSizeOnDisk32;
 		BulkDataOffsetInFile = tmpBulkDataOffsetInFile32;		// sign extend to allow non-standard TFC systems which uses '-1' in this field
 
 #if TRANSFORMERS
@@ -1321,7 +1865,7 @@ void FByteBulkData::SerializeHeader(FArchive &Ar)
 header_done: ;
 
 #if DEBUG_BULK
-	appPrintf("BulkHdrEndPos: %X, %d elements x %d bytes, Flags=%X, DataPos=%llX, DiskSize=%X\n",
+	appPrintf("BulkHdrEndPos: %X, %lld elements x %d bytes, Flags=%X, DataPos=%llX, DiskSize=%llX\n",
 		Ar.Tell(), ElementCount, GetElementSize(), BulkDataFlags, BulkDataOffsetInFile, BulkDataSizeOnDisk);
 #endif
 
@@ -1351,7 +1895,7 @@ void FByteBulkData::Serialize(FArchive &Ar)
 		if (BulkDataFlags & (BULKDATA_OptionalPayload|BULKDATA_PayloadInSeperateFile))
 		{
 #if DEBUG_BULK
-			appPrintf("data in %s file (flags=%X, pos=%llX+%X)\n",
+			appPrintf("data in %s file (flags=%X, pos=%llX+%llX)\n",
 				(BulkDataFlags & BULKDATA_OptionalPayload) ? ".uptnl" : ".ubulk",
 				BulkDataFlags, BulkDataOffsetInFile, BulkDataSizeOnDisk);
 #endif
@@ -1361,7 +1905,7 @@ void FByteBulkData::Serialize(FArchive &Ar)
 		{
 			if (BulkDataOffsetInFile + 16 >= Ar.GetFileSize64())
 			{
-				appPrintf("FByteBulkData::Serialize: position is outside of the file (%d bytes)\n", BulkDataSizeOnDisk);
+				appPrintf("FByteBulkData::Serialize: position is outside of the file (%lld bytes)\n", BulkDataSizeOnDisk);
 				// Prevent any possible use of this bulk
 				BulkDataFlags |= BULKDATA_Unused;
 				return;
@@ -1393,7 +1937,7 @@ void FByteBulkData::Serialize(FArchive &Ar)
 	{
 		// stored in a different file (TFC)
 #if DEBUG_BULK
-		appPrintf("bulk in separate file (flags=%X, pos=%llX+%X)\n", BulkDataFlags, BulkDataOffsetInFile, BulkDataSizeOnDisk);
+		appPrintf("bulk in separate file (flags=%X, pos=%llX+%llX)\n", BulkDataFlags, BulkDataOffsetInFile, BulkDataSizeOnDisk);
 #endif
 		return;
 	}
@@ -1528,6 +2072,14 @@ void FByteBulkData::SerializeData(FArchive &Ar)
 	unguard;
 }
 
+static void ReadCompressedBulk(FArchive &Ar, byte *Buffer, int64 Size, int CompressionFlags)
+{
+	// Compressed chunks are using 32-bit sizes
+	if (Size >= (1LL << 31))
+		appError("Compressed bulk data is too large: %lld bytes", Size);
+	appReadCompressedChunk(Ar, Buffer, (int)Size, CompressionFlags);
+}
+
 void FByteBulkData::SerializeDataChunk(FArchive &Ar)
 {
 	guard(FByteBulkData::SerializeDataChunk);
@@ -1535,7 +2087,7 @@ void FByteBulkData::SerializeDataChunk(FArchive &Ar)
 	// allocate array
 	if (BulkData) appFree(BulkData);
 	BulkData = NULL;
-	int DataSize = ElementCount * GetElementSize();
+	int64 DataSize = GetBulkDataSize();
 	if (!DataSize) return;		// nothing to serialize
 	BulkData = (byte*)appMallocNoInit(DataSize);
 
@@ -1546,24 +2098,24 @@ void FByteBulkData::SerializeDataChunk(FArchive &Ar)
 		if (BulkDataFlags & BULKDATA_CompressedZlib) flags = COMPRESS_ZLIB;
 		if (BulkDataFlags & BULKDATA_CompressedLzo)  flags = COMPRESS_LZO;
 		if (BulkDataFlags & BULKDATA_CompressedLzx)  flags = COMPRESS_LZX;
-		appReadCompressedChunk(Ar, BulkData, DataSize, flags);
+		ReadCompressedBulk(Ar, BulkData, DataSize, flags);
 	}
 #if BLADENSOUL
 	else if (Ar.Game == GAME_BladeNSoul && (BulkDataFlags & BULKDATA_CompressedLzoEncr))
 	{
-		appReadCompressedChunk(Ar, BulkData, DataSize, COMPRESS_LZO_ENC_BNS);
+		ReadCompressedBulk(Ar, BulkData, DataSize, COMPRESS_LZO_ENC_BNS);
 	}
 #endif
 #if MASSEFF
 	else if (Ar.Game == GAME_MassEffectLE && (BulkDataFlags & 0x1000))
 	{
-		appReadCompressedChunk(Ar, BulkData, DataSize, COMPRESS_OODLE);
+		ReadCompressedBulk(Ar, BulkData, DataSize, COMPRESS_OODLE);
 	}
 #endif
 	else
 	{
 		// uncompressed block
-		Ar.Serialize(BulkData, DataSize);
+		Ar.Serialize64(BulkData, DataSize);
 	}
 
 	unguard;
@@ -1612,7 +2164,7 @@ bool FByteBulkData::SerializeData(const UObject* MainObj) const
 	FArchive *Ar = bulkFile->CreateReader();
 	Ar->SetupFrom(*Package);
 #if DEBUG_BULK
-	appPrintf("%s: Bulk %X %llX [%d] f=%X (%s)\n", MainObj->Name, this, this->BulkDataOffsetInFile, this->ElementCount, this->BulkDataFlags, bulkFileName);
+	appPrintf("%s: Bulk %X %llX [%lld] f=%X (%s)\n", MainObj->Name, this, this->BulkDataOffsetInFile, this->ElementCount, this->BulkDataFlags, bulkFileName);
 #endif
 	const_cast<FByteBulkData*>(this)->SerializeData(*Ar);
 	delete Ar;
@@ -153,6 +153,32 @@ TArray<UObject*> UObject::GObjLoaded;
 TArray<UObject*> UObject::GObjObjects;
 UObject         *UObject::GLoadingObj = NULL;
 
+bool GUseObjectArena = false;
+static CMemoryArena* GObjectArena = NULL;
+
+static CMemoryArena* GetObjectArena()
+{
+	if (!GUseObjectArena) return NULL;
+	if (!GObjectArena) GObjectArena = new CMemoryArena("objects");
+	return GObjectArena;
+}
+
+void ReleaseObjectArena()
+{
+	if (!GObjectArena) return;
+	GObjectArena->PrintStats();
+	GObjectArena->Release();
+	GObjectArena = NULL;
+}
+
+
+CStatsScope::CStatsScope(EStatsScope InKind, const UObject* Obj)
+{
+	Kind = -1;
+	if (GStatsEnabled)
+		Begin(InKind, Obj->GetClassName(), Obj->Package ? *Obj->Package->GetFilename() : NULL);
+}
+
 
 void UObject::BeginLoad()
 {
@@ -197,9 +223,12 @@ void UObject::EndLoad()
 #if PROFILE_LOADING
 			appResetProfiler();
 #endif
-			GLoadingObj = Obj;
-			Obj->Serialize(*Package);
-			GLoadingObj = NULL;
+			{
+				CStatsScope Stats(STATS_Load, Obj);
+				GLoadingObj = Obj;
+				Obj->Serialize(*Package);
+				GLoadingObj = NULL;
+			}
 #if PROFILE_LOADING
 			appPrintProfiler();
 #endif
@@ -225,6 +254,7 @@ void UObject::EndLoad()
 		for (UObject* Obj : LoadedObjects)
 		{
 			guard(PostLoad);
+			CStatsScope Stats(STATS_PostLoad, Obj);
 			Obj->PostLoad();
 			unguardf("%s", Obj->Name);
 		}
@@ -1038,7 +1068,9 @@ void CTypeInfo::ReadUnrealProperty(FArchive& Ar, FPropertyTag& Tag, void* Object
 
 	int StopPos = Ar.Tell() + Tag.DataSize;	// for verification
 
-	const CPropInfo *Prop = FindProperty(Tag.Name);
+	// Tag names are stored in the string pool, so use cached lookup
+	const CTypeInfo* PropStructType;
+	const CPropInfo *Prop = FindPropertyCached(Tag.Name.Str, &PropStructType);
 	if (!Prop || Prop->Count == 0)	// Prop->Count==0 when declared with PROP_DROP() macro
 	{
 		if (!Prop)
@@ -1211,7 +1243,7 @@ void CTypeInfo::ReadUnrealProperty(FArchive& Ar, FPropertyTag& Tag, void* Object
 
 				// Find data typeinfo
 				//!! note: some structures should be serialized using SerializeStruc() (FVector etc)
-				const CTypeInfo *ItemType = FindStructType(Prop->TypeName);
+				const CTypeInfo *ItemType = PropStructType;
 				if (!ItemType)
 				{
 					appPrintf("WARNING: structure type %s is unknown, skipping array %s::%s\n", Prop->TypeName, Name, Prop->Name);
@@ -1724,8 +1756,10 @@ void CTypeInfo::SerializeUnversionedProperties4(FArchive& Ar, void* ObjectData)
 	#if DEBUG_PROPS
 		appPrintf("Prop: %d (zeroed=%d)\n", PropIndex, bIsZeroedProp);
 	#endif
-		int ArrayIndex = 0;
-		const char* PropName = FindUnversionedProp(PropIndex, ArrayIndex, Ar.Game);
+		CUnversionedPropInfo PropInfo;
+		FindUnversionedPropCached(PropIndex, Ar.Game, PropInfo);
+		int ArrayIndex = PropInfo.ArrayIndex;
+		const char* PropName = PropInfo.Name;
 	#if DEBUG_PROPS
 		DUMP_ARC_BYTES(Ar, 32, "-> ...");
 	#endif
@@ -1753,23 +1787,11 @@ void CTypeInfo::SerializeUnversionedProperties4(FArchive& Ar, void* ObjectData)
 			appPrintf("  dropping %s\n", PropName + 1);
 		#endif
 			// Special marker, skipping property of known size
-			if (!strcmp(PropName, "#int8"))
-			{
-				Ar.Seek(Ar.Tell() + 1);
-			}
-			else if (!strcmp(PropName, "#int64"))
+			if (PropInfo.SkipSize > 0)
 			{
-				Ar.Seek(Ar.Tell() + 8);
+				Ar.Seek(Ar.Tell() + PropInfo.SkipSize);
 			}
-			else if (!strcmp(PropName, "#vec3"))
-			{
-				Ar.Seek(Ar.Tell() + 12);
-			}
-			else if (!strcmp(PropName, "#vec4"))
-			{
-				Ar.Seek(Ar.Tell() + 16);
-			}
-			else if (!strcmp(PropName, "#arr_int32"))
+			else if (PropInfo.SkipSize == UNVERSIONED_SKIP_INT32_ARRAY)
 			{
 				int32 Len;
 				Ar << Len;
@@ -1783,7 +1805,7 @@ void CTypeInfo::SerializeUnversionedProperties4(FArchive& Ar, void* ObjectData)
 			continue;
 		}
 
-		const CPropInfo* Prop = FindProperty(PropName);
+		const CPropInfo* Prop = PropInfo.Prop;
 		if (!Prop) appError("Property not found: %s\n", PropName);
 
 		byte* value = (byte*)ObjectData + Prop->Offset; // used in PROP macro
@@ -1992,7 +2014,12 @@ UObject *CreateClass(const char *Name)
 	const CTypeInfo *Type = FindClassType(Name);
 	if (!Type) return NULL;
 
-	UObject *Obj = (UObject*)appMalloc(Type->SizeOf);
+	// Objects are allocated in the arena when it is enabled, they're freed with ReleaseAllObjects()
+	UObject *Obj;
+	if (CMemoryArena* Arena = GetObjectArena())
+		Obj = (UObject*)Arena->Alloc(Type->SizeOf, 8, false);
+	else
+		Obj = (UObject*)appMalloc(Type->SizeOf);
 	assert(Type->Constructor);
 	Type->Constructor(Obj);
 	// NOTE: do not add object to GObjObjects in UObject constructor
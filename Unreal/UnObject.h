@@ -65,6 +65,14 @@ public:
 	{
 	}
 
+	// Function which collects data affecting the exported files of the object, used for export deduplication:
+	// objects of the same class with the same content key are exported once, other copies are linked to these
+	// files. Returns false when not supported by the class.
+	virtual bool GetContentKey(FArchive& Ar) const
+	{
+		return false;
+	}
+
 	static const uint32 LocalTypeFlags = TYPE_None;
 
 	// Empty property table
@@ -117,4 +125,10 @@ void RegisterCoreClasses();
 // false, serialization function will not be called.
 extern bool (*GBeforeLoadObjectCallback)(UObject*);
 
+// When enabled, loaded objects are allocated in a memory arena, which is released at once after
+// all objects are destroyed with ReleaseAllObjects().
+extern bool GUseObjectArena;
+
+void ReleaseObjectArena();
+
 #endif // __UNOBJECT_H__
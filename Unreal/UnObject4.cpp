@@ -1,6 +1,7 @@
 #include "Core.h"
 #include "UnCore.h"
 #include "UnObject.h"
+#include "HashIndex.h"
 
 #if UNREAL4
 
@@ -490,4 +491,112 @@ const char* CTypeInfo::FindUnversionedProp(int InPropIndex, int& OutArrayIndex,
 	unguard;
 }
 
+/*-----------------------------------------------------------------------------
+	Cached unversioned property schemas
+-----------------------------------------------------------------------------*/
+
+// Property index to CPropInfo mapping for a single type and game. Entries are resolved on first
+// use of the property index, so errors for bad property indices appear at the same moment as
+// without caching.
+struct CUnversionedSchema
+{
+	const CTypeInfo*	Type;
+	int					Game;
+	TArray<CUnversionedPropInfo> Props;
+};
+
+// Objects are serialized from the main thread only (UObject::BeginLoad/EndLoad aren't thread-safe),
+// so these tables are not locked.
+static TArray<CUnversionedSchema*> GUnversionedSchemas;
+static CHashIndex GUnversionedSchemaHash;
+
+// Most often the same type is used several times in a row
+static CUnversionedSchema* LastSchema = NULL;
+
+void ReleaseUnversionedSchemas()
+{
+	for (CUnversionedSchema* Schema : GUnversionedSchemas)
+	{
+		delete Schema;
+	}
+	GUnversionedSchemas.Empty();
+	GUnversionedSchemaHash.Empty();
+	LastSchema = NULL;
+}
+
+static CUnversionedSchema* FindUnversionedSchema(const CTypeInfo* Type, int Game)
+{
+	if (LastSchema && LastSchema->Type == Type && LastSchema->Game == Game)
+		return LastSchema;
+
+	uint64 Hash = (uint64)(size_t)Type ^ ((uint64)Game * 0x9E3779B97F4A7C15ULL);
+	Hash ^= Hash >> 33;
+	Hash *= 0xFF51AFD7ED558CCDULL;
+	Hash ^= Hash >> 33;
+
+	CUnversionedSchema* Schema = NULL;
+	for (CHashIndex::CIterator It(GUnversionedSchemaHash, Hash); It; ++It)
+	{
+		CUnversionedSchema* S = GUnversionedSchemas[*It];
+		if (S->Type == Type && S->Game == Game)
+		{
+			Schema = S;
+			break;
+		}
+	}
+	if (!Schema)
+	{
+		Schema = new CUnversionedSchema;
+		Schema->Type = Type;
+		Schema->Game = Game;
+		GUnversionedSchemaHash.Add(Hash, GUnversionedSchemas.Add(Schema));
+	}
+	LastSchema = Schema;
+	return Schema;
+}
+
+static int GetUnversionedMarkerSize(const char* Marker)
+{
+	if (!strcmp(Marker, "#int8"))
+		return 1;
+	else if (!strcmp(Marker, "#int64"))
+		return 8;
+	else if (!strcmp(Marker, "#vec3"))
+		return 12;
+	else if (!strcmp(Marker, "#vec4"))
+		return 16;
+	else if (!strcmp(Marker, "#arr_int32"))
+		return UNVERSIONED_SKIP_INT32_ARRAY;
+	return UNVERSIONED_SKIP_UNKNOWN;
+}
+
+void CTypeInfo::FindUnversionedPropCached(int InPropIndex, int InGame, CUnversionedPropInfo& OutInfo) const
+{
+	guard(CTypeInfo::FindUnversionedPropCached);
+
+	CUnversionedSchema* Schema = FindUnversionedSchema(this, InGame);
+	if (InPropIndex >= Schema->Props.Num())
+	{
+		Schema->Props.AddZeroed(InPropIndex + 1 - Schema->Props.Num());
+	}
+
+	CUnversionedPropInfo& Info = Schema->Props[InPropIndex];
+	if (!Info.bResolved)
+	{
+		Info.Name = FindUnversionedProp(InPropIndex, Info.ArrayIndex, InGame);
+		if (Info.Name)
+		{
+			if (Info.Name[0] == '#')
+				Info.SkipSize = GetUnversionedMarkerSize(Info.Name);
+			else
+				Info.Prop = FindProperty(Info.Name);
+		}
+		Info.bResolved = true;
+	}
+	// Return a copy: nested structures could grow Props array while this property is processed
+	OutInfo = Info;
+
+	unguardf("%s[%d]", Name, InPropIndex);
+}
+
 #endif // UNREAL4
@@ -300,7 +300,7 @@ static bool UploadTex(UUnrealMaterial* Tex, GLenum target, CTextureData& TexData
 #endif // DEBUG_MIPS
 
 			assert(pic);
-			DBG("   mip %d x %d (%X)", Mip.USize, Mip.VSize, Mip.DataSize);
+			DBG("   mip %d x %d (%llX)", Mip.USize, Mip.VSize, Mip.DataSize);
 			glTexImage2D(target, mipLevel, format, Mip.USize, Mip.VSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, pic);
 			delete pic;
 		}
@@ -453,7 +453,7 @@ static bool UploadCompressedTex(UUnrealMaterial* Tex, GLenum target, GLenum targ
 	if (!doMipmap)
 	{
 		// no mipmaps required
-		DBG("up (%s, %d no-mips): %d %d (%d) (%s) (0x%X)", Tex->Name, TexData.Mips.Num(), Mip0.USize, Mip0.VSize, TexData.Mips.Num(), TexData.OriginalFormatName, Mip0.DataSize);
+		DBG("up (%s, %d no-mips): %d %d (%d) (%s) (0x%llX)", Tex->Name, TexData.Mips.Num(), Mip0.USize, Mip0.VSize, TexData.Mips.Num(), TexData.OriginalFormatName, Mip0.DataSize);
 		glCompressedTexImage2D(target, 0, format, Mip0.USize, Mip0.VSize, 0, dataSize, dataPtr);
 		glTexParameteri(target2, GL_TEXTURE_MAX_LEVEL, 0);	// GL 1.2
 	}
@@ -461,7 +461,7 @@ static bool UploadCompressedTex(UUnrealMaterial* Tex, GLenum target, GLenum targ
 	{
 		guard(UploadMips);
 		// has mipmaps
-		DBG("up (%s, %d mips): %d %d (%d) (%s) (0x%X)", Tex->Name, TexData.Mips.Num(), Mip0.USize, Mip0.VSize, TexData.Mips.Num(), TexData.OriginalFormatName, Mip0.DataSize);
+		DBG("up (%s, %d mips): %d %d (%d) (%s) (0x%llX)", Tex->Name, TexData.Mips.Num(), Mip0.USize, Mip0.VSize, TexData.Mips.Num(), TexData.OriginalFormatName, Mip0.DataSize);
 		glTexParameteri(target2, GL_TEXTURE_MAX_LEVEL, TexData.Mips.Num() - 1);
 		for (int mipLevel = 0; mipLevel < TexData.Mips.Num(); mipLevel++)
 		{
@@ -477,7 +477,7 @@ static bool UploadCompressedTex(UUnrealMaterial* Tex, GLenum target, GLenum targ
 			// Upload
 			glCompressedTexImage2D(target, mipLevel, format, Mip.USize, Mip.VSize, 0, dataSize, dataPtr);
 			GLenum error = glGetError();
-			DBG("   mip %d x %d (%X)", Mip.USize, Mip.VSize, Mip.DataSize);
+			DBG("   mip %d x %d (%llX)", Mip.USize, Mip.VSize, Mip.DataSize);
 			if (error != 0)
 			{
 				appPrintf("Failed to upload mip %d of texture %s in format 0x%04X: error 0x%X\n", mipLevel, Tex->Name, format, error);
@@ -486,7 +486,7 @@ static bool UploadCompressedTex(UUnrealMaterial* Tex, GLenum target, GLenum targ
 					// Recover from error: when failed to upload lower mip levels, make it still working with previous mips
 					glTexParameteri(target2, GL_TEXTURE_MAX_LEVEL, mipLevel - 1);	// GL 1.2
 				}
-				DBG("%d x %d (%X)", Mip.USize, Mip.VSize, Mip.DataSize);
+				DBG("%d x %d (%llX)", Mip.USize, Mip.VSize, Mip.DataSize);
 				break;
 			}
 		}
@@ -495,7 +495,7 @@ static bool UploadCompressedTex(UUnrealMaterial* Tex, GLenum target, GLenum targ
 	else if (GL_SUPPORT(QGL_EXT_FRAMEBUFFER_OBJECT))
 	{
 		// code below generates mipmaps using GL 3.0 or GL_EXT_framebuffer_object
-		DBG("up+build_mips (%s): %d %d (%d) (%s) (%d)", Tex->Name, Mip0.USize, Mip0.VSize, TexData.Mips.Num(), TexData.OriginalFormatName, Mip0.DataSize);
+		DBG("up+build_mips (%s): %d %d (%d) (%s) (%lld)", Tex->Name, Mip0.USize, Mip0.VSize, TexData.Mips.Num(), TexData.OriginalFormatName, Mip0.DataSize);
 		glCompressedTexImage2D(target, 0, format, Mip0.USize, Mip0.VSize, 0, dataSize, dataPtr);
 		if (target2 != GL_TEXTURE_CUBE_MAP_ARB)
 		{
@@ -81,7 +81,7 @@ public:
 		}
 
 #if 0
-		appPrintf("Sound: raw(%d) pc(%d) xbox(%d) ps3(%d)\n",
+		appPrintf("Sound: raw(%lld) pc(%lld) xbox(%lld) ps3(%lld)\n",
 			RawData.ElementCount,
 			CompressedPCData.ElementCount,
 			CompressedXbox360Data.ElementCount,
@@ -107,7 +107,7 @@ struct FSoundFormatData // FFormatContainer item representation
 	{
 		Ar << D.FormatName;
 		D.Data.Serialize(Ar);
-		appPrintf("Sound: Format=%s Data=%d\n", *D.FormatName, D.Data.ElementCount);
+		appPrintf("Sound: Format=%s Data=%lld\n", *D.FormatName, D.Data.ElementCount);
 		return Ar;
 	}
 };
@@ -183,7 +183,7 @@ extern const CPixelFormatInfo PixelFormatInfo[];	// index in array is TPF_... co
 struct CMipMap
 {
 	const byte*				CompressedData;			// not TArray because we could just point to another data block without memory reallocation
-	int						DataSize;				// this information is used for exporting compressed texture
+	int64					DataSize;				// this information is used for exporting compressed texture
 	int						USize;
 	int						VSize;
 	bool					ShouldFreeData;			// free CompressedData when set to true
@@ -196,7 +196,7 @@ struct CMipMap
 	{
 		ReleaseData();
 	}
-	void SetOwnedDataBuffer(const byte* buf, int size)
+	void SetOwnedDataBuffer(const byte* buf, int64 size)
 	{
 		// Release old data if any
 		ReleaseData();
@@ -211,7 +211,7 @@ struct CMipMap
 		// Release old data if any
 		ReleaseData();
 		CompressedData = Bulk.BulkData;
-		DataSize = Bulk.ElementCount * Bulk.GetElementSize();
+		DataSize = Bulk.GetBulkDataSize();
 		if (!GExportInProgress)
 		{
 			// Bulk owns data buffer
@@ -491,6 +491,7 @@ public:
 #endif
 
 	virtual void GetMetadata(FArchive& Ar) const;
+	virtual bool GetContentKey(FArchive& Ar) const;
 
 	const TArray<FTexture2DMipMap>* GetMipmapArray() const;
 
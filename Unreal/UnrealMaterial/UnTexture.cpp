@@ -118,7 +118,7 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 	}
 
 	int pixelSize = PixelFormatInfo[Format].Float ? 16 : 4;
-	int size = USize * VSize * pixelSize;
+	size_t size = (size_t)USize * VSize * pixelSize;
 	byte* dst = (byte*)appMallocNoInit(size);
 
 #if 0
@@ -181,7 +181,7 @@ byte* CTextureData::Decompress(int MipLevel, int Slice)
 		return dst;
 	case TPF_RGBA8:
 		{
-			memcpy(dst, Data, USize * VSize * 4);
+			memcpy(dst, Data, (size_t)USize * VSize * 4);
 		}
 		return dst;
 	case TPF_FLOAT_RGBA:
@@ -638,7 +638,7 @@ bool CTextureData::DecodeXBox360(int MipLevel)
 		for (int i = 0; i < Mips.Num(); i++)
 		{
 			const CMipMap& Mip = Mips[i];
-			appPrintf("%d: %d x %d, 0x%X bytes\n", i, Mip.USize, Mip.VSize, Mip.DataSize);
+			appPrintf("%d: %d x %d, 0x%llX bytes\n", i, Mip.USize, Mip.VSize, Mip.DataSize);
 		}
 	}
 #endif // DEBUG_PLATFORM_TEX
@@ -669,7 +669,7 @@ bool CTextureData::DecodeXBox360(int MipLevel)
 
 	float bpp = (float)Mip.DataSize / (USize1 * VSize1) * Info.BlockSizeX * Info.BlockSizeY;	// used for validation only
 #if DEBUG_PLATFORM_TEX
-	appPrintf("DecodeXBox360: %s'%s': %d x %d (%d x %d aligned), %s, %d bpp (format), %g bpp (real), %d bytes\n", Obj->GetClassName(), Obj->Name,
+	appPrintf("DecodeXBox360: %s'%s': %d x %d (%d x %d aligned), %s, %d bpp (format), %g bpp (real), %lld bytes\n", Obj->GetClassName(), Obj->Name,
 		Mip.USize, Mip.VSize, USize1, VSize1, OriginalFormatName, Info.BytesPerBlock, bpp, Mip.DataSize);
 #endif
 
@@ -817,7 +817,7 @@ bool CTextureData::DecodePS4(int MipLevel)
 
 #if DEBUG_PLATFORM_TEX
 	float bpp = (float)Mip.DataSize / (Mip.USize * Mip.VSize) * Info.BlockSizeX * Info.BlockSizeY;	// used for validation only
-	appPrintf("DecodePS4: %s'%s': %d x %d, %s, %d bpp (format), %g bpp (real), %d bytes\n", Obj->GetClassName(), Obj->Name,
+	appPrintf("DecodePS4: %s'%s': %d x %d, %s, %d bpp (format), %g bpp (real), %lld bytes\n", Obj->GetClassName(), Obj->Name,
 		Mip.USize, Mip.VSize, OriginalFormatName, Info.BytesPerBlock, bpp, Mip.DataSize);
 #endif
 
@@ -991,7 +991,7 @@ bool CTextureData::DecodeNSW(int MipLevel)
 
 #if DEBUG_PLATFORM_TEX
 	float bpp = (float)Mip.DataSize / (Mip.USize * Mip.VSize) * Info.BlockSizeX * Info.BlockSizeY;	// used for validation only
-	appPrintf("DecodeNSW: %s'%s': %d x %d, %s, %d bpp (format), %g bpp (real), %d bytes\n", Obj->GetClassName(), Obj->Name,
+	appPrintf("DecodeNSW: %s'%s': %d x %d, %s, %d bpp (format), %g bpp (real), %lld bytes\n", Obj->GetClassName(), Obj->Name,
 		Mip.USize, Mip.VSize, OriginalFormatName, Info.BytesPerBlock, bpp, Mip.DataSize);
 #endif
 
@@ -1135,6 +1135,69 @@ void UTexture2D::GetMetadata(FArchive& Ar) const
 	unguard;
 }
 
+bool UTexture2D::GetContentKey(FArchive& Ar) const
+{
+	guard(UTexture2D::GetContentKey);
+
+#if UNREAL4
+	// Cubemap faces are exported to separate files, not supported
+	if (IsA("TextureCube4")) return false;
+#endif
+
+	const TArray<FTexture2DMipMap>* MipsArray = GetMipmapArray();
+	int NumMips = MipsArray->Num();
+	int PixelFormat = Format;
+	Ar << PixelFormat << NumMips;
+
+	int NumMipsWithData = 0;
+
+	for (int MipLevel = 0; MipLevel < NumMips; MipLevel++)
+	{
+		const FTexture2DMipMap &Mip = (*MipsArray)[MipLevel];
+		const FByteBulkData &Bulk = Mip.Data;
+		int MipSizeX = Mip.SizeX;
+		int MipSizeY = Mip.SizeY;
+		uint32 Flags = Bulk.BulkDataFlags;
+		int64 ElementCount = Bulk.ElementCount;
+		Ar << MipSizeX << MipSizeY << Flags << ElementCount;
+#if UNREAL4
+		if (!Bulk.BulkData && Bulk.bIsUE4Data && Bulk.CanReloadBulk() && !(Flags & BULKDATA_Unused))
+		{
+			// UE4 bulk file belongs to the package, so its location won't match for the same data stored
+			// in different packages. Load the data, export will use it as well.
+			Bulk.SerializeData(this);
+		}
+#endif
+		if (Bulk.BulkData)
+		{
+			// Hash data before decompression
+			Ar.Serialize(Bulk.BulkData, (int)Bulk.GetBulkDataSize());
+			NumMipsWithData++;
+		}
+#if UNREAL4
+		else if (Bulk.bIsUE4Data)
+		{
+			// The data is stripped or failed to load, skip the mip
+		}
+#endif
+		else if (Bulk.CanReloadBulk())
+		{
+			// Data is not loaded, identify it by location in the texture file cache, which is shared
+			// between packages
+			FString Location = *TextureFileCacheName;
+			int64 Offset = Bulk.BulkDataOffsetInFile;
+			int64 SizeOnDisk = Bulk.BulkDataSizeOnDisk;
+			Ar << Location << Offset << SizeOnDisk;
+			NumMipsWithData++;
+		}
+	}
+
+	// Texture data is stored in unknown way (e.g. game-specific), can't compare it
+	return NumMipsWithData > 0;
+
+	unguard;
+}
+
 void UMaterial3::Serialize(FArchive &Ar)
 {
 #if UNREAL4
@@ -2,6 +2,7 @@
 #define __UNMATH_TOOLS_H__
 
 #include "Mesh/MeshCommon.h"	// types for CVertexShare
+#include "HashIndex.h"			// for CVertexShare
 
 inline void RotatorToAxis(const FRotator& Rot, CAxis& Axis)
 {
@@ -115,11 +116,10 @@ struct CVertexShare
 	int				WedgeIndex;
 
 #if USE_HASHING
-	// hashing
+	// hashing: positions are quantized to a grid of 2^21 cells per axis inside the mesh bounds
 	CVec3			Mins, Maxs;
-	CVec3			Extents;
-	int				Hash[16384];
-	TArray<int>		HashNext;
+	CVec3			CellScale;
+	CHashIndex		Hash;
 #endif // USE_HASHING
 
 	void Prepare(const CMeshVertex *Verts, int NumVerts, int VertexSize)
@@ -134,14 +134,34 @@ struct CVertexShare
 #if USE_HASHING
 		// compute bounds for better hashing
 		ComputeBounds(&Verts->Position, NumVerts, VertexSize, Mins, Maxs);
-		VectorSubtract(Maxs, Mins, Extents);
-		Extents[0] += 1; Extents[1] += 1; Extents[2] += 1; // avoid zero divide
-		// initialize Hash and HashNext with -1
-		HashNext.Init(-1, NumVerts);
-		memset(Hash, -1, sizeof(Hash));
+		for (int i = 0; i < 3; i++)
+			CellScale[i] = (1 << 21) / (Maxs[i] - Mins[i] + 1); // avoid zero divide
+		Hash.Empty();
+		Hash.Reserve(NumVerts);
 #endif // USE_HASHING
 	}
 
+#if USE_HASHING
+	uint64 GetHash(const CVec3 &Pos, CPackedNormal Normal, uint32 ExtraInfo) const
+	{
+		// Equal positions always produce equal cells, so it's enough to compare points with the same hash
+		uint64 h = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			uint32 Cell = appFloor((Pos[i] - Mins[i]) * CellScale[i]) & 0x1FFFFF;
+			h = (h << 21) | Cell;
+		}
+		h ^= ((uint64)Normal.Data << 24) ^ ((uint64)ExtraInfo << 40) ^ ExtraInfo;
+		// mix bits, lower bits are used as table slot
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+#endif // USE_HASHING
+
 	int AddVertex(const CVec3 &Pos, CPackedNormal Normal, uint32 ExtraInfo = 0)
 	{
 		int PointIndex = -1;
@@ -149,16 +169,16 @@ struct CVertexShare
 		Normal.Data &= 0xFFFFFF;		// clear W component which is used for binormal computation
 
 #if USE_HASHING
-		// compute hash
-		int h = appFloor(
-			( (Pos[0] - Mins[0]) / Extents[0] + (Pos[1] - Mins[1]) / Extents[1] + (Pos[2] - Mins[2]) / Extents[2] ) // 0..3
-			* (ARRAY_COUNT(Hash) / 3.0f * 16)			// multiply to 16 for better spreading inside Hash array
-		) % ARRAY_COUNT(Hash);
 		// find point with the same position and normal
-		for (PointIndex = Hash[h]; PointIndex >= 0; PointIndex = HashNext[PointIndex])
+		uint64 h = GetHash(Pos, Normal, ExtraInfo);
+		for (CHashIndex::CIterator It(Hash, h); It; ++It)
 		{
-			if (Points[PointIndex] == Pos && Normals[PointIndex] == Normal && ExtraInfos[PointIndex] == ExtraInfo)
-				break;		// found it
+			int Index = *It;
+			if (Points[Index] == Pos && Normals[Index] == Normal && ExtraInfos[Index] == ExtraInfo)
+			{
+				PointIndex = Index;		// found it
+				break;
+			}
 		}
 #else
 		// find wedge with the same position and normal
@@ -177,8 +197,7 @@ struct CVertexShare
 			ExtraInfos.Add(ExtraInfo);
 #if USE_HASHING
 			// add to Hash
-			HashNext[PointIndex] = Hash[h];
-			Hash[h] = PointIndex;
+			Hash.Add(h, PointIndex);
 #endif // USE_HASHING
 		}
 
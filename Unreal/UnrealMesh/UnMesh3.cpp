@@ -14,6 +14,7 @@
 #include "Mesh/SkeletalMesh.h"
 #include "Mesh/StaticMesh.h"
 #include "TypeConvert.h"
+#include "UnMeshConvert.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -2101,6 +2102,32 @@ after_skeleton:
 }
 
 
+FORCEINLINE void GetGPUSkinPosition3(const FVector& Pos, const FSkeletalMeshVertexBuffer3& S, CVecT& Dst)
+{
+	Dst = CVT(Pos);
+}
+
+FORCEINLINE void GetGPUSkinPosition3(const FVectorIntervalFixed32GPU& Pos, const FSkeletalMeshVertexBuffer3& S, CVecT& Dst)
+{
+	FVector VPos = Pos.ToVector(S.MeshOrigin, S.MeshExtension);
+	Dst = CVT(VPos);
+}
+
+template<class TVert>
+static void ConvertGPUSkinVerts3(CSkelMeshLod* Lod, int FirstVertex, const TVert* V, const FSkeletalMeshVertexBuffer3& S, const TArray<int16>& BoneMap, int NumTexCoords, int Count)
+{
+	CSkelMeshVertex* D = Lod->Verts + FirstVertex;
+	// position
+	for (int i = 0; i < Count; i++)
+		GetGPUSkinPosition3(V[i].Pos, S, D[i].Position);
+	// UV
+	CopyVertexUVs(D, Lod->ExtraUV, FirstVertex, V->UV, sizeof(TVert), NumTexCoords, Count);
+	// convert Normal[3]
+	CopyVertexNormals(D, V->Normal, sizeof(TVert), Count);
+	// convert influences
+	CopyVertexInfluences<NUM_INFLUENCES_UE3>(D, V->BoneIndex, V->BoneWeight, sizeof(TVert), BoneMap, Count);
+}
+
 void USkeletalMesh3::ConvertMesh()
 {
 	guard(USkeletalMesh3::ConvertMesh);
@@ -2191,103 +2218,59 @@ void USkeletalMesh3::ConvertMesh()
 		CSkelMeshVertex *D = Lod->Verts;
 		int NumReweightedVerts = 0;
 
-		for (int Vert = 0; Vert < VertexCount; Vert++, D++)
+		if (Lod->VertexColors)
+			memcpy(Lod->VertexColors, SrcLod.VertexColor.GetData(), VertexCount * sizeof(FColor));
+
+		if (UseGpuSkinVerts)
 		{
-			if (Vert >= lastChunkVertex)
+			// NOTE: Gears3 has some issues:
+			// - chunk may have FirstVertex set to incorrect value (for recent UE3 versions), which overlaps with the
+			//   previous chunk (FirstVertex=0 for a few chunks)
+			// - index count may be greater than sum of all face counts * 3 from all mesh sections -- this is verified in PSK exporter
+
+			// Split vertices into ranges of chunks, each chunk has its own bone map. Chunk with wrong FirstVertex
+			// gets a single vertex.
+			for (int Vert = 0; Vert < VertexCount; /* empty */)
 			{
 				// proceed to next chunk
 				C = &SrcLod.Chunks[chunkIndex++];
 				lastChunkVertex = C->FirstVertex + C->NumRigidVerts + C->NumSoftVerts;
-			}
-
-			if (Lod->VertexColors)
-				Lod->VertexColors[Vert] = SrcLod.VertexColor[Vert];
-
-			if (UseGpuSkinVerts)
-			{
-				// NOTE: Gears3 has some issues:
-				// - chunk may have FirstVertex set to incorrect value (for recent UE3 versions), which overlaps with the
-				//   previous chunk (FirstVertex=0 for a few chunks)
-				// - index count may be greater than sum of all face counts * 3 from all mesh sections -- this is verified in PSK exporter
+				int FirstVertex = Vert;
+				int NumVerts = max(min(lastChunkVertex, VertexCount) - Vert, 1);
+				Vert += NumVerts;
 
 				// get vertex from GPU skin
-				const FGPUVert3Common *V;		// has normal and influences, but no UV[] and position
-
-				if (!S.bUseFullPrecisionUVs)
-				{
-					// position
-					const FMeshUVHalf *SUV;
-					if (!S.bUsePackedPosition)
+				ParallelForVertexBlocks(NumVerts, [&](int First, int Count)
 					{
-						const FGPUVert3Half &V0 = S.VertsHalf[Vert];
-						D->Position = CVT(V0.Pos);
-						V   = &V0;
-						SUV = V0.UV;
-					}
-					else
-					{
-						const FGPUVert3PackedHalf &V0 = S.VertsHalfPacked[Vert];
-						FVector VPos;
-						VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
-						D->Position = CVT(VPos);
-						V   = &V0;
-						SUV = V0.UV;
-					}
-					// UV
-					FMeshUVFloat fUV = SUV[0];			// convert half->float
-					D->UV = CVT(fUV);
-					for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-					{
-						Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-					}
-				}
-				else
-				{
-					// position
-					const FMeshUVFloat *SUV;
-					if (!S.bUsePackedPosition)
-					{
-						const FGPUVert3Float &V0 = S.VertsFloat[Vert];
-						V = &V0;
-						D->Position = CVT(V0.Pos);
-						SUV = V0.UV;
-					}
-					else
-					{
-						const FGPUVert3PackedFloat &V0 = S.VertsFloatPacked[Vert];
-						V = &V0;
-						FVector VPos;
-						VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
-						D->Position = CVT(VPos);
-						SUV = V0.UV;
-					}
-					// UV
-					FMeshUVFloat fUV = SUV[0];
-					D->UV = CVT(fUV);
-					for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-					{
-						Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-					}
-				}
-				// convert Normal[3]
-				UnpackNormals(V->Normal, *D);
-				// convert influences
-				int i2 = 0;
-				unsigned PackedWeights = 0;
-				for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
-				{
-					int BoneIndex  = V->BoneIndex[i];
-					byte BoneWeight = V->BoneWeight[i];
-					if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
-					PackedWeights |= BoneWeight << (i2 * 8);
-					D->Bone[i2]   = C->Bones[BoneIndex];
-					i2++;
-				}
-				D->PackedWeights = PackedWeights;
-				if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
+						First += FirstVertex;
+						if (!S.bUseFullPrecisionUVs)
+						{
+							if (!S.bUsePackedPosition)
+								ConvertGPUSkinVerts3(Lod, First, &S.VertsHalf[First], S, C->Bones, NumTexCoords, Count);
+							else
+								ConvertGPUSkinVerts3(Lod, First, &S.VertsHalfPacked[First], S, C->Bones, NumTexCoords, Count);
+						}
+						else
+						{
+							if (!S.bUsePackedPosition)
+								ConvertGPUSkinVerts3(Lod, First, &S.VertsFloat[First], S, C->Bones, NumTexCoords, Count);
+							else
+								ConvertGPUSkinVerts3(Lod, First, &S.VertsFloatPacked[First], S, C->Bones, NumTexCoords, Count);
+						}
+					});
 			}
-			else
+		}
+		else
+		{
+			for (int Vert = 0; Vert < VertexCount; Vert++, D++)
 			{
+				if (Vert >= lastChunkVertex)
+				{
+					// proceed to next chunk
+					C = &SrcLod.Chunks[chunkIndex++];
+					lastChunkVertex = C->FirstVertex + C->NumRigidVerts + C->NumSoftVerts;
+				}
+
 				// old UE3 version without a GPU skin
 				// get vertex from chunk
 				const FMeshUVFloat *SUV;
@@ -2449,6 +2432,17 @@ void USkeletalMesh3::GetMetadata(FArchive& Ar) const
 	unguard;
 }
 
+bool USkeletalMesh3::GetContentKey(FArchive& Ar) const
+{
+	guard(USkeletalMesh3::GetContentKey);
+
+	if (!ConvertedMesh) return false;
+	ConvertedMesh->GetContentKey(Ar);
+	return true;
+
+	unguard;
+}
+
 
 /*-----------------------------------------------------------------------------
 	UStaticMesh
@@ -3996,26 +3990,33 @@ void UStaticMesh3::ConvertMesh()
 		// vertices
 		Lod->AllocateVerts(NumVerts);
 		Lod->AllocateVertexColorBuffer();
-		for (int i = 0; i < NumVerts; i++)
+		if (NumVerts)
 		{
-			const FStaticMeshUVItem3 &SUV = SrcLod.UVStream.UV[i];
-			CStaticMeshVertex &V = Lod->Verts[i];
+			assert(SrcLod.UVStream.UV.Num() >= NumVerts);
+		}
 
-			V.Position = CVT(SrcLod.VertexStream.Verts[i]);
-			UnpackNormals(SUV.Normal, V);
-			// copy UV
-			const FMeshUVFloat* fUV = &SUV.UV[0];
-			V.UV = *CVT(fUV);
-			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+		guard(ProcessVerts);
+		const FVector* SrcPos = SrcLod.VertexStream.Verts.GetData();
+		const FStaticMeshUVItem3* SrcUV = SrcLod.UVStream.UV.GetData();
+		bool bUseColorStream = (SrcLod.ColorStream.Colors.Num() == NumVerts);
+		ParallelForVertexBlocks(NumVerts, [&](int First, int Count)
 			{
-				fUV++;
-				Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
-			}
-			if (SrcLod.ColorStream.Colors.Num() == NumVerts)
-				Lod->VertexColors[i] = SrcLod.ColorStream.Colors[i];
-			else
-				Lod->VertexColors[i] = SUV.Color;
-		}
+				CStaticMeshVertex* D = Lod->Verts + First;
+				CopyVertexPositions(D, SrcPos + First, sizeof(FVector), Count);
+				CopyVertexNormals(D, SrcUV[First].Normal, sizeof(FStaticMeshUVItem3), Count);
+				CopyVertexUVs(D, Lod->ExtraUV, First, SrcUV[First].UV, sizeof(FStaticMeshUVItem3), NumTexCoords, Count);
+				FColor* DstColor = Lod->VertexColors + First;
+				if (bUseColorStream)
+				{
+					memcpy(DstColor, &SrcLod.ColorStream.Colors[First], Count * sizeof(FColor));
+				}
+				else
+				{
+					for (int i = 0; i < Count; i++)
+						DstColor[i] = SrcUV[First + i].Color;
+				}
+			});
+		unguard;
 
 		// Remove vertex colors if they're filled with white color
 		bool bAllWhite = true;
@@ -4070,4 +4071,15 @@ void UStaticMesh3::GetMetadata(FArchive& Ar) const
 	unguard;
 }
 
+bool UStaticMesh3::GetContentKey(FArchive& Ar) const
+{
+	guard(UStaticMesh3::GetContentKey);
+
+	if (!ConvertedMesh) return false;
+	ConvertedMesh->GetContentKey(Ar);
+	return true;
+
+	unguard;
+}
+
 #endif // UNREAL3
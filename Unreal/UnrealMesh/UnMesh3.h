@@ -304,6 +304,7 @@ public:
 #endif
 
 	virtual void GetMetadata(FArchive& Ar) const;
+	virtual bool GetContentKey(FArchive& Ar) const;
 
 protected:
 	void ConvertMesh();
@@ -817,6 +818,7 @@ public:
 	virtual void Serialize(FArchive &Ar);
 
 	virtual void GetMetadata(FArchive& Ar) const;
+	virtual bool GetContentKey(FArchive& Ar) const;
 
 protected:
 	void ConvertMesh();
@@ -17,6 +17,7 @@
 #include "Mesh/SkeletalMesh.h"
 #include "Mesh/StaticMesh.h"
 #include "TypeConvert.h"
+#include "UnMeshConvert.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -41,6 +42,9 @@
 #endif
 
 
+int GMaxMeshLods = 0;
+
+
 #if NUM_INFLUENCES_UE4 != NUM_INFLUENCES
 //!!#error NUM_INFLUENCES_UE4 and NUM_INFLUENCES are not matching!
 #endif
@@ -1270,6 +1274,27 @@ struct FStaticLODModel4
 	FSkeletalMeshVertexColorBuffer4 ColorVertexBuffer;		//!! TODO: switch to FColorVertexBuffer4
 	FSkeletalMeshVertexClothBuffer ClothVertexBuffer;
 
+	bool HasIndices() const
+	{
+		return Indices.Indices16.Num() || Indices.Indices32.Num();
+	}
+
+	// Free vertex and index data, used when LOD is converted or not needed at all
+	void ReleaseData()
+	{
+		Sections.Empty();
+		Chunks.Empty();
+		Indices.Indices16.Empty();
+		Indices.Indices32.Empty();
+		AdjacencyIndexBuffer.Indices16.Empty();
+		AdjacencyIndexBuffer.Indices32.Empty();
+		RawPointIndices.ReleaseData();
+		MeshToImportVertexMap.Empty();
+		VertexBufferGPUSkin.VertsHalf.Empty();
+		VertexBufferGPUSkin.VertsFloat.Empty();
+		ColorVertexBuffer.Data.Empty();
+	}
+
 	enum EClassDataStripFlag
 	{
 		CDSF_AdjacencyData = 1,
@@ -1925,6 +1950,23 @@ void USkeletalMesh4::PostLoad()
 	unguard;
 }
 
+// Range of vertices which belongs to the same skeletal mesh chunk or section
+struct CVertexChunkRange
+{
+	int			FirstVertex;
+	int			NumVerts;
+	int			ChunkIndex;
+};
+
+template<class TVert>
+static void ConvertSkelMeshVerts4(CSkelMeshVertex* D, CSkelMeshLod* Lod, int FirstVertex, const TVert* V, const TArray<uint16>& BoneMap, int NumTexCoords, int Count)
+{
+	CopyVertexPositions(D, &V->Pos, sizeof(TVert), Count);
+	CopyVertexNormals(D, V->Normal, sizeof(TVert), Count);
+	CopyVertexUVs(D, Lod->ExtraUV, FirstVertex, V->UV, sizeof(TVert), NumTexCoords, Count);
+	CopyVertexInfluences<NUM_INFLUENCES_UE4>(D, V->Infs.BoneIndex, V->Infs.BoneWeight, sizeof(TVert), BoneMap, Count);
+}
+
 void USkeletalMesh4::ConvertMesh()
 {
 	guard(USkeletalMesh4::ConvertMesh);
@@ -1944,15 +1986,32 @@ void USkeletalMesh4::ConvertMesh()
 	Mesh->RotOrigin.Set(0, 0, 0);
 	Mesh->MeshScale.Set(1, 1, 1);							// missing in UE4
 
-	// convert LODs
-	Mesh->Lods.Empty(LODModels.Num());
+	// find LODs which should be converted, release all other ones before conversion
 	assert(LODModels.Num() == LODInfo.Num());
-	for (int lod = 0; lod < LODModels.Num(); lod++)
+	int NumSrcLods = LODModels.Num();
+	if (GMaxMeshLods > 0)
+	{
+		int NumLods = 0;
+		for (int lod = 0; lod < NumSrcLods; lod++)
+		{
+			if (LODModels[lod].HasIndices() && ++NumLods == GMaxMeshLods)
+			{
+				NumSrcLods = lod + 1;
+				break;
+			}
+		}
+		for (int lod = NumSrcLods; lod < LODModels.Num(); lod++)
+			LODModels[lod].ReleaseData();
+	}
+
+	// convert LODs
+	Mesh->Lods.Empty(NumSrcLods);
+	for (int lod = 0; lod < NumSrcLods; lod++)
 	{
 		guard(ConvertLod);
 
-		const FStaticLODModel4 &SrcLod = LODModels[lod];
-		if (SrcLod.Indices.Indices16.Num() == 0 && SrcLod.Indices.Indices32.Num() == 0)
+		FStaticLODModel4 &SrcLod = LODModels[lod];
+		if (!SrcLod.HasIndices())
 		{
 			appPrintf("Lod %d has no indices, skipping.\n", lod);
 			continue;
@@ -1973,7 +2032,7 @@ void USkeletalMesh4::ConvertMesh()
 		int VertexCount = SrcLod.VertexBufferGPUSkin.GetVertexCount();
 
 		bool bUseVerticesFromSections = false;
-		if (VertexCount == 0 && LODModels[lod].Sections.Num() > 0 && SrcLod.Sections[0].SoftVertices.Num())
+		if (VertexCount == 0 && SrcLod.Sections.Num() > 0 && SrcLod.Sections[0].SoftVertices.Num())
 		{
 			// For editor assets, count vertex count from sections. This happens with UE4.19+, where rendering
 			// and editor data were separated (or may be with earlier engine version).
@@ -1987,20 +2046,18 @@ void USkeletalMesh4::ConvertMesh()
 		// allocate the vertices
 		Lod->AllocateVerts(VertexCount);
 
-		int chunkIndex = -1;
-		int lastChunkVertex = -1;
-		int chunkVertexIndex = 0;
-
-		const TArray<uint16>* BoneMap = NULL;
 		const FSkeletalMeshVertexBuffer4& VertBuffer = SrcLod.VertexBufferGPUSkin;
-		CSkelMeshVertex* D = Lod->Verts;
 
 		if (SrcLod.ColorVertexBuffer.Data.Num() == VertexCount)
 			Lod->AllocateVertexColorBuffer();
 		else if (SrcLod.ColorVertexBuffer.Data.Num())
 			appPrintf("LOD %d has invalid vertex color stream\n", lod);
 
-		for (int Vert = 0; Vert < VertexCount; Vert++, D++)
+		// Split vertices into ranges of chunks (pre-UE4.13) or sections (UE4.13+), each one has its own bone map
+		TArray<CVertexChunkRange> Ranges;
+		int chunkIndex = -1;
+		int lastChunkVertex = -1;
+		for (int Vert = 0; Vert < VertexCount; /* empty */)
 		{
 			while (Vert >= lastChunkVertex) // this will fix any issues with empty chunks or sections
 			{
@@ -2010,78 +2067,50 @@ void USkeletalMesh4::ConvertMesh()
 					// pre-UE4.13 code: chunks
 					const FSkelMeshChunk4& C = SrcLod.Chunks[++chunkIndex];
 					lastChunkVertex = C.BaseVertexIndex + C.NumRigidVertices + C.NumSoftVertices;
-					BoneMap = &C.BoneMap;
 				}
 				else
 				{
 					// UE4.13+ code: chunk information migrated to sections
 					const FSkelMeshSection4& S = SrcLod.Sections[++chunkIndex];
 					lastChunkVertex = S.BaseVertexIndex + S.NumVertices;
-					BoneMap = &S.BoneMap;
 				}
-				chunkVertexIndex = 0;
 			}
+			CVertexChunkRange& R = Ranges.AddZeroed_GetRef();
+			R.FirstVertex = Vert;
+			R.NumVerts = min(lastChunkVertex, VertexCount) - Vert;
+			R.ChunkIndex = chunkIndex;
+			Vert += R.NumVerts;
+		}
 
-			// get vertex from GPU skin
-			const FSkelMeshVertexBase *V;				// has everything but UV[]
-
-			if (bUseVerticesFromSections)
-			{
-				const FSoftVertex4& V0 = SrcLod.Sections[chunkIndex].SoftVertices[chunkVertexIndex++];
-				const FMeshUVFloat *SrcUV = V0.UV;
-				V = &V0;
-				// UV: simply copy float data
-				D->UV = CVT(SrcUV[0]);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SrcUV[TexCoordIndex]);
-				}
-			}
-			else if (!VertBuffer.bUseFullPrecisionUVs)
-			{
-				const FGPUVert4Half& V0 = VertBuffer.VertsHalf[Vert];
-				const FMeshUVHalf* SrcUV = V0.UV;
-				V = &V0;
-				// UV: convert half -> float
-				D->UV = CVT(SrcUV[0]);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SrcUV[TexCoordIndex]);
-				}
-			}
-			else
-			{
-				const FGPUVert4Float& V0 = VertBuffer.VertsFloat[Vert];
-				const FMeshUVFloat *SrcUV = V0.UV;
-				V = &V0;
-				// UV: simply copy float data
-				D->UV = CVT(SrcUV[0]);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+		for (const CVertexChunkRange& R : Ranges)
+		{
+			const TArray<uint16>& BoneMap = SrcLod.Chunks.Num() ? SrcLod.Chunks[R.ChunkIndex].BoneMap : SrcLod.Sections[R.ChunkIndex].BoneMap;
+			ParallelForVertexBlocks(R.NumVerts, [&](int First, int Count)
 				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SrcUV[TexCoordIndex]);
-				}
-			}
-			D->Position = CVT(V->Pos);
-			UnpackNormals(V->Normal, *D);
-			if (Lod->VertexColors)
-			{
-				//todo: check if this will work with "source" models - FSoftVertex4 has Color field
-				Lod->VertexColors[Vert] = SrcLod.ColorVertexBuffer.Data[Vert];
-			}
-			// convert influences
-			int i2 = 0;
-			unsigned PackedWeights = 0;
-			for (int i = 0; i < NUM_INFLUENCES_UE4; i++)
-			{
-				int BoneIndex  = V->Infs.BoneIndex[i];
-				byte BoneWeight = V->Infs.BoneWeight[i];
-				if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
-				PackedWeights |= BoneWeight << (i2 * 8);
-				D->Bone[i2]   = (*BoneMap)[BoneIndex];
-				i2++;
-			}
-			D->PackedWeights = PackedWeights;
-			if (i2 < NUM_INFLUENCES_UE4) D->Bone[i2] = INDEX_NONE; // mark end of list
+					int Vert = R.FirstVertex + First;
+					CSkelMeshVertex* D = Lod->Verts + Vert;
+					// get vertex from GPU skin
+					if (bUseVerticesFromSections)
+					{
+						// vertices are indexed from the start of the section
+						const FSoftVertex4* V = &SrcLod.Sections[R.ChunkIndex].SoftVertices[First];
+						ConvertSkelMeshVerts4(D, Lod, Vert, V, BoneMap, NumTexCoords, Count);
+					}
+					else if (!VertBuffer.bUseFullPrecisionUVs)
+					{
+						// UV: convert half -> float
+						ConvertSkelMeshVerts4(D, Lod, Vert, &VertBuffer.VertsHalf[Vert], BoneMap, NumTexCoords, Count);
+					}
+					else
+					{
+						ConvertSkelMeshVerts4(D, Lod, Vert, &VertBuffer.VertsFloat[Vert], BoneMap, NumTexCoords, Count);
+					}
+					if (Lod->VertexColors)
+					{
+						//todo: check if this will work with "source" models - FSoftVertex4 has Color field
+						memcpy(Lod->VertexColors + Vert, &SrcLod.ColorVertexBuffer.Data[Vert], Count * sizeof(FColor));
+					}
+				});
 		}
 
 		unguard;	// ProcessVerts
@@ -2116,6 +2145,9 @@ void USkeletalMesh4::ConvertMesh()
 
 		unguard;	// ProcessSections
 
+		// source data is not needed anymore
+		SrcLod.ReleaseData();
+
 		unguardf("lod=%d", lod); // ConvertLod
 	}
 
@@ -2363,6 +2395,28 @@ struct FStaticMeshLODModel4
 	FRawStaticIndexBuffer4   AdjacencyIndexBuffer;
 	float                    MaxDeviation;
 
+	// UE4.20+, see CDSF_MinLodData
+	bool IsStripped() const
+	{
+		return PositionVertexBuffer.Verts.Num() == 0 && VertexBuffer.NumTexCoords == 0;
+	}
+
+	// Free vertex and index data, used when LOD is converted or not needed at all
+	void ReleaseData()
+	{
+		Sections.Empty();
+		VertexBuffer.UV.Empty();
+		PositionVertexBuffer.Verts.Empty();
+		ColorVertexBuffer.Data.Empty();
+		FRawStaticIndexBuffer4* Buffers[] = { &IndexBuffer, &ReversedIndexBuffer, &DepthOnlyIndexBuffer,
+			&ReversedDepthOnlyIndexBuffer, &WireframeIndexBuffer, &AdjacencyIndexBuffer };
+		for (FRawStaticIndexBuffer4* B : Buffers)
+		{
+			B->Indices16.Empty();
+			B->Indices32.Empty();
+		}
+	}
+
 	enum EClassDataStripFlag
 	{
 		CDSF_AdjacencyData = 1,
@@ -2961,18 +3015,35 @@ void UStaticMesh4::ConvertMesh()
 	VectorSubtract(CVT(Bounds.Origin), CVT(Bounds.BoxExtent), CVT(Mesh->BoundingBox.Min));
 	VectorAdd     (CVT(Bounds.Origin), CVT(Bounds.BoxExtent), CVT(Mesh->BoundingBox.Max));
 
+	// find LODs which should be converted, release all other ones before conversion
+	int NumSrcLods = Lods.Num();
+	if (GMaxMeshLods > 0)
+	{
+		int NumLods = 0;
+		for (int lodIndex = 0; lodIndex < NumSrcLods; lodIndex++)
+		{
+			if (!Lods[lodIndex].IsStripped() && ++NumLods == GMaxMeshLods)
+			{
+				NumSrcLods = lodIndex + 1;
+				break;
+			}
+		}
+		for (int lodIndex = NumSrcLods; lodIndex < Lods.Num(); lodIndex++)
+			Lods[lodIndex].ReleaseData();
+	}
+
 	// convert lods
-	Mesh->Lods.Empty(Lods.Num());
-	for (int lodIndex = 0; lodIndex < Lods.Num(); lodIndex++)
+	Mesh->Lods.Empty(NumSrcLods);
+	for (int lodIndex = 0; lodIndex < NumSrcLods; lodIndex++)
 	{
 		guard(ConvertLod);
 
-		const FStaticMeshLODModel4 &SrcLod = Lods[lodIndex];
+		FStaticMeshLODModel4 &SrcLod = Lods[lodIndex];
 
 		int NumTexCoords = SrcLod.VertexBuffer.NumTexCoords;
 		int NumVerts     = SrcLod.PositionVertexBuffer.Verts.Num();
 
-		if (NumVerts == 0 && NumTexCoords == 0 && lodIndex < Lods.Num()-1)
+		if (SrcLod.IsStripped() && lodIndex < Lods.Num()-1)
 		{
 			// UE4.20+, see CDSF_MinLodData
 			appPrintf("Lod #%d is stripped, skipping ...\n", lodIndex);
@@ -3003,33 +3074,36 @@ void UStaticMesh4::ConvertMesh()
 		// vertices
 		Lod->AllocateVerts(NumVerts);
 		if (SrcLod.ColorVertexBuffer.NumVertices)
+		{
+			assert(SrcLod.ColorVertexBuffer.Data.Num() >= NumVerts);
 			Lod->AllocateVertexColorBuffer();
-
-		for (int i = 0; i < NumVerts; i++)
+		}
+		if (NumVerts)
 		{
-			const FStaticMeshUVItem4 &SUV = SrcLod.VertexBuffer.UV[i];
-			CStaticMeshVertex &V = Lod->Verts[i];
-
-			V.Position = CVT(SrcLod.PositionVertexBuffer.Verts[i]);
-			UnpackNormals(SUV.Normal, V);
-			// copy UV
-			const FMeshUVFloat* fUV = &SUV.UV[0];
-			V.UV = *CVT(fUV);
-			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-			{
-				fUV++;
-				Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
-			}
-			if (Lod->VertexColors)
-			{
-				Lod->VertexColors[i] = SrcLod.ColorVertexBuffer.Data[i];
-			}
+			assert(SrcLod.PositionVertexBuffer.Verts.Num() >= NumVerts && SrcLod.VertexBuffer.UV.Num() >= NumVerts);
 		}
 
+		guard(ProcessVerts);
+		const FVector* SrcPos = SrcLod.PositionVertexBuffer.Verts.GetData();
+		const FStaticMeshUVItem4* SrcUV = SrcLod.VertexBuffer.UV.GetData();
+		ParallelForVertexBlocks(NumVerts, [&](int First, int Count)
+			{
+				CStaticMeshVertex* D = Lod->Verts + First;
+				CopyVertexPositions(D, SrcPos + First, sizeof(FVector), Count);
+				CopyVertexNormals(D, SrcUV[First].Normal, sizeof(FStaticMeshUVItem4), Count);
+				CopyVertexUVs(D, Lod->ExtraUV, First, SrcUV[First].UV, sizeof(FStaticMeshUVItem4), NumTexCoords, Count);
+				if (Lod->VertexColors)
+					memcpy(Lod->VertexColors + First, &SrcLod.ColorVertexBuffer.Data[First], Count * sizeof(FColor));
+			});
+		unguard;
+
 		// indices
 		Lod->Indices.Initialize(&SrcLod.IndexBuffer.Indices16, &SrcLod.IndexBuffer.Indices32);
 		if (Lod->Indices.Num() == 0) appError("This StaticMesh doesn't have an index buffer");
 
+		// source data is not needed anymore
+		SrcLod.ReleaseData();
+
 		unguardf("lod=%d", lodIndex);
 	}
 
@@ -3101,6 +3175,7 @@ void UStaticMesh4::ConvertSourceModels()
 		const FStaticMeshSourceModel& SrcModel = SourceModels[LODIndex];
 		const FByteBulkData& Bulk = SrcModel.BulkData;
 		if (Bulk.ElementCount == 0) continue;	// this SourceModel has generated LOD, not imported one
+		if (GMaxMeshLods > 0 && Mesh->Lods.Num() >= GMaxMeshLods) break;
 
 		CStaticMeshLod *Lod = new (Mesh->Lods) CStaticMeshLod;
 
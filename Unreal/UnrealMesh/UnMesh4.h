@@ -16,6 +16,10 @@ class UAnimSequence4;
 #define MAX_STATIC_UV_SETS_UE4			8
 #define MAX_STATIC_LODS_UE4				8		// 4 before 4.9, 8 starting with 4.9
 
+// Maximal number of LODs converted when UE4 mesh is loaded, 0 means all LODs. Source data
+// of the remaining LODs is released without conversion.
+extern int GMaxMeshLods;
+
 
 /*-----------------------------------------------------------------------------
 	USkeletalMesh
@@ -0,0 +1,95 @@
+#ifndef __UNMESH_CONVERT_H__
+#define __UNMESH_CONVERT_H__
+
+/*-----------------------------------------------------------------------------
+	Helpers for converting Unreal vertex buffers to CMeshVertex arrays.
+	Every vertex stream (positions, normals, UV sets, colors, influences) is
+	converted with its own simple loop over a range of vertices, without
+	per-vertex branching, and vertex ranges are processed with ParallelFor.
+	Source streams are addressed with pointer to the first item and stride,
+	so the same code works for interleaved and separate vertex buffers.
+-----------------------------------------------------------------------------*/
+
+#include "Mesh/MeshCommon.h"
+#include "Parallel.h"
+
+// Number of vertices processed by a single ParallelFor iteration
+#define VERTEX_CONVERT_BLOCK		4096
+
+// Call Func(FirstVertex, NumVerts) for blocks of vertices in parallel
+template<typename F>
+inline void ParallelForVertexBlocks(int NumVerts, F&& Func)
+{
+	int NumBlocks = (NumVerts + VERTEX_CONVERT_BLOCK - 1) / VERTEX_CONVERT_BLOCK;
+	ParallelFor(NumBlocks, [&Func, NumVerts](int Block)
+		{
+			int First = Block * VERTEX_CONVERT_BLOCK;
+			Func(First, min(VERTEX_CONVERT_BLOCK, NumVerts - First));
+		});
+}
+
+template<class TDst>
+inline void CopyVertexPositions(TDst* Dst, const FVector* Src, int SrcStride, int Count)
+{
+	for (int i = 0; i < Count; i++, Src = OffsetPointer(Src, SrcStride))
+		Dst[i].Position = (const CVec3&)*Src;
+}
+
+// Src points to FPackedNormal[3] array of the first vertex
+template<class TDst>
+inline void CopyVertexNormals(TDst* Dst, const FPackedNormal* Src, int SrcStride, int Count)
+{
+	for (int i = 0; i < Count; i++, Src = OffsetPointer(Src, SrcStride))
+		UnpackNormals(Src, Dst[i]);
+}
+
+// Src points to UV[0] of the first vertex, other UV sets are placed right after it. TUV is
+// FMeshUVFloat or FMeshUVHalf. ExtraUV are destination arrays for all vertices of the LOD.
+template<class TDst, class TUV>
+inline void CopyVertexUVs(TDst* Dst, CMeshUVFloat* const* ExtraUV, int FirstVertex, const TUV* Src, int SrcStride, int NumTexCoords, int Count)
+{
+	const TUV* S = Src;
+	for (int i = 0; i < Count; i++, S = OffsetPointer(S, SrcStride))
+	{
+		FMeshUVFloat UV = *S;
+		Dst[i].UV.U = UV.U;
+		Dst[i].UV.V = UV.V;
+	}
+	for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+	{
+		CMeshUVFloat* D = ExtraUV[TexCoordIndex-1] + FirstVertex;
+		S = Src + TexCoordIndex;
+		for (int i = 0; i < Count; i++, S = OffsetPointer(S, SrcStride))
+		{
+			FMeshUVFloat UV = *S;
+			D[i].U = UV.U;
+			D[i].V = UV.V;
+		}
+	}
+}
+
+// Pack non-zero weights into CSkelMeshVertex, remapping bones with BoneMap. BoneIndex and BoneWeight
+// point to arrays of 'NumInfluences' bytes of the first vertex.
+template<int NumInfluences, class TDst, class TBone>
+inline void CopyVertexInfluences(TDst* Dst, const byte* BoneIndex, const byte* BoneWeight, int SrcStride, const TArray<TBone>& BoneMap, int Count)
+{
+	static_assert(NumInfluences <= NUM_INFLUENCES, "Too many influences");
+	for (int Vert = 0; Vert < Count; Vert++, BoneIndex += SrcStride, BoneWeight += SrcStride)
+	{
+		TDst& D = Dst[Vert];
+		int i2 = 0;
+		unsigned PackedWeights = 0;
+		for (int i = 0; i < NumInfluences; i++)
+		{
+			byte Weight = BoneWeight[i];
+			if (Weight == 0) continue;				// skip this influence (but do not stop the loop!)
+			PackedWeights |= Weight << (i2 * 8);
+			D.Bone[i2] = BoneMap[BoneIndex[i]];
+			i2++;
+		}
+		D.PackedWeights = PackedWeights;
+		if (i2 < NumInfluences) D.Bone[i2] = INDEX_NONE; // mark end of list
+	}
+}
+
+#endif // __UNMESH_CONVERT_H__
@@ -6,6 +6,10 @@
 
 #include "PackageUtils.h"
 
+#if THREADING
+#include "Parallel.h"
+#endif
+
 /*-----------------------------------------------------------------------------
 	Package loader/unloader
 -----------------------------------------------------------------------------*/
@@ -53,13 +57,18 @@ void ReleaseAllObjects()
 	if (!UObject::GObjObjects.Num()) return;
 
 #if 0
-	appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
+	appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", appGetAllocationSize(), appGetAllocationCount());
 	appDumpMemoryAllocations();
 #endif
 	for (int i = UObject::GObjObjects.Num() - 1; i >= 0; i--)
 		delete UObject::GObjObjects[i];
 	UObject::GObjObjects.Empty();
 
+	// All objects are destroyed, release memory allocated during their loading
+	ReleaseObjectArena();
+	// Forget property lookups made for loaded packages
+	ReleasePropertyCache();
+
 #if 0
 	// verify that all object pointers were set to NULL
 	for (int i = 0; i < UnPackage::PackageMap.Num(); i++)
@@ -77,11 +86,13 @@ void ReleaseAllObjects()
 	// This lets to avoid console spam when doing export of packages which has nothing exportable inside.
 	static size_t lastAllocsSize = 0;
 	static int lastAllocsCount = 0;
-	if (GTotalAllocationSize != lastAllocsSize || GTotalAllocationCount != lastAllocsCount)
+	size_t allocsSize = appGetAllocationSize();
+	int allocsCount = appGetAllocationCount();
+	if (allocsSize != lastAllocsSize || allocsCount != lastAllocsCount)
 	{
-		lastAllocsSize = GTotalAllocationSize;
-		lastAllocsCount = GTotalAllocationCount;
-		appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", GTotalAllocationSize, GTotalAllocationCount);
+		lastAllocsSize = allocsSize;
+		lastAllocsCount = allocsCount;
+		appPrintf("Memory: allocated " FORMAT_SIZE("d") " bytes in %d blocks\n", allocsSize, allocsCount);
 	}
 //	appDumpMemoryAllocations();
 
@@ -90,38 +101,172 @@ void ReleaseAllObjects()
 
 
 /*-----------------------------------------------------------------------------
-	Package version scanner
+	Parallel scanner
 -----------------------------------------------------------------------------*/
 
-struct ScanPackageData
+// Execute ScanFunc(index) for 'Count' items using pool threads. ProgressFunc(index) is called only
+// from the calling thread, strictly in order of items, after the item has been scanned. When
+// ProgressFunc returns false, scanning is cancelled, and function returns false. When ScanFunc
+// raises an error, scanning is stopped, and the error is passed to the calling thread.
+template<typename S, typename P>
+static bool ParallelScan(int Count, S&& ScanFunc, P&& ProgressFunc)
 {
-	ScanPackageData()
-	:	Progress(NULL)
-	,	Cancelled(false)
-	,	Index(0)
-	{}
-
-	TArray<FileInfo>*	PkgInfo;
-	IProgressCallback*	Progress;
-	bool				Cancelled;
-	int					Index;
-};
+	guard(ParallelScan);
 
-static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
-{
-	guard(ScanPackage);
+#if THREADING
+	struct CScanJob
+	{
+		S&				ScanFunc;
+		int				Count;
+		volatile int8*	Done;
+		volatile int32	NextIndex;
+		volatile int32	NumActiveThreads;
+		volatile bool	Cancelled;
+		volatile bool	Failed;
+		CSemaphore		EndSignal;
+		CSemaphore		ProgressSignal;			// signaled by worker threads when an item is scanned, or when a thread exits
+
+		CScanJob(S& InScanFunc, int InCount, int8* InDone)
+		:	ScanFunc(InScanFunc)
+		,	Count(InCount)
+		,	Done(InDone)
+		,	NextIndex(0)
+		,	NumActiveThreads(0)
+		,	Cancelled(false)
+		,	Failed(false)
+		{}
+
+		// Grab the next item and scan it. Returns false when there's nothing to scan.
+		bool ScanNext()
+		{
+			if (Cancelled) return false;
+			int Index = InterlockedIncrement(&NextIndex) - 1;
+			if (Index >= Count) return false;
+			TRY {
+				ScanFunc(Index);
+			} CATCH {
+				// Stop scanning, the error will be raised again in the calling thread. Only the first
+				// failed thread fills error information in GError.
+				Failed = true;
+				Cancelled = true;
+				return false;
+			}
+			InterlockedIncrement(&Done[Index]);
+			return true;
+		}
+
+		static void ThreadProc(void* Data)
+		{
+			guard(ParallelScanThread);
+			CScanJob* Job = (CScanJob*)Data;
+			while (Job->ScanNext())
+			{
+				Job->ProgressSignal.Signal();
+			}
+			// Wake the calling thread, it could wait for the failed item
+			Job->ProgressSignal.Signal();
+			// Signal if this was the last working thread
+			if (InterlockedDecrement(&Job->NumActiveThreads) == 0)
+				Job->EndSignal.Signal();
+			unguard;
+		}
+	};
+
+	TArray<int8> Done;
+	Done.AddZeroed(Count);
+	CScanJob Job(ScanFunc, Count, Done.GetData());
 
-	if (data.Progress)
+	// Reserve 1 "active thread" for the calling thread, so EndSignal won't be sent before all
+	// threads are spawned.
+	InterlockedIncrement(&Job.NumActiveThreads);
+	int NumThreads = min(CThread::GetLogicalCPUCount() - 1, Count);
+	for (int i = 0; i < NumThreads; i++)
 	{
-		FStaticString<MAX_PACKAGE_PATH> RelativeName;
-		file->GetRelativeName(RelativeName);
-		if (!data.Progress->Progress(*RelativeName, data.Index++, GNumPackageFiles))
+		InterlockedIncrement(&Job.NumActiveThreads);
+		if (!ThreadPool::ExecuteInThread(CScanJob::ThreadProc, &Job))
 		{
-			data.Cancelled = true;
-			return false;
+			// No more free threads
+			InterlockedDecrement(&Job.NumActiveThreads);
+			break;
+		}
+	}
+
+	// Scan items in this thread too, and report progress for all completed items in order
+	int Reported = 0;
+	while (Reported < Count && !Job.Failed)
+	{
+		if (Job.Done[Reported])
+		{
+			if (!ProgressFunc(Reported))
+			{
+				Job.Cancelled = true;
+				break;
+			}
+			Reported++;
+		}
+		else if (!Job.ScanNext())
+		{
+			// Everything is distributed, wait until a worker thread will complete something
+			Job.ProgressSignal.Wait();
 		}
 	}
 
+	// Wait for worker threads to complete
+	if (InterlockedDecrement(&Job.NumActiveThreads) != 0)
+		Job.EndSignal.Wait();
+
+	if (Job.Failed)
+	{
+		// Continue unwinding of the error from this thread, so the caller will receive it
+	#if DO_GUARD
+		GError.ErrorThreadId = CThread::CurrentId();
+	#endif
+		THROW;
+	}
+
+	return !Job.Cancelled;
+
+#else // THREADING
+
+	for (int i = 0; i < Count; i++)
+	{
+		ScanFunc(i);
+		if (!ProgressFunc(i))
+			return false;
+	}
+	return true;
+
+#endif // THREADING
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Package version scanner
+-----------------------------------------------------------------------------*/
+
+struct ScanPackageResult
+{
+	bool	IsValid;
+	int		Ver;
+	int		LicVer;
+};
+
+static bool CollectPackageFile(const CGameFileInfo *file, void* Param)
+{
+	TArray<const CGameFileInfo*>& files = *(TArray<const CGameFileInfo*>*)Param;
+	files.Add(file);
+	return true;
+}
+
+// Could be called from worker thread
+static void ScanPackage(const CGameFileInfo *file, ScanPackageResult& Result)
+{
+	guard(ScanPackage);
+
+	Result.IsValid = false;
+
 	// read a few first bytes as integers
 	FArchive *Ar = file->CreateReader();
 	uint32 FileData[16];
@@ -139,35 +284,42 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		//!! Use CreatePackageLoader() here to allow scanning of packages with custom header (Lineage etc);
 		//!! do that only when something "strange" within data noticed.
 		//!! Also, this function could react on custom package tags.
-		return true;
+		return;
 	}
 	uint32 Version = FileData[1];
 
-	FileInfo Info;
-
 #if UNREAL4
 	if ((Version & 0xFFFFF000) == 0xFFFFF000)
 	{
 		// next fields are: int VersionUE3, Version, LicenseeVersion
-		Info.Ver    = FileData[3];
-		Info.LicVer = FileData[4];
+		Result.Ver    = FileData[3];
+		Result.LicVer = FileData[4];
 	}
 	else
 #endif // UNREAL4
 	{
-		Info.Ver    = Version & 0xFFFF;
-		Info.LicVer = Version >> 16;
+		Result.Ver    = Version & 0xFFFF;
+		Result.LicVer = Version >> 16;
 	}
+	Result.IsValid = true;
+
+	unguardf("%s", *file->GetRelativeName());
+}
 
+static void AddPackageVersion(const CGameFileInfo *file, const ScanPackageResult& Result, TArray<FileInfo>& PkgInfo)
+{
+	FileInfo Info;
+	Info.Ver    = Result.Ver;
+	Info.LicVer = Result.LicVer;
 	Info.Count  = 0;
 	FStaticString<MAX_PACKAGE_PATH> RelativeName;
 	file->GetRelativeName(RelativeName);
 	strcpy(Info.FileName, *RelativeName);
 //	printf("%s - %d/%d\n", *RelativeName, Info.Ver, Info.LicVer);
 	int Index = INDEX_NONE;
-	for (int i = 0; i < data.PkgInfo->Num(); i++)
+	for (int i = 0; i < PkgInfo.Num(); i++)
 	{
-		FileInfo &Info2 = (*data.PkgInfo)[i];
+		FileInfo &Info2 = PkgInfo[i];
 		if (Info2.Ver == Info.Ver && Info2.LicVer == Info.LicVer)
 		{
 			Index = i;
@@ -175,9 +327,9 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		}
 	}
 	if (Index == INDEX_NONE)
-		Index = data.PkgInfo->Add(Info);
+		Index = PkgInfo.Add(Info);
 	// update info
-	FileInfo& fileInfo = (*data.PkgInfo)[Index];
+	FileInfo& fileInfo = PkgInfo[Index];
 	fileInfo.Count++;
 	// combine filename
 	char *s = fileInfo.FileName;
@@ -188,20 +340,43 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		d++;
 	}
 	*s = 0;
-
-	return true;
-
-	unguardf("%s", *file->GetRelativeName());
 }
 
 
 bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 {
+	guard(ScanPackageVersions);
+
 	info.Empty();
-	ScanPackageData data;
-	data.PkgInfo = &info;
-	data.Progress = progress;
-	appEnumGameFiles(ScanPackage, data);
+
+	TArray<const CGameFileInfo*> Files;
+	Files.Empty(GNumPackageFiles);
+	appEnumGameFilesWorker(CollectPackageFile, NULL, &Files);
+
+	TArray<ScanPackageResult> Results;
+	Results.AddZeroed(Files.Num());
+
+	bool bCompleted = ParallelScan(Files.Num(),
+		[&Files, &Results](int Index)
+		{
+			ScanPackage(Files[Index], Results[Index]);
+		},
+		[&Files, &Results, &info, progress](int Index) -> bool
+		{
+			const CGameFileInfo* file = Files[Index];
+			if (progress)
+			{
+				FStaticString<MAX_PACKAGE_PATH> RelativeName;
+				file->GetRelativeName(RelativeName);
+				if (!progress->Progress(*RelativeName, Index, Files.Num()))
+					return false;
+			}
+			// Merge results in order, so the output doesn't depend on threading
+			if (Results[Index].IsValid)
+				AddPackageVersion(file, Results[Index], info);
+			return true;
+		});
+
 	info.Sort([](const FileInfo& p1, const FileInfo& p2) -> int
 		{
 			int dif = p1.Ver - p2.Ver;
@@ -209,7 +384,9 @@ bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 			return p1.LicVer - p2.LicVer;
 		});
 
-	return !data.Cancelled;
+	return bCompleted;
+
+	unguard;
 }
 
 
@@ -217,8 +394,15 @@ bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 	Package content
 -----------------------------------------------------------------------------*/
 
-static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
+static void ScanPackageExports(UnPackage* package, CGameFileInfo* file, bool bCollectReferences)
 {
+	if (bCollectReferences && !file->ExportSummary)
+	{
+		file->ExportSummary = CPackageExportSummary::Create(package);
+	}
+	// Package could be scanned again just for collecting references
+	if (file->IsPackageScanned) return;
+
 	for (int idx = 0; idx < package->Summary.ExportCount; idx++)
 	{
 		const char* ObjectClass = package->GetClassNameFor(package->GetExport(idx));
@@ -241,68 +425,196 @@ static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
 	} */
 }
 
-bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress)
+/*static*/ const CPackageExportSummary* CPackageExportSummary::Create(UnPackage* Package)
 {
-	guard(ScanContent);
+	guard(CPackageExportSummary::Create);
 
-#if PROFILE
-	appResetProfiler();
-#endif
-	bool cancelled = false;
-	bool scanned = false; // says if anywhing was scanned or not, just for profiler message
+	CPackageExportSummary* Summary = new CPackageExportSummary;
 
-	// Preallocate PackageMap
-	UnPackage::ReservePackageMap(Packages.Num());
+	// Collect imported objects, skip packages and script classes
+	TArray<int> ImportIndices;
+	int NamesSize = 0;
+	for (int i = 0; i < Package->Summary.ImportCount; i++)
+	{
+		const FObjectImport& Imp = Package->GetImport(i);
+		if (Imp.PackageIndex == 0) continue;		// top-level package, or unresolved IoStore import
+		const char* ClassName = *Imp.ClassName;
+		if (!stricmp(ClassName, "Package") || !stricmp(ClassName, "Class")) continue;
+		ImportIndices.Add(i);
+		NamesSize += strlen(*Imp.ObjectName) + 1;
+	}
+	if (!ImportIndices.Num())
+		return Summary;
 
-	for (int i = 0; i < Packages.Num(); i++)
+	// Names are stored in a single buffer, allocate it before taking pointers
+	Summary->Names.SetNumUninitialized(NamesSize);
+	Summary->References.SetNumUninitialized(ImportIndices.Num());
+	char* NamePtr = Summary->Names.GetData();
+
+	// Imports of the same package usually share the same name string, cache the last lookup
+	const char* LastPackageName = NULL;
+	const CGameFileInfo* LastPackageFile = NULL;
+
+	for (int i = 0; i < ImportIndices.Num(); i++)
 	{
-		CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[i]);		// we'll modify this structure here
-		if (file->IsPackageScanned) continue;
+		const FObjectImport& Imp = Package->GetImport(ImportIndices[i]);
+		CObjectReference& Ref = Summary->References[i];
 
-		// Update progress dialog
-		FStaticString<MAX_PACKAGE_PATH> RelativeName;
-		file->GetRelativeName(RelativeName);
-		if (Progress && !Progress->Progress(*RelativeName, i, Packages.Num()))
-		{
-			cancelled = true;
-			break;
-		}
+		Ref.ClassName = appStrdupPool(*Imp.ClassName);
 
-		file->IsPackageScanned = true;
+		int Len = strlen(*Imp.ObjectName) + 1;
+		memcpy(NamePtr, *Imp.ObjectName, Len);
+		Ref.ObjectName = NamePtr;
+		NamePtr += Len;
 
-		if (file->Package)
+		const char* PackageName = Package->GetObjectPackageName(Imp.PackageIndex);
+		if (PackageName != LastPackageName)
 		{
-			// package already loaded
-			ScanPackageExports(file->Package, file);
+			LastPackageName = PackageName;
+			LastPackageFile = PackageName ? CGameFileInfo::Find(PackageName) : NULL;
 		}
-		else
+		Ref.PackageName = PackageName ? appStrdupPool(PackageName) : NULL;
+		Ref.PackageFile = LastPackageFile;
+	}
+
+	return Summary;
+
+	unguardf("%s", *Package->GetFilename());
+}
+
+// Check if package name from the import table refers to the file. Name could have a mount point,
+// e.g. "/Game/Path/Name", it is not a part of the file path.
+static bool PackageNameMatchesFile(const char* PackageName, const char* Filename)
+{
+	if (PackageName[0] == '/')
+	{
+		const char* s = strchr(PackageName + 1, '/');
+		PackageName = s ? s + 1 : PackageName + 1;
+	}
+	// Compare with the end of file name, without extension
+	int FileLen = strlen(Filename);
+	const char* Ext = strrchr(Filename, '.');
+	if (Ext && !strchr(Ext, '/') && !strchr(Ext, '\\'))
+		FileLen = Ext - Filename;
+	int NameLen = strlen(PackageName);
+	if (NameLen > FileLen) return false;
+	const char* s = Filename + FileLen - NameLen;
+	if (s > Filename && s[-1] != '/' && s[-1] != '\\') return false;
+	return strnicmp(s, PackageName, NameLen) == 0;
+}
+
+const CObjectReference* CPackageExportSummary::FindReference(const char* ClassName, const char* ObjectName, const UnPackage* Package) const
+{
+	guard(CPackageExportSummary::FindReference);
+
+	FString Filename;
+	if (!Package->FileInfo)
+	{
+		// Package is not a part of game file system, compare package names with its path
+		Filename = Package->GetFilename();
+	}
+
+	for (const CObjectReference& Ref : References)
+	{
+		if (stricmp(Ref.ObjectName, ObjectName) || stricmp(Ref.ClassName, ClassName))
+			continue;
+		if (Package->FileInfo ? (Ref.PackageFile == Package->FileInfo) : (Ref.PackageName && PackageNameMatchesFile(Ref.PackageName, *Filename)))
+			return &Ref;
+	}
+	return NULL;
+
+	unguard;
+}
+
+void ReleaseExportSummaries(const TArray<const CGameFileInfo*>& Packages)
+{
+	for (const CGameFileInfo* File : Packages)
+	{
+		if (File->ExportSummary)
 		{
-			UnPackage* package = UnPackage::LoadPackage(file, /*silent=*/ true);	// should always return non-NULL
-			if (!package) continue;		// should not happen
-			// Don't keep the package's reader open
-			package->CloseReader();
-
-			ScanPackageExports(package, file);
-		#if 0
-			// this code is disabled: it works, however we're going to use ScanContent not just to get objects counts,
-			// but also for collecting object references
-
-			// now unload package to not waste memory
-			UnPackage::UnloadPackage(package);
-			assert(file->Package == NULL);
-		#endif
+			delete File->ExportSummary;
+			const_cast<CGameFileInfo*>(File)->ExportSummary = NULL;
 		}
-		scanned = true;
 	}
+}
+
+bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress, bool bCollectReferences)
+{
+	guard(ScanContent);
+
+#if PROFILE
+	appResetProfiler();
+#endif
+
+	// Collect packages which weren't scanned yet
+	TArray<int> ScanIndices;
+	ScanIndices.Empty(Packages.Num());
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		if (!Packages[i]->IsPackageScanned || (bCollectReferences && !Packages[i]->ExportSummary))
+			ScanIndices.Add(i);
+	}
+
+	// Preallocate PackageMap
+	UnPackage::ReservePackageMap(Packages.Num());
+
+	// Packages are loaded in worker threads, UnPackage::LoadPackage() is thread-safe
+	bool bCompleted = ParallelScan(ScanIndices.Num(),
+		[&Packages, &ScanIndices, bCollectReferences](int Index)
+		{
+			CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[ScanIndices[Index]]);		// we'll modify this structure here
+
+		#if UNREAL4
+			if (file->IsIOStoreFile())
+			{
+				// IoStore package imports could be resolved only with loading of dependencies, so load
+				// the package fully and keep it. Note: file->Package could point to the package which is
+				// being loaded by another thread, LoadPackage() will wait for it.
+				UnPackage* package = UnPackage::LoadPackage(file, /*silent=*/ true);
+				if (package)
+				{
+					package->CloseReader();
+					ScanPackageExports(package, file, bCollectReferences);
+				}
+			}
+			else
+		#endif // UNREAL4
+			if (file->Package)
+			{
+				// package already loaded
+				ScanPackageExports(file->Package, file, bCollectReferences);
+			}
+			else
+			{
+				// Load only package tables, and unload package to not waste memory
+				UnPackage* package = UnPackage::LoadPackageSummary(file);
+				if (package)
+				{
+					ScanPackageExports(package, file, bCollectReferences);
+					UnPackage::UnloadPackage(package);
+				}
+			}
+			file->IsPackageScanned = true;
+		},
+		[&Packages, &ScanIndices, Progress](int Index) -> bool
+		{
+			// Update progress dialog
+			if (!Progress) return true;
+			int PackageIndex = ScanIndices[Index];
+			FStaticString<MAX_PACKAGE_PATH> RelativeName;
+			Packages[PackageIndex]->GetRelativeName(RelativeName);
+			return Progress->Progress(*RelativeName, PackageIndex, Packages.Num());
+		});
+
 #if PROFILE
-	if (scanned)
+	if (ScanIndices.Num())
 		appPrintProfiler("Scanned packages");
 #endif
 #if 0
 	void PrintStringHashDistribution();
 	PrintStringHashDistribution();
 #endif
-	return !cancelled;
+	return bCompleted;
 
 	unguard;
 }
@@ -37,7 +37,36 @@ struct FileInfo
 
 bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress = NULL);
 
-bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress = NULL);
+// Scan packages and fill content information in CGameFileInfo. Packages which were not loaded
+// before are unloaded after scanning. With bCollectReferences, CGameFileInfo::ExportSummary is
+// filled too, it could be used to find objects referenced by these packages. Summaries should be
+// released with ReleaseExportSummaries() when not needed anymore.
+bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress = NULL, bool bCollectReferences = false);
+void ReleaseExportSummaries(const TArray<const CGameFileInfo*>& Packages);
+
+// Object imported by a scanned package
+struct CObjectReference
+{
+	const char*				ClassName;		// pooled string
+	const char*				ObjectName;		// points to CPackageExportSummary's storage
+	const char*				PackageName;	// pooled string, name of the package containing the object
+	const CGameFileInfo*	PackageFile;	// file of the package containing the object, NULL when not found
+};
+
+// Compact information about package, which is kept after package has been unloaded
+struct CPackageExportSummary
+{
+	TArray<CObjectReference> References;
+
+	// Find reference to an object located in the package
+	const CObjectReference* FindReference(const char* ClassName, const char* ObjectName, const UnPackage* Package) const;
+
+	// Build summary for loaded package
+	static const CPackageExportSummary* Create(UnPackage* Package);
+
+protected:
+	TArray<char> Names;
+};
 
 
 // Class statistics
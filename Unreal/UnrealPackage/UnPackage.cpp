@@ -8,6 +8,18 @@
 
 #include "GameDatabase.h"		// for GetGameTag()
 
+#if THREADING
+#include "Parallel.h"
+
+// Protects PackageMap and CGameFileInfo::Package, so packages could be loaded from worker threads.
+// Also used in LoadPackageIoStore().
+CMutex PackageMapMutex;
+
+// Serializes building of export hashes in UnPackage::BuildExportHash(). Separate from PackageMapMutex,
+// so FindExport() never waits for a package which is being loaded by another thread.
+static CMutex ExportHashMutex;
+#endif
+
 //#define PROFILE_PACKAGE_TABLES	1
 
 /*-----------------------------------------------------------------------------
@@ -273,14 +285,20 @@ void FObjectImport::Serialize(FArchive& Ar)
 	Package loading (creation) / unloading
 -----------------------------------------------------------------------------*/
 
-UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent)
+UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent, bool summaryView)
 :	Loader(NULL)
 #if UNREAL4
 ,	ExportIndices_IOS(NULL)
 #endif
+,	bSummaryView(summaryView)
+,	NameStorage(NULL)
+,	ExportHash(NULL)
+,	ExportHashMask(0)
 {
 	guard(UnPackage::UnPackage);
 
+	CStatsScope Stats(STATS_OpenPackage, NULL, appSkipRootDir(filename));
+
 	IsLoading = true;
 	FileInfo = fileInfo;
 
@@ -319,11 +337,8 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 		this->ArLicenseeVer = 0;
 		this->Game = GForceGame ? GForceGame : GAME_UE4(26); // appeared in UE4.26
 		OverrideVersion();
-		// Register package before loading, because it is possible that during
-		// loading of import table we'll load other packages to resolve dependencies,
-		// and circular dependencies are possible
-		RegisterPackage(filename);
-		LoadPackageIoStore();
+		// The package is registered by LoadPackageIoStore() before loading of import table
+		LoadPackageIoStore(filename);
 		// Release package file handle
 		CloseReader();
 		if (!IsValid())
@@ -411,7 +426,8 @@ UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool s
 	// Process Event Driven Loader packages: such packages are split into 2 pieces: .uasset with headers
 	// and .uexp with object's data. At this moment we already have FPackageFileSummary fully loaded,
 	// so we can replace loader with .uexp file - with providing correct position offset.
-	if (Game >= GAME_UE4_BASE && Summary.HeadersSize == Loader->GetFileSize())
+	// Summary view doesn't need object's data, so skip this.
+	if (Game >= GAME_UE4_BASE && Summary.HeadersSize == Loader->GetFileSize() && !bSummaryView)
 	{
 		guard(FindUexp);
 		char buf[MAX_PACKAGE_PATH];
@@ -463,7 +479,23 @@ void UnPackage::RegisterPackage(const char* filename)
 	appStrncpyz(buf, s, ARRAY_COUNT(buf));
 	char *s2 = strchr(buf, '.');
 	if (s2) *s2 = 0;
-	Name = appStrdupPool(buf);
+	Name = StoreName(buf);
+
+	if (bSummaryView)
+	{
+		// Summary view packages are owned by the caller
+		return;
+	}
+
+#if THREADING
+	CMutex::ScopedLock Lock(PackageMapMutex);
+#endif
+	if (FileInfo && FileInfo->Package)
+	{
+		// The same package was loaded by another thread while we were constructing this one.
+		// Don't register it, LoadPackage() will drop it.
+		return;
+	}
 	// ... then add 'this'
 	PackageMap.Add(this);
 
@@ -476,6 +508,9 @@ void UnPackage::RegisterPackage(const char* filename)
 
 void UnPackage::UnregisterPackage()
 {
+#if THREADING
+	CMutex::ScopedLock Lock(PackageMapMutex);
+#endif
 	// Remove self from package table (it will be there even if package is not "valid")
 	int i = PackageMap.FindItem(this);
 	if (i != INDEX_NONE)
@@ -483,10 +518,10 @@ void UnPackage::UnregisterPackage()
 		// Could be INDEX_NONE in a case of bad package
 		PackageMap.RemoveAt(i);
 	}
-	// unlink package from CGameFileInfo
-	if (FileInfo)
+	// unlink package from CGameFileInfo; it could point to another package when
+	// this one was a duplicate loaded by another thread (see RegisterPackage)
+	if (FileInfo && FileInfo->Package == this)
 	{
-		assert(FileInfo->Package == this || FileInfo->Package == NULL);
 		const_cast<CGameFileInfo*>(FileInfo)->Package = NULL;
 	}
 }
@@ -634,10 +669,25 @@ UnPackage::~UnPackage()
 #if UNREAL4
 	delete[] ExportIndices_IOS;
 #endif
+	if (NameStorage) delete NameStorage;
+	delete[] ExportHash;
 
 	unguard;
 }
 
+const char* UnPackage::StoreName(const char* name)
+{
+	if (!bSummaryView)
+	{
+		return appStrdupPool(name);
+	}
+	if (!NameStorage) NameStorage = new CMemoryChain();
+	int len = strlen(name) + 1;
+	char* s = (char*)NameStorage->Alloc(len, 1);
+	memcpy(s, name, len);
+	return s;
+}
+
 /*static*/ void UnPackage::UnloadPackage(UnPackage* package)
 {
 	if (package)
@@ -753,7 +803,7 @@ FArchive& UnPackage::operator<<(FName &N)
 		}
 		else
 		{
-			N.Str = appStrdupPool(va("%s%d", GetName(N_Index), N_ExtraIndex-1));	// without "_" char
+			N.Str = StoreName(va("%s%d", GetName(N_Index), N_ExtraIndex-1));	// without "_" char
 		}
 		return *this;
 	}
@@ -806,7 +856,7 @@ FArchive& UnPackage::operator<<(FName &N)
 	}
 	else
 	{
-		N.Str = appStrdupPool(va("%s_%d", GetName(N_Index), N_ExtraIndex-1));
+		N.Str = StoreName(va("%s_%d", GetName(N_Index), N_ExtraIndex-1));
 	}
 #else
 	// no modern engines compiled
@@ -861,16 +911,79 @@ FArchive& UnPackage::operator<<(UObject *&Obj)
 	Loading particular import or export package entry
 -----------------------------------------------------------------------------*/
 
+// Case-insensitive hash, consistent with FastNameComparer
+static FORCEINLINE uint32 GetExportNameHash(const char* s)
+{
+	uint32 hash = 0;
+	while (char c = *s++)
+	{
+		hash = ROL32(hash, 5) ^ (c & 0xDF);
+	}
+	return hash * 0x9E3779B1;
+}
+
+void UnPackage::BuildExportHash() const
+{
+	guard(UnPackage::BuildExportHash);
+
+#if THREADING
+	// Exports could be searched from different threads
+	CMutex::ScopedLock Lock(ExportHashMutex);
+	if (ExportHash) return;
+#endif
+
+	int HashSize = 16;
+	while (HashSize < Summary.ExportCount) HashSize <<= 1;
+
+	int* Hash = new int[HashSize + Summary.ExportCount];
+	int* Next = Hash + HashSize;
+	memset(Hash, -1, HashSize * sizeof(int));
+
+	// Insert exports in reverse order, so each hash chain will be sorted by export index
+	for (int i = Summary.ExportCount - 1; i >= 0; i--)
+	{
+		const char* ObjectName = ExportTable[i].ObjectName;
+		if (!ObjectName) continue;		// IoStore export which wasn't serialized
+		int h = GetExportNameHash(ObjectName) & (HashSize - 1);
+		Next[i] = Hash[h];
+		Hash[h] = i;
+	}
+
+	ExportHashMask = HashSize - 1;
+	// Publish the hash after it is completely built: FindExport() reads it without the lock
+#if THREADING
+	AtomicStorePtr(&ExportHash, Hash);
+#else
+	ExportHash = Hash;
+#endif
+
+	unguard;
+}
+
 int UnPackage::FindExport(const char *name, const char *className, int firstIndex) const
 {
 	guard(UnPackage::FindExport);
 
+	if (!Summary.ExportCount) return INDEX_NONE;
+#if THREADING
+	const int* Hash = AtomicLoadPtr(&ExportHash);
+#else
+	const int* Hash = ExportHash;
+#endif
+	if (!Hash)
+	{
+		BuildExportHash();
+		Hash = ExportHash;
+	}
+
+	const int* Next = Hash + ExportHashMask + 1;
 	FastNameComparer cmp(name);
-	for (int i = firstIndex; i < Summary.ExportCount; i++)
+	for (int i = Hash[GetExportNameHash(name) & ExportHashMask]; i >= 0; i = Next[i])
 	{
+		if (i < firstIndex) continue;
 		const FObjectExport &Exp = ExportTable[i];
-		// compare object name
-		if (cmp(Exp.ObjectName))
+		// compare object name; names are usually pooled, so check pointers first
+		if (Exp.ObjectName.Str == name || cmp(Exp.ObjectName))
 		{
 			// if class name specified - compare it too
 			const char* foundClassName = GetClassNameFor(Exp);
@@ -976,6 +1089,9 @@ UObject* UnPackage::CreateExport(int index)
 {
 	guard(UnPackage::CreateExport);
 
+	if (bSummaryView)
+		appError("Package \"%s\" was loaded in summary view, can't create objects", *GetFilename());
+
 	// Get previously created object if any
 	FObjectExport& Exp = GetExport(index);
 	if (Exp.Object)
@@ -1343,6 +1459,9 @@ TArray<char*>		MissingPackages;
 		// was specified fully qualified, with full path name, outside of root game path.
 		// This is rare situation, so we can allow a bit unoptimized code here - linear search
 		// for package inside a PackageMap array.
+	#if THREADING
+		CMutex::ScopedLock Lock(PackageMapMutex);
+	#endif
 
 		// Check in missing package names. This check will allow to print "missing package"
 		// warning only once.
@@ -1378,6 +1497,42 @@ TArray<char*>		MissingPackages;
 	unguardf("%s", Name);
 }
 
+// Get package which was already loaded for the file
+static UnPackage* GetLoadedPackage(const CGameFileInfo* File)
+{
+#if THREADING && UNREAL4
+	if (File->IsIOStoreFile())
+	{
+		// IOStore package is registered before it is complete, and it is completed under the lock (see
+		// LoadPackageIoStore()). Take the lock to wait for a package which is loaded by another thread.
+		CMutex::ScopedLock Lock(PackageMapMutex);
+		return File->Package;
+	}
+#endif
+	return File->Package;
+}
+
+/*static*/ UnPackage* UnPackage::CreatePackage(const CGameFileInfo* File, bool silent)
+{
+	// Check if package was already loaded.
+	if (UnPackage* Loaded = GetLoadedPackage(File))
+		return Loaded;
+	// Load the package with providing 'File' to constructor.
+	UnPackage* package = new UnPackage(*File->GetRelativeName(), File, silent);
+	if (!package->IsValid())
+	{
+		delete package;
+		return NULL;
+	}
+	if (File->Package != package)
+	{
+		// Another thread has loaded the same package in parallel, use it
+		delete package;
+		return GetLoadedPackage(File);
+	}
+	return package;
+}
+
 /*static*/ UnPackage *UnPackage::LoadPackage(const CGameFileInfo* File, bool silent)
 {
 	guard(UnPackage::LoadPackage(info));
@@ -1385,20 +1540,28 @@ TArray<char*>		MissingPackages;
 
 	if (File->IsPackage())
 	{
-		// Check if package was already loaded.
-		if (File->Package)
-			return File->Package;
-		// Load the package with providing 'File' to constructor.
-		UnPackage* package = new UnPackage(*File->GetRelativeName(), File, silent);
-		if (!package->IsValid())
-		{
-			delete package;
-			return NULL;
-		}
-		return package;
+		return CreatePackage(File, silent);
 	}
 	return NULL;
 
 	unguardf("%s", *File->GetRelativeName());
 }
 
+/*static*/ UnPackage* UnPackage::LoadPackageSummary(const CGameFileInfo* File)
+{
+	guard(UnPackage::LoadPackageSummary);
+
+	if (!File->IsPackage())
+		return NULL;
+
+	UnPackage* package = new UnPackage(*File->GetRelativeName(), File, true, true);
+	if (!package->IsValid())
+	{
+		delete package;
+		return NULL;
+	}
+	return package;
+
+	unguardf("%s", *File->GetRelativeName());
+}
+
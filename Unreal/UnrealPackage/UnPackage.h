@@ -255,7 +255,18 @@ public:
 #endif
 
 protected:
-	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false);
+	// Summary view support: package is not registered, names are stored in package-local memory
+	bool					bSummaryView;
+	CMemoryChain*			NameStorage;
+	// Raw name table data for lazy decoding of names, used only in summary view
+	TArray<byte>			RawNames;
+	TArray<int32>			RawNameOffsets;
+	// Export name hash used by FindExport(), built on first use. Contains hash heads followed by
+	// the "next" links, both are export indices or -1.
+	mutable int* volatile	ExportHash;			// published with AtomicStorePtr() when THREADING
+	mutable int				ExportHashMask;
+
+	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false, bool summaryView = false);
 	~UnPackage();
 
 public:
@@ -271,11 +282,19 @@ public:
 	// When the package is already loaded, this function will simply return a pointer
 	// to previously loaded UnPackage.
 	static UnPackage* LoadPackage(const char* Name, bool silent = false);
-	// Load package using existing CGameFileInfo
+	// Load package using existing CGameFileInfo. This function could be called from worker threads.
 	static UnPackage* LoadPackage(const CGameFileInfo* File, bool silent = false);
 	// We've protected UnPackage's destructor, however it is possible to use UnloadPackage to fully destroy it.
 	// This call is just more noticeable in code than use of 'operator delete'.
 	static void UnloadPackage(UnPackage* package);
+	// Load package in "summary view" mode: only package summary, names, imports and exports are
+	// available, names are decoded on demand. Such package is not registered in package map, it
+	// is not possible to load objects from it, and it should be released with UnloadPackage().
+	// Nothing is allocated in the global string pool, so this mode is useful for scanning many
+	// packages. This function could be called from worker threads.
+	static UnPackage* LoadPackageSummary(const CGameFileInfo* File);
+
+	bool IsSummaryView() const { return bSummaryView; }
 
 	FORCEINLINE static void ReservePackageMap(int count)
 	{
@@ -293,6 +312,8 @@ public:
 #endif
 
 protected:
+	// Worker function for LoadPackage(CGameFileInfo*)
+	static UnPackage* CreatePackage(const CGameFileInfo* File, bool silent);
 	// Create loader FArchive for package
 	static FArchive* CreateLoader(const char* filename, FArchive* baseLoader = NULL);
 	// Change loader for games with tricky package data
@@ -311,9 +332,14 @@ public:
 	{
 		if (unsigned(index) >= Summary.NameCount)
 			appError("Package \"%s\": wrong name index %d", *GetFilename(), index);
-		return NameTable[index];
+		const char* name = NameTable[index];
+		if (!name) name = DecodeName(index);	// summary view: not decoded yet
+		return name;
 	}
 
+	// Store a name string: put it to global string pool, or to package's memory in summary view
+	const char* StoreName(const char* name);
+
 	FObjectImport& GetImport(int index)
 	{
 		if (unsigned(index) >= Summary.ImportCount)
@@ -372,6 +398,8 @@ public:
 		return GetObjectName(Exp.ClassIndex);
 	}
 
+	// Find export by name and optional class name, starting from 'firstIndex'. Exports are returned
+	// in the order of export table.
 	int FindExport(const char *name, const char *className = NULL, int firstIndex = 0) const;
 	int FindExportForImport(const char *ObjectName, const char *ClassName, UnPackage *ImporterPackage, int ImporterIndex);
 	bool CompareObjectPaths(int PackageIndex, UnPackage *RefPackage, int RefPackageIndex) const;
@@ -446,14 +474,16 @@ private:
 	void LoadNameTable2();
 	void LoadNameTable3();
 	void LoadNameTable4();
+	const char* DecodeName(int index);
 	bool VerifyName(FString& nameStr, int nameIndex);
 
 	void LoadImportTable();
 	void LoadExportTable();
+	void BuildExportHash() const;
 
 #if UNREAL4
 	// IsStore AsyncPackage support
-	void LoadPackageIoStore();
+	void LoadPackageIoStore(const char* filename);
 	void LoadNameTableIoStore(const byte* Data, int NameCount, int TableSize);
 	void LoadExportTableIoStore(
 		const byte* Data, int ExportCount, int TableSize, int PackageHeaderSize,
@@ -225,7 +225,7 @@ void UnPackage::LoadNameTable2()
 				if (!c) break;
 			}
 			assert(len < ARRAY_COUNT(buf));
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto dword_flags;
 		}
 
@@ -239,7 +239,7 @@ void UnPackage::LoadNameTable2()
 			*this << len;
 			assert(len < ARRAY_COUNT(buf));
 			Serialize(buf, len+1);
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto dword_flags;
 		}
 	#if PARIAH
@@ -254,7 +254,7 @@ void UnPackage::LoadNameTable2()
 			byte len;
 			*this << len;
 			Serialize(buf, len+1);
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto dword_flags;
 		}
 #endif // SPLINTER_CELL
@@ -268,7 +268,7 @@ void UnPackage::LoadNameTable2()
 			assert(len < ARRAY_COUNT(buf));
 			Serialize(buf, len);
 			buf[len] = 0;
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto done;
 		}
 #endif // LEAD
@@ -295,7 +295,7 @@ void UnPackage::LoadNameTable2()
 				*d = c2 & 0xFF;
 				shift = (c - 5) & 15;
 			}
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			int unk;
 			*this << AR_INDEX(unk);
 			unguard;
@@ -312,7 +312,7 @@ void UnPackage::LoadNameTable2()
 		NameTable[i] = new char[name.Num()];
 		strcpy(NameTable[i], *name);
 	#else
-		NameTable[i] = appStrdupPool(*nameStr);
+		NameTable[i] = StoreName(*nameStr);
 	#endif
 
 	#if BIOSHOCK
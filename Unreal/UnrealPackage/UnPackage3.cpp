@@ -519,7 +519,7 @@ void UnPackage::LoadNameTable3()
 			assert(len < ARRAY_COUNT(buf));
 			Serialize(buf, len);
 			buf[len] = 0;
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto qword_flags;
 		}
 #endif // DCU_ONLINE
@@ -531,7 +531,7 @@ void UnPackage::LoadNameTable3()
 			*this << len;
 			Serialize(buf, len);
 			buf[len] = 0;
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto done;
 		}
 #endif // R6VEGAS
@@ -544,7 +544,7 @@ void UnPackage::LoadNameTable3()
 			assert(len < ARRAY_COUNT(buf));
 			Serialize(buf, len);
 			buf[len] = 0;
-			NameTable[i] = appStrdupPool(buf);
+			NameTable[i] = StoreName(buf);
 			goto qword_flags;
 		}
 #endif // TRANSFORMERS
@@ -567,7 +567,7 @@ void UnPackage::LoadNameTable3()
 		VerifyName(nameStr, i);
 
 		// Remember the name
-		NameTable[i] = appStrdupPool(*nameStr);
+		NameTable[i] = StoreName(*nameStr);
 
 #if WHEELMAN
 		if (Game == GAME_Wheelman) goto dword_flags;
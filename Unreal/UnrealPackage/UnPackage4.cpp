@@ -9,6 +9,12 @@
 #include "FileSystem/GameFileSystem.h"		// just required for next header
 #include "FileSystem/IOStoreFileSystem.h"	// for FindPackageById()
 
+#if THREADING
+#include "Parallel.h"
+
+extern CMutex PackageMapMutex;				// UnPackage.cpp
+#endif
+
 struct FEnumCustomVersion
 {
 	int32			Tag;
@@ -370,6 +376,33 @@ void UnPackage::LoadNameTable4()
 	if (Game == GAME_Gears4 || Game == GAME_DaysGone) bHasNameHashes = true;
 #endif
 
+	if (bSummaryView)
+	{
+		// Keep raw name data, names will be decoded on demand with DecodeName()
+		RawNameOffsets.SetNumUninitialized(Summary.NameCount);
+		for (int i = 0; i < Summary.NameCount; i++)
+		{
+			int32 Len;
+			*this << Len;
+			int Size = (Len >= 0) ? Len : -Len * 2;
+			if (Size > MAX_FNAME_LEN * 2)
+				appError("Package \"%s\": bad name %d length %d", *GetFilename(), i, Len);
+			RawNameOffsets[i] = RawNames.Num();
+			// Store length in file byte order, so DecodeName() could use regular FString serializer
+			int32 RawLen = Len;
+			if (ReverseBytes) appReverseBytes(&RawLen, 1, sizeof(RawLen));
+			byte* Dst = &RawNames[RawNames.AddUninitialized(sizeof(RawLen) + Size)];
+			memcpy(Dst, &RawLen, sizeof(RawLen));
+			this->Serialize(Dst + sizeof(RawLen), Size);
+			NameTable[i] = NULL;
+			if (bHasNameHashes)
+			{
+				this->Seek(this->Tell() + 4);
+			}
+		}
+		return;
+	}
+
 	for (int i = 0; i < Summary.NameCount; i++)
 	{
 		guard(Name);
@@ -381,7 +414,7 @@ void UnPackage::LoadNameTable4()
 		nameStr.TrimStartAndEndInline();
 
 		// Remember the name
-		NameTable[i] = appStrdupPool(*nameStr);
+		NameTable[i] = StoreName(*nameStr);
 #else
 		char buf[MAX_FNAME_LEN];
 		int32 Len;
@@ -396,7 +429,7 @@ void UnPackage::LoadNameTable4()
 			appSprintf(ARRAY_ARG(buf), "unicode_%d", i);
 			this->Seek(this->Tell() - Len * 2);
 		}
-		NameTable[i] = appStrdupPool(buf);
+		NameTable[i] = StoreName(buf);
 #endif
 
 		if (bHasNameHashes)
@@ -418,6 +451,30 @@ void UnPackage::LoadNameTable4()
 	unguard;
 }
 
+const char* UnPackage::DecodeName(int index)
+{
+	guard(UnPackage::DecodeName);
+
+	if (!RawNameOffsets.Num())
+		appError("Package \"%s\": name %d is not loaded", *GetFilename(), index);
+
+	// Decode the name exactly like LoadNameTable4() does
+	int Offset = RawNameOffsets[index];
+	int EndOffset = (index + 1 < RawNameOffsets.Num()) ? RawNameOffsets[index + 1] : RawNames.Num();
+	FMemReader Reader(&RawNames[Offset], EndOffset - Offset);
+	Reader.SetupFrom(*this);
+
+	FStaticString<MAX_FNAME_LEN> nameStr;
+	Reader << nameStr;
+	nameStr.TrimStartAndEndInline();
+
+	const char* name = StoreName(*nameStr);
+	NameTable[index] = name;
+	return name;
+
+	unguardf("%d", index);
+}
+
 /*-----------------------------------------------------------------------------
 	IO Store AsyncPackage
 -----------------------------------------------------------------------------*/
@@ -427,11 +484,11 @@ struct FMappedName
 	uint32 NameIndex;
 	uint32 ExtraIndex;
 
-	const char* ToString(const char** NameTable) const
+	const char* ToString(UnPackage* Package) const
 	{
 		if (ExtraIndex == 0)
-			return NameTable[NameIndex];
-		return appStrdupPool(va("%s_%d", NameTable[NameIndex], ExtraIndex - 1));
+			return Package->NameTable[NameIndex];
+		return Package->StoreName(va("%s_%d", Package->NameTable[NameIndex], ExtraIndex - 1));
 	}
 };
 
@@ -576,7 +633,7 @@ static void LoadGraphData(const byte* Data, int DataSize, TArray<const CGameFile
 }
 
 // Reference: AsyncLoading2.cpp, FAsyncPackage2::Event_ProcessPackageSummary()
-void UnPackage::LoadPackageIoStore()
+void UnPackage::LoadPackageIoStore(const char* filename)
 {
 	guard(UnPackage::LoadPackageIoStore);
 
@@ -636,6 +693,20 @@ void UnPackage::LoadPackageIoStore()
 	int ExportCount = ExportTableSize / sizeof(FExportMapEntry);
 	LoadExportTableIoStore(HeaderData + Sum.ExportMapOffset, ExportCount, ExportTableSize, HeaderSize, BundleHeadersArray, BundleEntriesArray);
 
+	// Loading of import table could load other packages to resolve dependencies, and circular dependencies
+	// are possible, so register the package before that. The package is visible to other threads while
+	// not complete, so finish loading under the lock. Everything above is done in parallel with other threads.
+#if THREADING
+	CMutex::ScopedLock Lock(PackageMapMutex);
+#endif
+	RegisterPackage(filename);
+	if (!bSummaryView && FileInfo && FileInfo->Package != this)
+	{
+		// The same package was loaded by another thread, this one will be dropped by LoadPackage()
+		delete[] HeaderData;
+		return;
+	}
+
 	// Load import table
 	// Should scan graph first to get list of packages we depends on
 	TStaticArray<const CGameFileInfo*, 32> ImportPackages;
@@ -690,7 +761,7 @@ void UnPackage::LoadNameTableIoStore(const byte* Data, int NameCount, int TableS
 	{
 		FStaticString<MAX_FNAME_LEN> NameStr;
 		SerializeFNameSerializedView(Data, NameStr);
-		NameTable[i] = appStrdupPool(*NameStr);
+		NameTable[i] = StoreName(*NameStr);
 	}
 	assert(Data == EndPosition);
 
@@ -733,7 +804,7 @@ void UnPackage::LoadExportTableIoStore(const byte* Data, int ExportCount, int Ta
 				assert(E.CookedSerialSize < 0x7FFFFFFF);
 				Exp.SerialOffset = (int32)E.CookedSerialOffset;
 				Exp.SerialSize = (int32)E.CookedSerialSize;
-				Exp.ObjectName.Str = E.ObjectName.ToString(NameTable);
+				Exp.ObjectName.Str = E.ObjectName.ToString(this);
 				Exp.ClassName_IO = FindScriptEntryName(E.ClassIndex);
 				// Store "real" offset
 				Exp.RealSerialOffset = CurrentExportOffset;
@@ -767,7 +838,7 @@ struct ImportHelper
 	int ImportCount;
 	int NextImportToCheck;
 
-	ImportHelper(const TArray<const CGameFileInfo*>& InPackageFiles, FObjectImport* InImportTable, const FPackageObjectIndex* InImportMap, int InImportCount)
+	ImportHelper(const TArray<const CGameFileInfo*>& InPackageFiles, FObjectImport* InImportTable, const FPackageObjectIndex* InImportMap, int InImportCount, bool bLoadPackages)
 	: PackageFiles(InPackageFiles)
 	, ImportTable(InImportTable)
 	, ImportMap(InImportMap)
@@ -777,6 +848,8 @@ struct ImportHelper
 		int NumPackages = PackageFiles.Num();
 		Packages.Reserve(NumPackages);
 		AllocatedPackageImports.Init(-1, NumPackages);
+		if (!bLoadPackages)
+			return;
 		// Preload dependencies
 		for (const CGameFileInfo* File : PackageFiles)
 		{
@@ -858,7 +931,8 @@ void UnPackage::LoadImportTableIoStore(const byte* Data, int ImportCount, const
 	Summary.ImportCount = ImportCount;
 	const FPackageObjectIndex* DataPtr = (FPackageObjectIndex*)Data;
 
-	ImportHelper Helper(ImportPackages, ImportTable, DataPtr, ImportCount);
+	// Summary view doesn't load dependencies, so imports of objects from other packages are left unresolved
+	ImportHelper Helper(ImportPackages, ImportTable, DataPtr, ImportCount, !bSummaryView);
 
 	for (int ImportIndex = 0; ImportIndex < ImportCount; ImportIndex++)
 	{
@@ -894,7 +968,7 @@ void UnPackage::LoadImportTableIoStore(const byte* Data, int ImportCount, const
 #if DEBUG_PACKAGE
 				appPrintf("Unable to resolve import %llX\n", ObjectIndex);
 #endif
-				ErrorStats.MissedImports++;
+				if (!bSummaryView) ErrorStats.MissedImports++;
 			}
 		}
 	}
@@ -170,6 +170,9 @@ public:
 
 extern UObject *GForceAnimSet;
 
+// Get CAnimSet from MeshAnimation, AnimSet or Skeleton object, returns NULL for other classes
+CAnimSet *GetAnimSet(const UObject *Obj);
+
 class CSkelMeshViewer : public CMeshViewer
 {
 public:
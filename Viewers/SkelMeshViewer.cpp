@@ -38,7 +38,7 @@ TArray<CSkelMeshInstance*> CSkelMeshViewer::TaggedMeshes;
 UObject *GForceAnimSet = NULL;
 
 
-static CAnimSet *GetAnimSet(const UObject *Obj)
+CAnimSet *GetAnimSet(const UObject *Obj)
 {
 	if (Obj->IsA("MeshAnimation"))		// UE1,UE2
 		return static_cast<const UMeshAnimation*>(Obj)->ConvertedAnim;
@@ -999,8 +999,9 @@ void CSkelMeshViewer::FindUE4Animations()
 	progress.SetDescription("Scanning package");
 
 	// Perform full scan to be able to locate AnimSequence objects
-	if (!ScanContent(PackageInfos, &progress))
+	if (!ScanContent(PackageInfos, &progress, /*bCollectReferences=*/ true))
 	{
+		ReleaseExportSummaries(PackageInfos);
 		appPrintf("Interrupted by user\n");
 		return;
 	}
@@ -1013,47 +1014,24 @@ void CSkelMeshViewer::FindUE4Animations()
 	for (int i = 0; i < PackageInfos.Num(); i++)
 	{
 		const CGameFileInfo* info = PackageInfos[i];
-		UnPackage* package = info->Package;
-		if (!package)
-		{
-			// Shouldn't happen, but happens (ScanPackage() should fill Package for all CGameFileInfo).
-			// Example of appearance: ScanPackages may open a WRONG find in a case when game files are extracted from pak, and
-			// user supplies wrong (shorter) game path, e.g. -path=Extported/Meshes, and multiple files with the same name
-			// exists inside that folder. CGameFileInfo::Find has heuristic for finding files using partial path, but it may fail.
-			// In this case, CGameFileInfo will say "it's package", but actually file won't be scanned and/or loaded.
-			//appNotify("Strange package: IsPackage=true, Package is NULL: %s (size %d Kb)", *info->GetRelativeName(), info->SizeInKb + info->ExtraSizeInKb);
-			continue;
-		}
-
-		bool found = false;
-		for (int importIndex = 0; importIndex < package->Summary.ImportCount; importIndex++)
-		{
-			FObjectImport& imp = package->GetImport(importIndex);
-			const char* ObjectClass = *imp.ClassName;
-			const char* ObjectName = *imp.ObjectName;
-			if (!stricmp(ObjectClass, "Skeleton") && !stricmp(ObjectName, lookupSkeletonName))
-			{
-				// This uasset refers to the Skeleton object with the same name, check if this
-				// is an exactly the same Skeleton object as we're using
-				const char* referencedFilename = package->GetObjectPackageName(imp.PackageIndex);
-				const CGameFileInfo* referencedFile = CGameFileInfo::Find(referencedFilename);
-				if (Skeleton->Package->FileInfo == referencedFile)
-				{
-					found = true;
-					break;
-				}
-			}
-		}
+		// Scanned packages are unloaded, use collected object references
+		if (!info->ExportSummary || !info->NumAnimations) continue;
 
-		if (!found) continue; // this package doesn't use our Skeleton
+		// Check if this package refers to exactly the same Skeleton object as we're using
+		if (!info->ExportSummary->FindReference("Skeleton", lookupSkeletonName, Skeleton->Package))
+			continue;
 
-		// Now, if this package has animation sequence - enqueue it for loading
-		if (PackageInfos[i]->NumAnimations)
+		// This package has animation sequence - enqueue it for loading
+		UnPackage* package = UnPackage::LoadPackage(info);
+		if (package)
 		{
 			packagesToLoad.Add(package);
 		}
 	}
 
+	// Object references are not needed anymore
+	ReleaseExportSummaries(PackageInfos);
+
 	// Sort packages by name for easier navigation after loading
 	packagesToLoad.Sort([](UnPackage* const& a, UnPackage* const& b) -> int
 		{
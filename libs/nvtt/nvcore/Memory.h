@@ -18,8 +18,8 @@
 
 
 #if UMODEL
-void* appMalloc(int size, int alignment = 8, bool noInit = false);
-void* appRealloc(void *ptr, int newSize);
+void* appMalloc(size_t size, int alignment = 8, bool noInit = false);
+void* appRealloc(void *ptr, size_t newSize);
 void appFree(void *ptr);
 #endif
 